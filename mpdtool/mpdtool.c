@@ -30,6 +30,26 @@
 	This might not always work. For some as yet unknown reason the serial line firmware does not get the <ETX> or does not send
 	the <ACK>. So if we receive other characters while we are waiting for an <ACK> we are assuming an error and stop waiting.
 	
+	Betty can tag a command by putting "#<tag> " in front of it, for example "#12 playlistinfo 5\n".
+	Tagged commands are queued and handled one after the other, Betty does not have to wait for the answer
+	before it sends the next one. In front of the answer we send the line "#<tag>\n", 
+	so that Betty knows which of its requests the answer belongs to.
+	An untagged command cancels the command that is currently handled (Betty has given up waiting).
+	
+	Betty searches while the user types. A search with a newer search waiting behind it in the queue is of no use,
+	we answer it at once with "ACK [superseded]", even if MPD is already working on it.
+	The names that we find are sent at once ("name: "), the number of results ("results: ") comes last.
+	
+	To save airtime Betty can send the common commands in a compact form: one opcode byte per command
+	followed by its numeric arguments. See expand_compact() below.
+	Betty asks with the command "compact" if we understand this form. We answer "compact: 1".
+	MPD (reached through an older mpdtool) answers with an ACK, so Betty keeps sending plain text.
+	
+	If we can not get an answer from MPD, we answer with "ACK [mpd-unreachable]" or "ACK [mpd-timeout]".
+	So Betty knows at once that the radio link, the scart adapter and mpdtool are working and MPD is the problem.
+	While MPD is silent, we send "wait: <seconds>" every MPD_KEEPALIVE seconds, so that Betty does not give up
+	on the request before our "ACK [mpd-timeout]" arrives.
+	
 	Transport Layer:
 	This program receives commands via serial line. It sends them via a TCP/IP socket to mpd.
 	The answers are received via the same socket and transferred back over serial line.
@@ -37,11 +57,16 @@
 	
 	We must filter some characters: <ETX> <ACK> and <EOT> are not transmitted in either direction.
 	If they occur in the input stream, they are simply dropped.
+	The same holds for the other characters that the scart adapter takes as out-of-band signals (<ENQ> <DC2> <SYN>).
+	
+	Physical Layer:
+	The serial line starts with 38400 baud. If the scart adapter knows it (firmware 1.2 and later),
+	we switch to a faster rate, see negotiate_baud().
 
 */
 
 #define VERSION_MAJOR 1
-#define VERSION_MINOR 5
+#define VERSION_MINOR 10
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -83,8 +108,10 @@
 #define SO	0x0e
 #define SI	0x0f
 #define DLE	0x10
+#define DC2	0x12
 
 #define NAK	0x15
+#define SYN	0x16
 #define CAN	0x18
 
 #define LF	0x0a
@@ -185,6 +212,14 @@ int ser_out_rd_idx;
 int wait_ack;
 
 
+/* Queue for tagged commands from Betty.
+	Betty sends at most 3 commands before it waits for an answer, so the queue is big enough.
+*/
+#define CMD_QUEUE_LEN 8
+char cmd_queue[CMD_QUEUE_LEN][BUFFER_SIZE + 1];
+int cmd_queue_first;
+int cmd_queue_cnt;
+
 /* resets the serial input buffer */
 void
 reset_ser_in(){
@@ -212,10 +247,16 @@ ser_out_char(char c){
 		ser_out_buf[ser_out_wrt_idx + 1] = c;
 }
 
+/* Sends a string from MPD, without the control characters that the scart adapter would take as signals */
 void
 serial_output (char *buf){	
-	while (*buf) 
-		ser_out_char( *(buf++) );
+	for (; *buf; buf++)
+		switch (*buf){
+			case ETX: case EOT: case ENQ: case ACK: case DC2: case SYN:
+				break;
+			default:
+				ser_out_char(*buf);
+		};
 }
 
 /* 
@@ -428,7 +469,9 @@ void reboot_scart(int serial_fd){
 	Send at most MAX_TX bytes to serial
 	Given is ser_out_buf with ser_out_len bytes in it.
 
-	Waits for ACK if MAX_TX bytes have been written.
+	Waits for ACK if MAX_TX bytes or the EOT of an answer have been written.
+	The scart adapter drops bytes after an EOT until it sends the answer to Betty.
+	It sends the ACK then, so the next answer may follow at once.
 	Returns when waiting or buffer empty.
 	Waiting means setting the global flag wait_ack to 1.
 	The serial input routine will reset that flag when it sees an ACK
@@ -443,6 +486,7 @@ send_to_serial(int serial_fd){
 	int res;
 	int num = 0;
 	char ETX_char = ETX;
+	char *eot;
 
 	static int tx_cnt = 0;
 	
@@ -450,13 +494,16 @@ send_to_serial(int serial_fd){
 	if (wait_ack) return;
 	
 	bytes_to_send = min (ser_out_wrt_idx - ser_out_rd_idx, MAX_TX - tx_cnt);
+	eot = memchr(ser_out_buf + ser_out_rd_idx, EOT, bytes_to_send);
+	if (eot != NULL)
+		bytes_to_send = eot - (ser_out_buf + ser_out_rd_idx) + 1;
 	
 	for (bytes_written = 0; bytes_written < bytes_to_send; bytes_written += num){
 
 		/* Write a certain number of bytes to serial_fd. We either send the remaining bytes in buffer
 			or the remaining bytes to fill a packet, whichever is shorter.
 		*/
-		num = write(serial_fd, (void *)(ser_out_buf + ser_out_rd_idx), bytes_to_send);
+		num = write(serial_fd, (void *)(ser_out_buf + ser_out_rd_idx), bytes_to_send - bytes_written);
 		
 		/* Did our write fail completely ? */
 		if (num == -1) {
@@ -473,7 +520,7 @@ send_to_serial(int serial_fd){
 		tx_cnt += num;
 	};
 
-	if (tx_cnt >= MAX_TX){
+	if ( (tx_cnt >= MAX_TX) || (eot != NULL) ){
 		res = write(serial_fd, &ETX_char, 1);
 		if (res == -1) {
 			perror("send_to_serial()");
@@ -488,9 +535,74 @@ send_to_serial(int serial_fd){
 };
 
 
+/* Move the tagged command in ser_in_buf to the end of cmd_queue and reset the serial input buffer */
+void
+queue_serial_in(){
+	if (cmd_queue_cnt < CMD_QUEUE_LEN){
+		strcpy(cmd_queue[(cmd_queue_first + cmd_queue_cnt) % CMD_QUEUE_LEN], ser_in_buf);
+		cmd_queue_cnt++;
+	} else 
+		fprintf(stderr, "Error, command queue is full. Command ignored.\n");
+	reset_ser_in();
+};
+
+/* Copy the first command from cmd_queue to buf and remove it from the queue */
+void
+unqueue_cmd(char *buf){
+	strcpy(buf, cmd_queue[cmd_queue_first]);
+	cmd_queue_first = (cmd_queue_first + 1) % CMD_QUEUE_LEN;
+	cmd_queue_cnt--;
+};
+
+/* A tagged command starts with "#<tag> ".
+	We copy "#<tag>\n" to tag_line and remove the tag from the command in buf.
+	For an untagged command tag_line is set to the empty string.
+*/
+#define TAG_LINE_LEN 8
+void
+split_tag(char *buf, char *tag_line){
+	char *s = buf + 1;
+	int i = 0;
+	
+	tag_line[0] = 0;
+	if ('#' != buf[0])
+		return;
+	
+	tag_line[i++] = '#';
+	while ( isdigit(*s) && (i < TAG_LINE_LEN - 2) )
+		tag_line[i++] = *(s++);
+	tag_line[i++] = '\n';
+	tag_line[i] = 0;
+	
+	if (' ' == *s) 
+		s++;
+	memmove(buf, s, strlen(s) + 1);
+};
+
+#define SUPERSEDED_ACK "ACK [superseded] {search} a newer search follows\n"
+
+/* Returns TRUE iff buf (without its tag) is a search and a newer search waits in cmd_queue.
+	The user has typed on, so Betty has no use for the answer.
+*/
+int
+search_superseded(char *buf){
+	int i;
+	char *s;
+	
+	if (0 != strncmp(buf, "search ", 7))
+		return FALSE;
+	for (i = 0; i < cmd_queue_cnt; i++){
+		s = strchr(cmd_queue[(cmd_queue_first + i) % CMD_QUEUE_LEN], ' ');
+		if ( (NULL != s) && (0 == strncmp(s + 1, "search ", 7)) )
+			return TRUE;
+	};
+	return FALSE;
+};
+
 /* 
 	Read some bytes from serial line 
 	Sets global flag cmd_finished if EOT is seen.
+	Tagged commands are put in cmd_queue instead.
 	Then returns.
 
 	We utilize the fact that Betty sends an EOT when a command is finished.
@@ -521,7 +633,10 @@ read_from_serial (int fd){
 	switch (ser_in_buf[ser_in_len]) {
 		case EOT:
 			ser_in_buf[ser_in_len]='\0';			// Null terminate string 
-			cmd_complete = 1;					// Set flag
+			if ('#' == ser_in_buf[0])
+				queue_serial_in();				// tagged command
+			else
+				cmd_complete = 1;				// Set flag
 			return;
 			
 		case CAN:
@@ -542,6 +657,9 @@ read_from_serial (int fd){
 	return;
 };
 	
+/* Firmware version of the scart adapter, 10 * major + minor, from scart_alive() */
+int scart_version;
+
 /* Returns TRUE iff the scart adapter is connected and 
 	responding correctly to our ETX characters
 */
@@ -604,9 +722,86 @@ scart_alive(){
 			ser_in_buf[ser_in_len+2],
 		   	ser_in_buf[ser_in_len+3]
 		   );
+	scart_version = (ser_in_buf[ser_in_len+1] - '0') * 10 + (ser_in_buf[ser_in_len+3] - '0');
 
 	return 1;
 };
+
+/* The baud rates that the scart adapter knows. The index is sent as rate code '0' ... '3'. */
+#define NUM_RATES 4
+static const int rate_baud[NUM_RATES] = {38400, 57600, 115200, 230400};
+static const speed_t rate_speed[NUM_RATES] = {B38400, B57600, B115200, B230400};
+
+/* The rate we use now, index into rate_baud[] */
+int serial_rate = 0;
+
+/* The scart adapter goes back to 38400 baud after this time, if the new rate does not work */
+#define BAUD_FALLBACK_SEC 3
+
+/* Reads n bytes from the serial line, returns TRUE iff successful */
+static int
+read_serial_n(char *buf, int n){
+	int res, got;
+	
+	for (got = 0; got < n; got += res){
+		res = read(serial_fd, buf + got, n - got);
+		if (res <= 0)
+			return 0;
+	};
+	return 1;
+}
+
+/* 
+	Switches the serial line to rate_baud[rate], the scart adapter must have answered scart_alive().
+		we:		DC2 <rate>		propose the rate, <rate> is '0' + index into rate_baud[]
+		scart:	DC2 <rate>		agrees (or NAK)
+		we:		SYN				we switch after sending it, the scart adapter when it gets it
+		we:		ETX				at the new rate, scart answers with ACK
+	If we do not get the ACK, we go back to 38400 baud. The scart adapter does the same after a timeout.
+	Returns TRUE iff we use the new rate.
+*/
+int
+negotiate_baud(int rate){
+	char buf[2];
+	
+	if (rate == serial_rate)
+		return 1;
+	if (scart_version < 12){
+		fprintf(stderr, "Scart adapter firmware does not know other baud rates\n");
+		return 0;
+	};
+	
+	tcflush(serial_fd, TCIOFLUSH);
+	buf[0] = DC2;
+	buf[1] = '0' + rate;
+	if (! write_all(serial_fd, buf, 2))
+		return 0;
+	if ( (! read_serial_n(buf, 2)) || (buf[0] != DC2) || (buf[1] != '0' + rate) ){
+		fprintf(stderr, "Scart adapter refused %d baud\n", rate_baud[rate]);
+		return 0;
+	};
+	
+	buf[0] = SYN;
+	if (! write_all(serial_fd, buf, 1))
+		return 0;
+	tcdrain(serial_fd);
+	init_serial(serial_fd, rate_speed[rate], 50);
+	usleep(10000);				// the scart adapter switches when it gets SYN
+	
+	buf[0] = ETX;
+	if ( write_all(serial_fd, buf, 1) && read_serial_n(buf, 1) && (buf[0] == ACK) ){
+		serial_rate = rate;
+		fprintf(stderr, "Serial line now at %d baud\n", rate_baud[rate]);
+		return 1;
+	};
+	
+	fprintf(stderr, "No answer at %d baud, back to %d baud\n", rate_baud[rate], rate_baud[0]);
+	init_serial(serial_fd, rate_speed[0], 50);
+	serial_rate = 0;
+	sleep(BAUD_FALLBACK_SEC);
+	tcflush(serial_fd, TCIOFLUSH);
+	return 0;
+}
 	
 
 /* ------------------- Communication with MPD --------------- */
@@ -616,8 +811,18 @@ int response_line_complete;
 int mpd_socket;
 struct sockaddr_in serverName = { 0 };
 double response_tmr;
+double keepalive_tmr;			// restarted whenever we send a line to Betty
 int response_finished;			// TODO here ?
 
+/* Seconds without an answer line from MPD, before we send "ACK [mpd-timeout]" to Betty.
+	Some commands keep MPD silent for seconds: loading a large playlist, findadd on a big library
+	or the first update. So this is generous. 
+	Betty gives up on a request after 2.2 seconds without a line (REQUEST_TIMEOUT in mpd.c).
+	So while MPD is silent we send a "wait" line every MPD_KEEPALIVE seconds, each in a packet of its own.
+*/
+#define MPD_SILENCE_TIMEOUT 10.0
+#define MPD_KEEPALIVE 1.0
+
 // Reset the line buffer for input from mpd
 void
 reset_mpd_buf(){	
@@ -1148,6 +1353,17 @@ cmp_and_store(char *s){
 	return 1;
 };
 
+/* Sends result i as "name: ". The name from MPD's answer line usually ends with a newline already. */
+static void
+send_result(int i){
+	char *name = results[i].name;
+	
+	serial_output("name: ");
+	serial_output(name);
+	if ( ('\0' == *name) || ('\n' != name[strlen(name) - 1]) )
+		serial_output("\n");
+};
+
 /* Sometimes we want to get the status of MPD immediately after we have sent a command,
 	for instance the "LOAD" command does not give us the new playlist length, which is vital to Betty.
 	So we create a command list with the original command and an appended status command.
@@ -1255,7 +1471,8 @@ filter_playlistinfo(){
 /* 
 	MPD responds to a search command.
 	mpd_emu_arg tells us which type of search is done (Artist, Title, Album)
-	We return the number of results to Betty.
+	We send each new result to Betty as soon as we have it, so the user sees the first ones at once.
+	Then we return the number of results to Betty.
 	We store the first MAX_NUM_RESULTS different results in our cache so we do not have to search again 
 	when Betty wants a specific result.
 	NOTE this filter can close the mpd_socket !
@@ -1286,8 +1503,8 @@ filter_search(void){
 		if (mpd_emu_arg == 0) txt_offset = 8;
 		else txt_offset = 7;
 			
-		if (num_results < MAX_NUM_RESULTS)
-			cmp_and_store(mpd_resp_buf + txt_offset);
+		if ( (num_results < MAX_NUM_RESULTS) && cmp_and_store(mpd_resp_buf + txt_offset) )
+			send_result(num_results - 1);
 				
 		/* MPD sends every single matching file, which can take very long.
 			So after MAX_NUM_RESULTS or after our timer reaches 2 seconds we cancel the connection to stop mpd.
@@ -1314,8 +1531,7 @@ static void
 filter_result(void){
 	// check if argument is within bounds
 	if (mpd_emu_arg < num_results){
-		sprintf(mpd_resp_buf, "name: %s\n", results[mpd_emu_arg].name);
-		serial_output(mpd_resp_buf);
+		send_result(mpd_emu_arg);
 		strcpy(mpd_resp_buf, "OK\n");
 		serial_output(mpd_resp_buf);
 	} else {
@@ -1357,6 +1573,126 @@ filter_cursong(void){
 	serial_output(mpd_resp_buf);
 };
 
+/* Number of playlist positions that Betty caches, as sent with "plchanged". -1 if Betty did not tell us. */
+static int plchanged_window;
+
+/* Betty only wants to know the changed positions in its tracklist cache.
+	We let only "cpos: " lines within the window through and drop the song ids.
+	NOTE mpd_emu_arg must be set to the first position of the window before getting responses from MPD
+*/
+static void
+filter_plchanged(void){
+	int pos;
+	
+	if (0 == strncmp(mpd_resp_buf, "cpos: ", 6)){
+		pos = atoi(mpd_resp_buf + 6);
+		if ( (pos >= mpd_emu_arg) && ( (plchanged_window < 0) || (pos < mpd_emu_arg + plchanged_window) ) )
+			serial_output(mpd_resp_buf);
+		return;
+	};
+	
+	if ( (0 == strncmp(mpd_resp_buf, "OK", 2)) || (0 == strncmp(mpd_resp_buf, "ACK", 3)) )
+		serial_output(mpd_resp_buf);
+};
+
+/* The first position from mpd_emu_arg on and the first one of all that MPD has found */
+static int plfind_next, plfind_first;
+
+/* Betty only wants to know where the next song is that matches.
+	MPD sends every matching song. We only send the position of the first one from mpd_emu_arg on,
+	or of the first one of all, if there is none behind mpd_emu_arg.
+	NOTE mpd_emu_arg must be set to the first position, plfind_next and plfind_first to -1
+	before getting responses from MPD
+*/
+static void
+filter_plfind(void){
+	int pos;
+	
+	if (0 == strncmp(mpd_resp_buf, "Pos: ", 5)){
+		pos = atoi(mpd_resp_buf + 5);
+		if ( (plfind_first < 0) || (pos < plfind_first) )
+			plfind_first = pos;
+		if ( (pos >= mpd_emu_arg) && ((plfind_next < 0) || (pos < plfind_next)) )
+			plfind_next = pos;
+		return;
+	};
+	
+	if (0 == strncmp(mpd_resp_buf, "OK", 2)){
+		pos = (plfind_next >= 0) ? plfind_next : plfind_first;
+		if (pos >= 0){
+			sprintf(mpd_resp_buf, "Pos: %d\n", pos);
+			serial_output(mpd_resp_buf);
+		};
+		strcpy(mpd_resp_buf, "OK\n");
+		serial_output(mpd_resp_buf);
+		return;
+	};
+	
+	if (0 == strncmp(mpd_resp_buf, "ACK", 3))
+		serial_output(mpd_resp_buf);
+};
+
+/* The jump index has one group for names that do not start with a letter and one for each letter A-Z.
+	NOTE This must be the same as JUMP_GROUPS in Betty's model.h
+*/
+#define JUMP_GROUPS 27
+
+/* The first position of each group, -1 if there is none */
+static int jump_index[JUMP_GROUPS];
+/* The initial of the current song. The title wins over the file name. */
+static char jump_initial;
+
+static int
+jump_group(char c){
+	c = toupper((unsigned char) c);
+	return ( (c >= 'A') && (c <= 'Z') ) ? c - 'A' + 1 : 0;
+};
+
+static void
+jump_note(char c, int pos){
+	int g = jump_group(c);
+	
+	if (jump_index[g] < 0)
+		jump_index[g] = pos;
+};
+
+/* Betty does not want all songs or playlist names, only where each initial starts.
+	For the queue (mpd_emu_arg == 0) we get "playlistinfo" from MPD, for the playlists "listplaylists".
+	We answer with one line "jumpindex: " and the first position of each group, "-" if there is none.
+	NOTE mpd_emu_arg must be set and jump_index[] filled with -1 before getting responses from MPD
+*/
+static void
+filter_jumpindex(void){
+	int i, len;
+	
+	if (mpd_emu_arg == 0){
+		if (0 == strncmp(mpd_resp_buf, "file: ", 6))
+			jump_initial = *basename(mpd_resp_buf + 6);
+		if (0 == strncmp(mpd_resp_buf, "Title: ", 7))
+			jump_initial = mpd_resp_buf[7];
+		if (0 == strncmp(mpd_resp_buf, "Pos: ", 5))
+			jump_note(jump_initial, atoi(mpd_resp_buf + 5));
+	} else if (0 == strncmp(mpd_resp_buf, "playlist: ", 10))
+		jump_note(mpd_resp_buf[10], mpd_emu_cnt++);
+	
+	if (0 == strncmp(mpd_resp_buf, "OK", 2)){
+		len = sprintf(mpd_resp_buf, "jumpindex:");
+		for (i = 0; i < JUMP_GROUPS; i++)
+			if (jump_index[i] < 0)
+				len += sprintf(mpd_resp_buf + len, " -");
+			else
+				len += sprintf(mpd_resp_buf + len, " %d", jump_index[i]);
+		strcpy(mpd_resp_buf + len, "\n");
+		serial_output(mpd_resp_buf);
+		strcpy(mpd_resp_buf, "OK\n");
+		serial_output(mpd_resp_buf);
+		return;
+	};
+	
+	if (0 == strncmp(mpd_resp_buf, "ACK", 3))
+		serial_output(mpd_resp_buf);
+};
+
 static void
 filter_none(void){
 	serial_output(mpd_resp_buf);
@@ -1369,6 +1705,120 @@ filter_none(void){
 static void (*filter_hook)(void) = filter_none;
 
 
+/* We answer the "compact" command ourselves. MPD only sees a "ping". */
+static void
+filter_compact(void){
+	if (0 == strncmp(mpd_resp_buf, "OK", 2))
+		serial_output("compact: 1\n");
+	serial_output(mpd_resp_buf);
+};
+
+
+/* 
+	Compact commands from Betty.
+	A byte >= COMPACT_BASE is an opcode, the index into opcodes[] is (byte - COMPACT_BASE).
+	Each %d in the format string is sent as a varint:
+	6 bits per byte, least significant bits first.
+	All bytes except the last one of a number are 0xC0 | bits, the last one is 0x80 | bits.
+	So no byte is ever 0 or a control character that the link layer uses.
+	Several commands in one packet are sent to MPD as a command list with "list_OK" after each command.
+	NOTE The opcodes must be the same as in the cmd_info table of Betty's mpd.c
+*/
+#define COMPACT_BASE 0x80
+
+static const char *opcodes[] = {
+	"play %d\n",			// 0x80
+	"setvol %d\n",			// 0x81
+	"currentsong\n",		// 0x82
+	"previous\n",			// 0x83
+	"next\n",				// 0x84
+	"pause 1\n",			// 0x85
+	"pause 0\n",			// 0x86
+	"play\n",				// 0x87
+	"stop\n",				// 0x88
+	"seek %d %d\n",			// 0x89
+	"status\n",				// 0x8A
+	"playlistinfo %d\n",	// 0x8B
+	"random %d\n",			// 0x8C
+	"repeat %d\n",			// 0x8D
+	"single %d\n",			// 0x8E
+	"playlistcount\n",		// 0x8F
+	"playlistname %d\n",	// 0x90
+	"clear\n",				// 0x91
+	"result %d\n",			// 0x92
+	"script %d\n",			// 0x93
+	"plchanged %d %d %d\n",		// 0x94
+	"jumpindex %d\n"		// 0x95
+};
+
+#define NUM_OPCODES (sizeof(opcodes) / sizeof(opcodes[0]))
+
+/* Reads one varint starting at *s and advances *s behind it.
+	Returns -1 if the number is not complete.
+*/
+static int
+get_varint(unsigned char **s){
+	int val = 0, shift = 0;
+	
+	while ( (**s & 0xC0) == 0xC0 ){
+		val |= (**s & 0x3F) << shift;
+		shift += 6;
+		(*s)++;
+	};
+	if ( (**s & 0xC0) != 0x80 )
+		return -1;
+	val |= (**s & 0x3F) << shift;
+	(*s)++;
+	return val;
+};
+
+/* Expands the compact command(s) in buf to MPD syntax.
+	Returns 0 if buf does not hold valid compact commands. buf is then an empty command.
+*/
+static int
+expand_compact(char *buf){
+	char text[BUFFER_SIZE+1];
+	char line[BUFFER_SIZE+1];
+	unsigned char *s = (unsigned char *) buf;
+	const char *f;
+	int len = 0, num_cmds = 0, n, arg;
+	
+	while (*s >= COMPACT_BASE){
+		if ( (*s - COMPACT_BASE) >= NUM_OPCODES )
+			break;
+		f = opcodes[*(s++) - COMPACT_BASE];
+		n = 0;
+		while (*f && (n < BUFFER_SIZE - 12)){
+			if ( ('%' == f[0]) && ('d' == f[1]) ){
+				if ( (arg = get_varint(&s)) < 0)
+					break;
+				n += sprintf(line + n, "%d", arg);
+				f += 2;
+			} else
+				line[n++] = *(f++);
+		};
+		line[n] = 0;
+		if (*f || (len + n > BUFFER_SIZE - 40) )
+			break;					// invalid argument or too long
+		strcpy(text + len, line);
+		len += n;
+		num_cmds++;
+	};
+	
+	if ( (0 == num_cmds) || (*s && ('\n' != *s)) ){
+		fprintf(stderr, "Invalid compact command\n");
+		strcpy(buf, "\n");
+		return 0;
+	};
+	
+	if (1 == num_cmds)
+		strcpy(buf, text);
+	else
+		sprintf(buf, "command_list_ok_begin\n%scommand_list_end\n", text);
+	return 1;
+};
+
+
 /* Copy the serial input buffer to the given mpd_input_buffer buf.
 	Commands which are not available are emulated if possible
 	Resets serial input buffer.
@@ -1385,6 +1835,16 @@ translate_to_mpd(char *buf){
 	/* Just to make sure we have a valid C-string */
 	buf[BUFFER_SIZE] = 0;
 	
+	/* Compact commands are expanded first, the result is handled like any other command */
+	if ( (unsigned char) buf[0] >= COMPACT_BASE )
+		expand_compact(buf);
+	
+	/* Betty asks if we understand compact commands */
+	if (0 == strncmp(buf, "compact\n", strlen("compact\n")) ){
+		filter_hook = filter_compact;
+		strcpy(buf, "ping\n");
+	};
+	
 // The script commands are not given to mpd, but executed directly	
 // MPD sees the "ping" command and returns  "OK"
 	
@@ -1442,6 +1902,58 @@ translate_to_mpd(char *buf){
 		strcpy(buf, "listplaylists\n");
 	};
 
+	/* The command "plchanged version first window" is our own invention.
+		It returns the positions from first to first + window - 1 
+		that changed since the playlist version "version".
+		Betty then only has to refresh those entries of its tracklist cache.
+		Without a window we return all changed positions from first on.
+	*/
+	if (0 == strncmp(buf, "plchanged ", strlen("plchanged ")) ){
+		char *s;
+		int version = strtol(buf + strlen("plchanged "), &s, 10);
+		
+		mpd_emu_arg = strtol(s, &s, 10);
+		plchanged_window = strtol(s, &s, 10);
+		if (plchanged_window <= 0)
+			plchanged_window = -1;
+		filter_hook = filter_plchanged;
+		sprintf(buf, "plchangesposid %d\n", version);
+	};
+	
+	/* The command "plfind first string" is our own invention.
+		It returns the position ("Pos: ") of the first song from position first on
+		that contains string in any tag. If there is none, it starts again at the beginning of the playlist.
+		The answer has no "Pos: " line if no song matches at all.
+	*/
+	if (0 == strncmp(buf, "plfind ", strlen("plfind ")) ){
+		char bufarg[BUFFER_SIZE];
+		char *s;
+		
+		mpd_emu_arg = strtol(buf + strlen("plfind "), &s, 10);
+		while (*s == ' ')
+			s++;
+		strcpy(bufarg, s);
+		bufarg[strcspn(bufarg, "\n")] = 0;
+		plfind_next = plfind_first = -1;
+		filter_hook = filter_plfind;
+		sprintf(buf, "playlistsearch any \"%s\"\n", bufarg);
+	};
+	
+	/* The command "jumpindex list" is our own invention.
+		It returns the first position of each initial letter in the queue (list 0, by title)
+		or in the playlists (list 1, by name), see filter_jumpindex().
+	*/
+	if (0 == strncmp(buf, "jumpindex ", strlen("jumpindex ")) ){
+		int i;
+		
+		mpd_emu_arg = atoi(buf + strlen("jumpindex "));
+		for (i = 0; i < JUMP_GROUPS; i++)
+			jump_index[i] = -1;
+		jump_initial = 0;
+		filter_hook = filter_jumpindex;
+		strcpy(buf, (mpd_emu_arg == 0) ? "playlistinfo\n" : "listplaylists\n");
+	};
+	
 	/* The listplaylists command is not available in older versions of mpd 
 		We substitute "lsinfo" for it
 	*/
@@ -1545,14 +2057,22 @@ int main(int argc, char *argv[])
 	char *serial_device;
 	struct termios oldtio;
 	int time_out_lim = 1, time_out_cnt = 0;
+	int want_rate = 2;			// 115200 baud
 	double total_tmr;
 	char mpd_input_buf[BUFFER_SIZE+1];
+	char tag_line[TAG_LINE_LEN];
+	char keepalive_line[20];
 	
 	fprintf(stderr, "%s Version %d.%d\n", argv[0], VERSION_MAJOR, VERSION_MINOR);
 	
-	if (4 != argc)
+	if (5 == argc){
+		for (want_rate = 0; want_rate < NUM_RATES; want_rate++)
+			if (atoi(argv[4]) == rate_baud[want_rate])
+				break;
+	};
+	if ( ((4 != argc) && (5 != argc)) || (want_rate >= NUM_RATES) )
  	{
-		fprintf(stderr, "Usage: %s <serial_device> <serverHost> <serverPort>\n", argv[0]);
+		fprintf(stderr, "Usage: %s <serial_device> <serverHost> <serverPort> [38400|57600|115200|230400]\n", argv[0]);
 		exit(1);
 	};
 	
@@ -1580,6 +2100,7 @@ int main(int argc, char *argv[])
 			exit(20);
 		};	
 	};
+	negotiate_baud(want_rate);
 	
 	init_mpd(argv[2], atoi(argv[3]));
 
@@ -1605,7 +2126,8 @@ int main(int argc, char *argv[])
 		while we were waiting for a command from Betty.
 			Simply discard those responses.
 		Or Betty could send the next command even if we are still waiting for responses from MPD.
-			Betty has given up waiting for the answer. So do we.
+			If it is untagged, Betty has given up waiting for the answer. So do we.
+			If it is tagged, it is queued and handled after the current one.
 				
 	*/
 	
@@ -1616,11 +2138,13 @@ int main(int argc, char *argv[])
 	
 	reset_ser_in();
 	reset_ser_out();
+	cmd_queue_first = 0;
+	cmd_queue_cnt = 0;
 		
 	while (1){	
 		
 		// if nothing to do, wait for some time (61 secs) for input	
-		if (! cmd_complete){
+		if ( (! cmd_complete) && (0 == cmd_queue_cnt) ){
 			res = wait_for_input(serial_fd, mpd_socket, 61000);
 
 			// if still no input, check if scart adapter (and Betty) is alive.
@@ -1628,7 +2152,16 @@ int main(int argc, char *argv[])
 				/* No (more) input for some time. Forget all previous bytes */
 				fprintf(stderr,"No command from Betty for some time.\n");
 
-				if (!scart_alive()){				
+				if (!scart_alive()){
+					/* The scart adapter might have been reset, it starts with 38400 baud */
+					if (serial_rate != 0){
+						init_serial(serial_fd, rate_speed[0], 50);
+						serial_rate = 0;
+						if (scart_alive()){
+							negotiate_baud(want_rate);
+							continue;
+						};
+					};
 					if (++time_out_cnt >= time_out_lim){
 						reboot_scart(serial_fd);
 						time_out_cnt = 0;
@@ -1643,30 +2176,56 @@ int main(int argc, char *argv[])
 			reset_mpd_buf();
 		
 		// read more bytes until command is complete
-		if (!cmd_complete) continue;
+		if ( (!cmd_complete) && (0 == cmd_queue_cnt) ) continue;
+		
+		/* An untagged command has priority, it cancelled everything before */
+		if (cmd_complete){
+			prt_timer(total_tmr); fprintf(stderr, "BETTY: %s", ser_in_buf);
 		
-		prt_timer(total_tmr); fprintf(stderr, "BETTY: %s", ser_in_buf);
+			/* Free serial input buffer */
+			copy_serial_in(mpd_input_buf);
+		} else {
+			unqueue_cmd(mpd_input_buf);
+			prt_timer(total_tmr); fprintf(stderr, "BETTY: %s", mpd_input_buf);
+		};
 		
-		/* Free serial input buffer */
-		copy_serial_in(mpd_input_buf);
+		split_tag(mpd_input_buf, tag_line);
 		
-		translate_to_mpd (mpd_input_buf);
+		/* The user has typed on, we do not bother MPD with this search */
+		if (search_superseded(mpd_input_buf)){
+			fprintf(stderr, "  Search superseded.\n");
+			reset_ser_out();
+			serial_output(tag_line);
+			serial_output(SUPERSEDED_ACK);
+			ser_out_char(EOT);
+			response_finished = 1;
+		} else {
+			translate_to_mpd (mpd_input_buf);
 		
-		fprintf(stderr, "(Betty): %s", mpd_input_buf);
+			fprintf(stderr, "(Betty): %s", mpd_input_buf);
 		
-		// got a complete input via serial line
-		// send it to MPD, start response_tmr
-		// resets mpd_resp_buf to allow fresh input
-		res = mpd_start_cmd (mpd_input_buf);
-		if (0 == res)
-			fprintf(stderr,"Sending cmd to MPD failed\n");
+			// got a complete input via serial line
+			// send it to MPD, start response_tmr
+			// resets mpd_resp_buf to allow fresh input
+			res = mpd_start_cmd (mpd_input_buf);
 		
-		// reset the serial output buffer
-		// All previous bytes are not a response to this command
-		reset_ser_out();
-
-		// The response is not finished yet. 
-		response_finished = 0;
+			// reset the serial output buffer
+			// All previous bytes are not a response to this command
+			reset_ser_out();
+		
+			// Tell Betty which request this answer belongs to
+			serial_output(tag_line);
+			init_timer(&keepalive_tmr);
+
+			// The response is not finished yet, unless we could not reach MPD at all. 
+			response_finished = 0;
+			if (0 == res){
+				fprintf(stderr,"Sending cmd to MPD failed\n");
+				serial_output("ACK [mpd-unreachable]\n");
+				ser_out_char(EOT);
+				response_finished = 1;
+			};
+		};
 		
 		/* We will break out of this loop if another command from serial is detected */
 		while (! response_finished){
@@ -1682,21 +2241,44 @@ int main(int argc, char *argv[])
 				response_line_complete = 0;
 				break;
 			};
+			
+			// The user has typed on, the names found so far are sent and the rest is of no use
+			if (search_superseded(mpd_input_buf)){
+				prt_timer(total_tmr);
+				fprintf(stderr, "  Search superseded. MPD response cancelled.\n");
+				close_mpd_socket();
+				serial_output(SUPERSEDED_ACK);
+				ser_out_char(EOT);
+				response_line_complete = 0;
+				break;
+			};
 				
 			// if there are bytes in the output buffer, send them to serial if it is ready
 			send_to_serial(serial_fd);
 			
 			if (!res){
-				if (timer_diff(response_tmr) > 10.0){
+				if (timer_diff(response_tmr) > MPD_SILENCE_TIMEOUT){
 					prt_timer(total_tmr);
 					fprintf(stderr,"MPD response is too late\n");
 					close_mpd_socket();
+					serial_output("ACK [mpd-timeout]\n");
+					ser_out_char(EOT);
 					break;
 				}
+				
+				// Betty must not give up on us while MPD is busy
+				if (timer_diff(keepalive_tmr) > MPD_KEEPALIVE){
+					sprintf(keepalive_line, "wait: %d\n", (int) timer_diff(response_tmr));
+					serial_output(keepalive_line);
+					ser_out_char(EOT);
+					init_timer(&keepalive_tmr);
+				};
 			};
 			
 			if (response_line_complete){
 				fprintf(stderr, "  MPD: %s", mpd_resp_buf);
+				init_timer(&response_tmr);			// MPD is still alive
+				init_timer(&keepalive_tmr);
 
 				// check for "OK" or "ACK" and send response to Betty
 				if ( (response_finished = translate_to_serial()) ) {
@@ -44,6 +44,7 @@
 #define MAX_PKTLEN		0x3D
 
 // status register of the CC1100
+#define RSSI			0x34
 #define MARCSTATE		0x35
 #define PKTSTATUS		0x38 
 #define RXBYTES			0x3B
@@ -23,8 +23,9 @@
 		
 	- We will receive some bytes over radio. This can happen any time.
 		We inform the application about it. 
-	TODO 	
-	- We can put the radio to sleep, if no activity is required to save battery power.
+		
+	- The radio sleeps in wake on radio mode while no answer is expected (see rf_sleep()).
+		It wakes up by itself for a packet, and rf_wake() wakes it before we send.
 	
 */
 
@@ -49,6 +50,24 @@ switch_to_idle() {
 
 #define RX_OVERFLOW 17
 
+/* Bit in PKTSTATUS, set when a sync word has been received and the packet is not finished yet */
+#define PKTSTATUS_SFD (1<<3)
+
+/* Bit in PKTSTATUS, set when the channel is clear (RSSI below threshold and not receiving) */
+#define PKTSTATUS_CCA (1<<4)
+
+/* RSSI register value to dBm: (signed) value / 2 - RSSI_OFFSET */
+#define RSSI_OFFSET 75
+
+/* MCSM2 while we are awake: RX only ends at the end of a packet */
+#define MCSM2_RX	0x07
+
+/* MCSM2 for wake on radio: RX ends early if there is no carrier (RX_TIME_RSSI), else after RX_TIME 4 */
+#define MCSM2_WOR	0x14
+
+/* 1 while the radio is in wake on radio mode */
+static uint8_t rf_sleeping;
+
 /* This routine checks if reception is stuck in RX_OVERFLOW state.
 	If so, it flushes the buffer and resets radio to RX */
 void
@@ -59,6 +78,49 @@ rx_reset(){
 	};
 };
 
+/* The radio is IDLE now. Restore the settings for permanent RX. */
+static void
+rf_awake_regs(){
+	if (rf_sleeping){
+		cc1100_write_reg(MCSM2, MCSM2_RX);
+		rf_sleeping = 0;
+	};
+};
+
+/* Put the radio into wake on radio mode.
+	The CC1100 then polls the channel every EVENT0 (0.5 sec) and wakes up fully only if it receives a packet.
+	This saves most of the power used by the radio.
+	NOTE Packets from the scart adapter have a short preamble, so answers are only received while we are awake.
+*/
+void
+rf_sleep(){
+	if (rf_sleeping || rf_rx_active() || ! rx_buf_empty())
+		return;
+	switch_to_idle();
+	cc1100_write_reg(MCSM2, MCSM2_WOR);
+	cc1100_strobe(SWORRST);
+	cc1100_strobe(SWOR);
+	rf_sleeping = 1;
+};
+
+/* Back to permanent RX. Takes well below 1 ms. */
+void
+rf_wake(){
+	if (! rf_sleeping)
+		return;
+	switch_to_idle();
+	rf_awake_regs();
+	cc1100_strobe(SRX);
+};
+
+/* Returns TRUE iff the radio is just receiving a packet.
+	RF_send() would destroy that packet, so callers which are not in a hurry should wait.
+*/
+int
+rf_rx_active(){
+	return (cc1100_read_status_reg_otf(PKTSTATUS) & PKTSTATUS_SFD);
+};
+
 /* ----------------------------------- Sending a single packet over radio--------------------------------------------- */
 
 /* Send the contents of buffer b over radio 
@@ -116,48 +178,185 @@ RF_send(unsigned char* b, int payload_cnt) {
 
 /* Under all circumstances do we want to avoid cluttering the air waves with our comunication, because other devices
 	might be sending on the same channel (like some radio remote controls).
-	So we throttle the possible sending rate to 1 send per SEND_BANDWIDTH seconds average.
-	We do this by keeping a variable send_token, which allows sending messages as long as it is not 0.
-	Each send consumes 1 token.
-	A task regularily produces 1 token per SEND_BANDWIDTH seconds.
-	We initialize send_token with around 2000 so that we can send more at start up.
-	We may need a lot of tokens when reading long playlists, so 2000 is not too much.
-	We also limit the token to 2000, so Worst case is betty gone wild sends 2000 messages in rapid 
-	succession, but after that is throttled to 1 message per SEND_BANDWIDTH seconds.
+	So we keep an airtime budget, counted in bytes that we put on the air (see airtime_cost()).
+	Each packet consumes its bytes from the budget.
+	A task refills the budget every AIRTIME_TICK by AIRTIME_REFILL bytes, which is around 1% of the airtime.
+	If we observe other transmitters on the channel, we only refill half as much.
+	The budget starts full, so that we can read long playlists at start up.
+	AIRTIME_MAX is enough for about 2000 short packets (around 13 s of air at 38.4 kBaud).
+	
+	Packets have a priority. Low priority packets (filling caches etc.) are only sent while the budget 
+	is above AIRTIME_RESERVE, so that there is always room for the commands of the user.
+	If the budget is too low for a packet, we queue it and send it as soon as the budget allows.
+	If the queue is full, send_cmd() tells the caller that the packet was not taken.
+	So worst case is betty gone wild sends AIRTIME_MAX bytes in rapid succession,
+	but after that is throttled to AIRTIME_REFILL bytes per AIRTIME_TICK.
 */
 
-#define SEND_BANDWIDTH	(2*TICKS_PER_SEC)
-#define MAX_SEND_TOKEN	2000
-#define INIT_SEND_TOKEN	2000
+#define AIRTIME_TICK		(1*TICKS_PER_TENTH_SEC)
+#define AIRTIME_REFILL		5
+#define AIRTIME_MAX		64000
+#define AIRTIME_RESERVE		1000
+
+/* Preamble (4), sync word (4), length, address, EOT and CRC (2) are sent with every packet */
+#define AIRTIME_OVERHEAD	13
 
-static int send_token = INIT_SEND_TOKEN;
+/* We look at the channel once per AIRTIME_TICK. 
+	If it was busy at least CHANNEL_BUSY_LIM times during the last CHANNEL_SAMPLES looks, 
+	somebody else is using the channel.
+	The CCA threshold of the chip is fixed, so we also learn the noise floor of our surroundings:
+	it follows lower RSSI values at once and rises by 1 dB per CHANNEL_SAMPLES looks.
+	A look RSSI_BUSY_MARGIN dB above the noise floor counts as busy, too.
+*/
+#define CHANNEL_SAMPLES		10
+#define CHANNEL_BUSY_LIM	3
+#define RSSI_BUSY_MARGIN	10
+
+static int airtime = AIRTIME_MAX;
+static uint8_t channel_busy;			// number of busy looks in the current sample period
+static uint8_t channel_shared;			// 1 if somebody else is using our channel
+static int noise_floor;					// in dBm, starts high so that the first look sets it
+static unsigned int last_tx;			// system time when the last packet was sent
+
+/* Packets which wait for airtime, high priority packets first */
+#define TX_QUEUE_LEN 2
+
+static struct {
+	int prio;
+	char str[255];
+} tx_queue[TX_QUEUE_LEN];
+static int tx_queued;					// number of packets in tx_queue
+
+static int
+airtime_cost(int len){
+	return len + AIRTIME_OVERHEAD;
+};
 
+/* Returns TRUE iff we can send len bytes with priority prio now */
+static int
+airtime_ok(int len, int prio){
+	int reserve = (prio == RF_PRIO_LOW) ? AIRTIME_RESERVE : 0;
+	
+	return (airtime - airtime_cost(len) >= reserve);
+};
+
+static void
+send_now(char *cmd_str, int len){
+	rf_wake();
+	RF_send((unsigned char *) cmd_str, len);
+	airtime -= airtime_cost(len);
+	last_tx = system_time();
+};
+
+/* Sends queued packets as long as the budget allows */
+static void
+tx_queue_flush(){
+	int len, i;
+	
+	while (tx_queued > 0){
+		len = strlen(tx_queue[0].str);
+		if (! airtime_ok(len, tx_queue[0].prio))
+			return;
+		send_now(tx_queue[0].str, len);
+		tx_queued--;
+		for (i=0; i < tx_queued; i++)
+			tx_queue[i] = tx_queue[i+1];
+	};
+};
+
+/* Puts a packet into the queue behind all packets with the same or higher priority.
+	Packets already queued are never dropped, their senders rely on them.
+	Returns FALSE iff the queue is full.
+*/
+static int
+tx_queue_add(char *cmd_str, int prio){
+	int i;
+	
+	if (tx_queued == TX_QUEUE_LEN){
+		debug_out("THROTTLED! ", prio);
+		return 0;
+	};
+	
+	for (i = tx_queued; (i > 0) && (tx_queue[i-1].prio < prio); i--)
+		tx_queue[i] = tx_queue[i-1];
+	tx_queue[i].prio = prio;
+	strlcpy(tx_queue[i].str, cmd_str, sizeof(tx_queue[i].str));
+	tx_queued++;
+	return 1;
+};
 
 /* Give a command string to RF module
-	The string can be freed after return because it is in TXFIFO.
-	NOTE: No error handling, because we can do not much if sending fails.
+	The string can be freed after return because it is in TXFIFO or in our queue.
+	Returns FALSE iff the packet was not taken, because there is neither airtime nor room in the queue.
+	The caller should then try again later, rf_tx_queued() tells when the queue is empty.
 */	
-void
-send_cmd(char *cmd_str){
-	if (send_token > 0){
+int
+send_cmd(char *cmd_str, int prio){
+	int len = strlen(cmd_str);
+	
+	tx_queue_flush();					// the budget may have grown since the last tick
+	if ( (0 == tx_queued) && airtime_ok(len, prio) ){
+		send_now(cmd_str, len);
+		return 1;
+	};
+	if (! tx_queue_add(cmd_str, prio))
+		return 0;
+	tx_queue_flush();
+	return 1;
+};
+
+/* Returns the number of packets that wait for airtime */
+int
+rf_tx_queued(){
+	return tx_queued;
+};
 
-		RF_send((unsigned char *) cmd_str, strlen(cmd_str));
-		send_token--;
-	} else debug_out("THROTTLED! ",00);
+/* Returns the system time when we last put a packet on the air */
+unsigned int
+rf_last_tx(){
+	return last_tx;
 };
 
+/* Somebody else is transmitting, if the channel is not clear although we do not receive a packet */
+static void
+look_at_channel(){
+	static uint8_t samples;
+	uint8_t status;
+	int rssi;
+	
+	if (rf_sleeping)
+		return;						// we do not listen permanently
+	
+	status = cc1100_read_status_reg_otf(PKTSTATUS);
+	rssi = ( ((signed char) cc1100_read_status_reg_otf(RSSI)) >> 1) - RSSI_OFFSET;
+	if (status & PKTSTATUS_SFD)
+		return;						// a packet for us is coming in, that is not somebody else
+	
+	if (rssi < noise_floor)
+		noise_floor = rssi;
+	if ( (! (status & PKTSTATUS_CCA)) || (rssi > noise_floor + RSSI_BUSY_MARGIN) )
+		channel_busy++;
+	
+	if (++samples >= CHANNEL_SAMPLES){
+		channel_shared = (channel_busy >= CHANNEL_BUSY_LIM);
+		channel_busy = 0;
+		samples = 0;
+		noise_floor++;				// the surroundings may have become noisier
+	};
+};
 
 static
-PT_THREAD (produce_send_token(struct pt *pt)) {
+PT_THREAD (airtime_refill(struct pt *pt)) {
 	static struct timer tmr;
 	
 	PT_BEGIN(pt);
-	timer_add(&tmr, SEND_BANDWIDTH, SEND_BANDWIDTH);	
+	timer_add(&tmr, AIRTIME_TICK, AIRTIME_TICK);	
 	while (1){	
 		PT_WAIT_UNTIL(pt, timer_expired(&tmr));
 		tmr.expired = 0;
-		if (send_token < MAX_SEND_TOKEN)
-			send_token++;
+		look_at_channel();
+		airtime = min(AIRTIME_MAX, airtime + (channel_shared ? AIRTIME_REFILL / 2 : AIRTIME_REFILL));
+		tx_queue_flush();
 	};	
 	PT_END(pt);
 };
@@ -258,7 +457,6 @@ startcc1100IRQ(void) {
 
 /* NOTE This signal strength indicator is set by rfRcvPacket, but it is not currently used */
 static int rssi_dbm;
-#define RSSI_OFFSET 75
 
 
 /* ---------------------------Bottom half for reception---------------------------------------------- */
@@ -298,6 +496,7 @@ rfRcvPacket() {
 		// Something went wrong. Discard complete RX FIFO
 		debug_out("rcvd invalid packet", 0);
 		switch_to_idle();
+		rf_awake_regs();
 		cc1100_strobe(SFRX);
 		cc1100_strobe(SRX);
 		return;
@@ -307,6 +506,7 @@ rfRcvPacket() {
 	
 	// Reading complete RX FIFO is only safe if not in RX
 	switch_to_idle();				
+	rf_awake_regs();				// somebody talks to us, so we stay awake
 
 	cc1100_read_fifo(tmp_buf, cc1100_rx_len-1);
 	
@@ -361,7 +561,7 @@ rxInit(void) {
 	cc1100_write_reg(MCSM1,0x0F);
 	
 	// RX timeout is until end of packet
-	cc1100_write_reg(MCSM2, 0x07);
+	cc1100_write_reg(MCSM2, MCSM2_RX);
 	
 	// Reset state and set radio in RX mode
 	// Safe to set states, as radio is IDLE
@@ -378,7 +578,7 @@ void
 RF_init (void) {
 	cc1100_init();
 
-	task_add(&produce_send_token);
+	task_add(&airtime_refill);
 	init_rx_buf();
 	rxInit();
 	startcc1100IRQ();
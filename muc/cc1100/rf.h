@@ -20,7 +20,16 @@
 #define RF_H
 
 void rx_reset(void);
-void send_cmd(char *cmd_str);
+int rf_rx_active(void);
+/* Priorities for send_cmd() */
+#define RF_PRIO_LOW		0
+#define RF_PRIO_HIGH	1
+
+int send_cmd(char *cmd_str, int prio);
+void rf_sleep(void);
+void rf_wake(void);
+int rf_tx_queued(void);
+unsigned int rf_last_tx(void);
 int rx_buf_empty(void);
 uint8_t get_from_rx_buf();
 void rxIRQ();
@@ -50,7 +50,7 @@ static void (*write_pattern) (uint8 row, uint8 col, uint8 l, uint8 mask, uint8 p
 */
 
 /* Before drawing to a given page, we have to tell the LCD the page number (0..21). Only pages 0..19 are visible.  */
-#define lcd_set_page(page_no) {LCD_CMD = 0xB0;LCD_CMD = page_no;}
+#define lcd_set_page(page_no) {lcd_cmd(0xB0);lcd_cmd(page_no);}
 
 /* We often do not want to address a specific page, but a given row. 
 	We set the page from the row number (0..175). Only rows 0..159 are visible.
@@ -61,7 +61,7 @@ static void (*write_pattern) (uint8 row, uint8 col, uint8 l, uint8 mask, uint8 p
 	Valid are values from 0 ... 127.
 	NOTE does not check for a valid column
 */
-#define lcd_set_coladr(col) {LCD_CMD = 0x10 + ((col) >> 4);LCD_CMD = (col) & 0x0F;}
+#define lcd_set_coladr(col) {lcd_cmd(0x10 + ((col) >> 4));lcd_cmd((col) & 0x0F);}
 
 
 
@@ -94,14 +94,14 @@ _read_lcd(uint8 row, uint8 col, uint8 w){
 	lcd_set_rowadr(row);
 	lcd_set_coladr(col);
 	
-	d = LCD_DATA;		// Dummy Data Read; LCD chip needs this
+	d = lcd_read();		// Dummy Data Read; LCD chip needs this
 		
 	for (i=0; i<w; i++){
-		rcubuf[0][i] = LCD_DATA;
-		rcubuf[1][i] = LCD_DATA;
+		rcubuf[0][i] = lcd_read();
+		rcubuf[1][i] = lcd_read();
 	};
 	
-	d = LCD_DATA;		// Another read, why that ? Maybe bug in chip, does not work correctly without
+	d = lcd_read();		// Another read, why that ? Maybe bug in chip, does not work correctly without
 }
 
 
@@ -115,12 +115,12 @@ popup_save(){
 	for (page=0; page < POPUP_PAGES; page++){
 		lcd_set_page(POPUP_STARTPAGE + page);
 		lcd_set_coladr(0);
-		d = LCD_DATA;		// Dummy Data Read; LCD chip needs this
+		d = lcd_read();		// Dummy Data Read; LCD chip needs this
 		for (i=0, col=0; col<128; col++){
-			popup_buf[page][i++] = LCD_DATA;
-			popup_buf[page][i++] = LCD_DATA;
+			popup_buf[page][i++] = lcd_read();
+			popup_buf[page][i++] = lcd_read();
 		};
-		d = LCD_DATA;		// Another read, why that ? Maybe bug in chip, does not work correctly without
+		d = lcd_read();		// Another read, why that ? Maybe bug in chip, does not work correctly without
 	};
 
 }
@@ -136,8 +136,8 @@ popup_restore(){
 		lcd_set_page(POPUP_STARTPAGE + page);
 		lcd_set_coladr(0);
 		for (i=0, col=0; col<128; col++){
-			LCD_DATA = popup_buf[page][i++];
-			LCD_DATA = popup_buf[page][i++];
+			lcd_write(popup_buf[page][i++]);
+			lcd_write(popup_buf[page][i++]);
 		};
 	};
 }
@@ -155,8 +155,8 @@ _write_pattern(uint8 row, uint8 col, uint8 l, uint8 mask, uint8 pattern0, uint8
 		lcd_set_rowadr(row);
 		lcd_set_coladr(col);
 		for (i=0; i<l; i++){
-			LCD_DATA = pattern0;
-			LCD_DATA = pattern1;
+			lcd_write(pattern0);
+			lcd_write(pattern1);
 		}
 	} else {
 		_read_lcd(row, col, l);
@@ -164,8 +164,8 @@ _write_pattern(uint8 row, uint8 col, uint8 l, uint8 mask, uint8 pattern0, uint8
 		lcd_set_coladr(col);
 
 		for (i=0; i<l; i++){
-			LCD_DATA = (rcubuf[0][i] & ~mask) | (pattern0 & mask);
-			LCD_DATA = (rcubuf[1][i] & ~mask) | (pattern1 & mask);
+			lcd_write((rcubuf[0][i] & ~mask) | (pattern0 & mask));
+			lcd_write((rcubuf[1][i] & ~mask) | (pattern1 & mask));
 		}
 	};
 }
@@ -185,8 +185,8 @@ _overlay_shiftr(uint8 row, uint8 col, uint8 l, uint8 mask, uint8 s){
 		lcd_set_rowadr(row);
 		lcd_set_coladr(col);
 		for (i=0; i<l; i++){
-			LCD_DATA = drawbuf16[0][i] >> s;
-			LCD_DATA = drawbuf16[1][i] >> s;
+			lcd_write(drawbuf16[0][i] >> s);
+			lcd_write(drawbuf16[1][i] >> s);
 		}
 	} else {
 		_read_lcd(row, col, l);
@@ -194,8 +194,8 @@ _overlay_shiftr(uint8 row, uint8 col, uint8 l, uint8 mask, uint8 s){
 		lcd_set_coladr(col);
 
 		for (i=0; i<l; i++){
-			LCD_DATA = (rcubuf[0][i] & ~mask) | ((drawbuf16[0][i] >> s) & mask);
-			LCD_DATA = (rcubuf[1][i] & ~mask) | ((drawbuf16[1][i] >> s) & mask);
+			lcd_write((rcubuf[0][i] & ~mask) | ((drawbuf16[0][i] >> s) & mask));
+			lcd_write((rcubuf[1][i] & ~mask) | ((drawbuf16[1][i] >> s) & mask));
 		}
 	};
 }
@@ -215,8 +215,8 @@ _overlay_shiftl(uint8 row, uint8 col, uint8 l, uint8 mask, uint8 s){
 		lcd_set_rowadr(row);
 		lcd_set_coladr(col);
 		for (i=0; i<l; i++){
-			LCD_DATA = drawbuf16[0][i] << s;
-			LCD_DATA = drawbuf16[1][i] << s;
+			lcd_write(drawbuf16[0][i] << s);
+			lcd_write(drawbuf16[1][i] << s);
 		}
 	} else {
 		_read_lcd(row, col, l);
@@ -224,8 +224,8 @@ _overlay_shiftl(uint8 row, uint8 col, uint8 l, uint8 mask, uint8 s){
 		lcd_set_coladr(col);
 
 		for (i=0; i<l; i++){
-			LCD_DATA = (rcubuf[0][i] & ~mask) | ((drawbuf16[0][i] << s) & mask);
-			LCD_DATA = (rcubuf[1][i] & ~mask) | ((drawbuf16[1][i] << s) & mask);
+			lcd_write((rcubuf[0][i] & ~mask) | ((drawbuf16[0][i] << s) & mask));
+			lcd_write((rcubuf[1][i] & ~mask) | ((drawbuf16[1][i] << s) & mask));
 		}
 	};
 }
@@ -314,8 +314,8 @@ _do_scroll(uint8 row, uint8 col, uint8 width, uint8 bitmask, uint8 offset){
 	lcd_set_rowadr(row);
 	lcd_set_coladr(col);
 	for (i=0; i < width - offset; i++){
-		LCD_DATA = (rcubuf[0][i] & com_bitmask) | (rcubuf[0][i+offset] & bitmask);
-		LCD_DATA = (rcubuf[1][i] & com_bitmask) | (rcubuf[1][i+offset] & bitmask);
+		lcd_write((rcubuf[0][i] & com_bitmask) | (rcubuf[0][i+offset] & bitmask));
+		lcd_write((rcubuf[1][i] & com_bitmask) | (rcubuf[1][i+offset] & bitmask));
 	};
 }
 	
@@ -580,8 +580,8 @@ void lcd_fill(unsigned char f){
 		lcd_set_coladr(0);
 		
 		for(col=0; col<128; col++){
-			LCD_DATA = f;
-			LCD_DATA = f;
+			lcd_write(f);
+			lcd_write(f);
 		}
 	}
 }
@@ -592,75 +592,75 @@ static void
 lcd_set(unsigned char s) {
 	if(s == 0)
 	{
-		LCD_CMD = 0xA0;		// set segment remap (00H mapped to seg0)
-		LCD_CMD = 0xC8;		// set com output scan direction (remapped mode)
+		lcd_cmd(0xA0);		// set segment remap (00H mapped to seg0)
+		lcd_cmd(0xC8);		// set com output scan direction (remapped mode)
 	}
 	else
 	{
-		LCD_CMD = 0xA1;		// set segment remap (7FH mapped to seg0)
-		LCD_CMD = 0xC0;		// set com output scan direction (normal mode)
+		lcd_cmd(0xA1);		// set segment remap (7FH mapped to seg0)
+		lcd_cmd(0xC0);		// set com output scan direction (normal mode)
 	}
 }
 
 void 
 lcd_enable(unsigned char e){
 	if(e) {
-		LCD_CMD = 0xAF;		// set display on
+		lcd_cmd(0xAF);		// set display on
 	} else {
-		LCD_CMD = 0xAE;		// set display off
+		lcd_cmd(0xAE);		// set display off
 	};
 }
 
 void 
 lcd_init(unsigned char s) {
-	LCD_CMD = 0xE1;		// exit power save mode
-	LCD_CMD = 0xE2;		// software reset
+	lcd_cmd(0xE1);		// exit power save mode
+	lcd_cmd(0xE2);		// software reset
 	delay(100000);		// around 10 ms
-	LCD_CMD = 0xAB;		// start internal oscillator
-	LCD_CMD = 0x27;		// set internal regulator resistor ratio (8.1)
-	LCD_CMD = 0x81;		// volume cmd
-	LCD_CMD = 0x3A; 	// volume cmd value
-	LCD_CMD = 0x65;		// set DC-DC converter factor (4x)
-	LCD_CMD = 0x60;		// set upper window corner ax cmd
-	LCD_CMD = 0x1C;		// set upper window corner ax value
-	LCD_CMD = 0x61;		// set upper window corner ay cmd
-	LCD_CMD = 0x0A;		// set upper window corner ay value
-	LCD_CMD = 0x62;		// set lower window corner bx cmd
-	LCD_CMD = 0x75;		// set lower window corner bx value
-	LCD_CMD = 0x63;		// set lower window corner by cmd
-	LCD_CMD = 0x81;		// set lower window corner by value
-	LCD_CMD = 0x90;		// set PWM and FRC (4-frames)
-	LCD_CMD = 0x88;		// set white mode frame  2nd and 1st cmd
-	LCD_CMD = 0x00;		// set white mode frame  2nd and 1st value
-	LCD_CMD = 0x89;		// set white mode frame  4th and 3rd cmd
-	LCD_CMD = 0x00;		// set white mode frame  4th and 3rd value
-	
-	LCD_CMD = 0x8A;		// set light gray mode frame  2nd and 1st cmd
-//	LCD_CMD = 0x36;		// set light gray mode frame  2nd and 1st value
-	LCD_CMD = 0x33;
-
-	LCD_CMD = 0x8B;		// set light gray mode frame  4th and 3rd cmd
-	LCD_CMD = 0x63;		// set light gray mode frame  4th and 3rd vakue
-//	LCD_CMD = 0x33;
-	
-	LCD_CMD = 0x8C;		// set dark gray mode frame  2nd and 1st cmd
-	LCD_CMD = 0x67;		// set dark gray mode frame  2nd and 1st value
-	LCD_CMD = 0x8D;		// set dark gray mode frame  4th and 3rd cmd
-	LCD_CMD = 0x76;		// set dark gray mode frame  4th and 3rd vakue
-	LCD_CMD = 0x8E;		// set black mode frame  2nd and 1st cmd
-	LCD_CMD = 0xAC;		// set black mode frame  2nd and 1st value
-	LCD_CMD = 0x8F;		// set black mode frame  4th and 3rd cmd
-	LCD_CMD = 0xCA;		// set black mode frame  4th and 3rd value
-	LCD_CMD = 0x66;		// set DC-DC converter factor (5x)
+	lcd_cmd(0xAB);		// start internal oscillator
+	lcd_cmd(0x27);		// set internal regulator resistor ratio (8.1)
+	lcd_cmd(0x81);		// volume cmd
+	lcd_cmd(0x3A); 	// volume cmd value
+	lcd_cmd(0x65);		// set DC-DC converter factor (4x)
+	lcd_cmd(0x60);		// set upper window corner ax cmd
+	lcd_cmd(0x1C);		// set upper window corner ax value
+	lcd_cmd(0x61);		// set upper window corner ay cmd
+	lcd_cmd(0x0A);		// set upper window corner ay value
+	lcd_cmd(0x62);		// set lower window corner bx cmd
+	lcd_cmd(0x75);		// set lower window corner bx value
+	lcd_cmd(0x63);		// set lower window corner by cmd
+	lcd_cmd(0x81);		// set lower window corner by value
+	lcd_cmd(0x90);		// set PWM and FRC (4-frames)
+	lcd_cmd(0x88);		// set white mode frame  2nd and 1st cmd
+	lcd_cmd(0x00);		// set white mode frame  2nd and 1st value
+	lcd_cmd(0x89);		// set white mode frame  4th and 3rd cmd
+	lcd_cmd(0x00);		// set white mode frame  4th and 3rd value
+	
+	lcd_cmd(0x8A);		// set light gray mode frame  2nd and 1st cmd
+//	lcd_cmd(0x36);		// set light gray mode frame  2nd and 1st value
+	lcd_cmd(0x33);
+
+	lcd_cmd(0x8B);		// set light gray mode frame  4th and 3rd cmd
+	lcd_cmd(0x63);		// set light gray mode frame  4th and 3rd vakue
+//	lcd_cmd(0x33);
+	
+	lcd_cmd(0x8C);		// set dark gray mode frame  2nd and 1st cmd
+	lcd_cmd(0x67);		// set dark gray mode frame  2nd and 1st value
+	lcd_cmd(0x8D);		// set dark gray mode frame  4th and 3rd cmd
+	lcd_cmd(0x76);		// set dark gray mode frame  4th and 3rd vakue
+	lcd_cmd(0x8E);		// set black mode frame  2nd and 1st cmd
+	lcd_cmd(0xAC);		// set black mode frame  2nd and 1st value
+	lcd_cmd(0x8F);		// set black mode frame  4th and 3rd cmd
+	lcd_cmd(0xCA);		// set black mode frame  4th and 3rd value
+	lcd_cmd(0x66);		// set DC-DC converter factor (5x)
 	lcd_set(s);
 
-//	LCD_CMD = 0x2E;		// set power control register (boost on, reg on, buffer off)
+//	lcd_cmd(0x2E);		// set power control register (boost on, reg on, buffer off)
 
 //	delay(100000);		// around 10 ms	
 
-	LCD_CMD = 0x2F;		// set power control register (boost on, reg on, buffer on)
-	LCD_CMD = 0xA4;		// set entire display on, normal mode)
-	LCD_CMD = 0xA6;		// set normal display mode, inverse = 0xA7
+	lcd_cmd(0x2F);		// set power control register (boost on, reg on, buffer on)
+	lcd_cmd(0xA4);		// set entire display on, normal mode)
+	lcd_cmd(0xA6);		// set normal display mode, inverse = 0xA7
 
 	/* Stubs to call fastcode routines from normal code */
 	write_buf = _write_buf;
@@ -672,5 +672,5 @@ lcd_init(unsigned char s) {
 	
 	lcd_fill(0x00);
 
-	LCD_CMD = 0xAF;		// set display on
+	lcd_cmd(0xAF);		// set display on
 }
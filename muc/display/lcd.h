@@ -25,6 +25,19 @@
 #define LCD_CMD		(*((volatile unsigned char *) 0x81000000))
 #define LCD_DATA	(*((volatile unsigned char *) 0x81000001))
 
+/* All accesses to the lcd controller go through these.
+	The host build (see host/) emulates the controller in memory.
+*/
+#ifdef HOST
+void lcd_cmd(unsigned char c);
+void lcd_write(unsigned char d);
+unsigned char lcd_read(void);
+#else
+#define lcd_cmd(c)		(LCD_CMD = (c))
+#define lcd_write(d)	(LCD_DATA = (d))
+#define lcd_read()		(LCD_DATA)
+#endif
+
 
 // The available colors 
 #define WHITE 0
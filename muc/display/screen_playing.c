@@ -345,6 +345,35 @@ view_state_changed(enum PLAYSTATE state){
 	
 };
 
+/* Draw a window in dark grey, while it shows a wish of the user that MPD has not confirmed yet.
+	For the framed windows (white on black) we change the background.
+*/
+static void
+show_pending(struct Window *w, int pending){
+	if (w->flags & WINFLG_FRAME)
+		w->bg_color = pending ? DARK_GREY : BLACK;
+	else
+		w->fg_color = pending ? DARK_GREY : BLACK;
+	win_redraw(w);
+};
+
+/* Some wishes of the user are shown before MPD confirmed them.
+	pending has the X_CHANGED flags of those items, late is 1 if MPD needs too long to answer.
+*/
+void
+view_pending_changed(int pending, int late){
+	show_pending(&volume_win, pending & VOLUME_CHANGED);
+	show_pending(&state_win, pending & STATE_CHANGED);
+	show_pending(&rnd_win, pending & RANDOM_CHANGED);
+	show_pending(&rpt_win, pending & REPEAT_CHANGED);
+	show_pending(&single_win, pending & SINGLE_CHANGED);
+	
+	if (late)
+		win_new_text(&caption_win, "Waiting for MPD ...");
+	else
+		view_pos_changed();
+};
+
 static int
 keypress_popup(Screen *this_screen, int cur_key){
 	switch (cur_key) {
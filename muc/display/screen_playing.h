@@ -19,6 +19,7 @@ void view_state_changed(enum PLAYSTATE state);
 void view_single_changed(int sgl);
 void view_repeat_changed(int rpt);
 void view_random_changed(int rnd);
+void view_pending_changed(int pending, int late);
 
 #endif
 
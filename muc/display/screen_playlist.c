@@ -19,6 +19,7 @@
 #include "window.h"
 #include "keyboard.h"
 #include "lcd.h"
+#include "timerirq.h"
 #include "model.h"
 #include "mpd.h"
 
@@ -56,6 +57,38 @@ static scroll_list playlist_list;
 #define WL_HIGH_HEIGHT 18
 
 
+/* ------------------------------------- Letter jumps ------------------------------------------ 
+	A digit key jumps to the first playlist whose name starts with the first letter of the key.
+	Pressing the same key again within JUMP_TAP_TIME jumps to its next letter, like typing on a phone.
+	If no name starts with that letter, we jump to the next letter that has one.
+	The positions come from the jump index of the model.
+*/
+#define JUMP_TAP_TIME (15 * TICKS_PER_TENTH_SEC)
+
+static struct timer tap_tmr;
+static int tap_key = -1;
+static int tap_cnt;
+
+static void
+letter_jump(int n){
+	char c;
+	int pos;
+	
+	if ( (n == tap_key) && ! timer_expired(&tap_tmr) )
+		tap_cnt++;
+	else
+		tap_cnt = 0;
+	tap_key = n;
+	timer_set(&tap_tmr, JUMP_TAP_TIME, 0);
+	
+	c = key2char(n, tap_cnt);
+	pos = mpd_jump_pos(JUMP_PLAYLISTS, c);
+	while ( (pos < 0) && (c >= 'A') && (c < 'Z') )
+		pos = mpd_jump_pos(JUMP_PLAYLISTS, ++c);
+	if (pos >= 0)
+		scroll_list_start(&playlist_list, pos);
+};
+
 /* We are called when the playlist names have potentially changed (i.e they have been read in from MPD) */
 void
 view_playlists_changed(){
@@ -102,6 +135,8 @@ playlist_screen_init(Screen *this_screen){
 	init_scroll_list(&playlist_list, &(win[1]), win_txt[1], WIN_TXT_SIZE, PL_SIZE, &mpd_playlistname_info, cur_start_row, playlists_range_set);
 	
 	win_new_text(&win[0], "All playlists");
+	
+	timer_add(&tap_tmr, 0, 0);
 };	
 
 void
@@ -191,6 +226,8 @@ keypress(Screen *pl_screen, int cur_key){
 				"\xB0 = Page FWD\n"
 				"\xB2 = Up\n"
 				"\xB3 = Down\n"
+				"P+ P- = 5 % Jump\n"
+				"0 .. 9 = Letter\n"
 				"OK = Load\n"
 				"      playlist", 
 				  0, keypress_info_popup);
@@ -201,12 +238,18 @@ keypress(Screen *pl_screen, int cur_key){
 			show_screen(PLAYING_SCREEN);
 			break;
 			
-		case KEY_Pplus:					
+		case KEY_Pplus:
+			scroll_list_bucket(&playlist_list, -1);
+			break;
+			
+		case KEY_Pminus:
+			scroll_list_bucket(&playlist_list, 1);
+			break;
+			
 		case KEY_Up:
 			scroll_list_up(&playlist_list);
 			break;
 			
-		case KEY_Pminus:				
 		case KEY_Down:
 			scroll_list_down(&playlist_list);
 			break;
@@ -219,6 +262,46 @@ keypress(Screen *pl_screen, int cur_key){
 			scroll_list_fwd(&playlist_list);
 			break;
 			
+		case KEY_0:
+			letter_jump(0);
+			break;
+			
+		case KEY_1:
+			letter_jump(1);
+			break;
+			
+		case KEY_2:
+			letter_jump(2);
+			break;
+			
+		case KEY_3:
+			letter_jump(3);
+			break;
+			
+		case KEY_4:
+			letter_jump(4);
+			break;
+			
+		case KEY_5:
+			letter_jump(5);
+			break;
+			
+		case KEY_6:
+			letter_jump(6);
+			break;
+			
+		case KEY_7:
+			letter_jump(7);
+			break;
+			
+		case KEY_8:
+			letter_jump(8);
+			break;
+			
+		case KEY_9:
+			letter_jump(9);
+			break;
+			
 
 		default:
 			return cur_key;
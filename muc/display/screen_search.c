@@ -59,40 +59,35 @@ static scroll_list result_list;
 
 static task_id auto_search_task;
 
+/* How often we look at the input */
+#define SEARCH_POLL	(1 * TICKS_PER_TENTH_SEC)
+
 /* ### Automatic search task ###  */
 /* This task is started when the search screen is entered and stopped on exit.
 	It will check the value of the current search input window for any changes.
-	If we have a stable change (i.e. search string is new and unchanged for 2 second,
-	we start a search with this string.
+	Each change starts a search with the new string at once, so the results follow the typing.
+	The model and mpdtool drop the searches that are overtaken by a newer one.
 */
 PT_THREAD (auto_search(struct pt *pt)){
 	static struct timer tmr;
 	static char search_string[WIN_TXT_SIZE];
-	static int is_new;
 	static int len;	// not used, but needed by strn_cpy_cmp()
 	 
 	PT_BEGIN(pt);
 	
 	search_string[0] = 0;
-	is_new = 0;
-	timer_add(&tmr, 10 * TICKS_PER_TENTH_SEC, 0);
+	timer_add(&tmr, SEARCH_POLL, 0);
 	
 	while(1){
 		PT_WAIT_UNTIL(pt, ( timer_expired(&tmr) ));
 		
-		if (1 == strn_cpy_cmp(search_string, input_win.txt, WIN_TXT_SIZE -1, &len) ){
-			// input string has not changed
-			if (is_new) {
+		if (1 != strn_cpy_cmp(search_string, input_win.txt, WIN_TXT_SIZE -1, &len) ){
 // If this flag is set, the host is slow and we do no automatic search
 #ifndef SLOW_HOST
-				user_set_search_string(input_win.txt);
+			user_set_search_string(input_win.txt);
 #endif
-			};
-			is_new = 0;
-		} else {
-			is_new = 1;	
 		};	
-		timer_set(&tmr, 10 * TICKS_PER_TENTH_SEC, 0);
+		timer_set(&tmr, SEARCH_POLL, 0);
 	};
 	
 	PT_END(pt);
@@ -199,12 +194,18 @@ view_results_changed(int num){
 };
 
 
+/* The results of a new search come in, they should show the cursor reset to the first position */
 void
-view_resultnames_changed(){
-	// new results should show the cursor reset to the first position
+view_search_started(){
 	scroll_list_start(&result_list, 0);		// also calls scroll_list_changed()
 };
 
+/* More names have come in, the cursor stays where the user has moved it */
+void
+view_resultnames_changed(){
+	scroll_list_changed(&result_list);
+};
+
 static int
 keypress_popup(Screen *this_screen, int cur_key){
 	switch (cur_key) {
@@ -8,6 +8,7 @@
 
 void view_results_changed(int num);
 void view_resultnames_changed();
+void view_search_started();
 void search_screen_init(Screen *this_screen);
 
 #endif
@@ -19,6 +19,8 @@
 #include "window.h"
 #include "keyboard.h"
 #include "lcd.h"
+#include "kernel.h"
+#include "timerirq.h"
 #include "model.h"
 #include "mpd.h"
 
@@ -101,6 +103,92 @@ static scroll_list track_list;
 /* Remember the last selected pos when leaving the screen */
 static int last_selected = 0;
 
+/* ------------------------------------- Find mode ------------------------------------------ 
+	A digit key starts the find mode. The title window then takes the input like the search screen.
+	When the input has not changed for FIND_DELAY, we jump to the next song from the selected one on
+	which contains it (see user_tracklist_find()). Blue looks for the next one after the selected song.
+	A single letter jumps to the first title that starts with it, if the model has a jump index.
+	Exit ends the find mode.
+*/
+#define FIND_LEN	24
+#define FIND_DELAY	(5 * TICKS_PER_TENTH_SEC)
+
+static int find_mode = 0;
+static task_id find_task;
+
+PT_THREAD (auto_find(struct pt *pt)){
+	static struct timer tmr;
+	static char find_string[FIND_LEN + 1];
+	static int is_new;
+	static int len;	// needed by strn_cpy_cmp(), then the position to jump to
+	
+	PT_BEGIN(pt);
+	
+	find_string[0] = 0;
+	is_new = 0;
+	timer_add(&tmr, FIND_DELAY, 0);
+	
+	while(1){
+		PT_WAIT_UNTIL(pt, ( timer_expired(&tmr) ));
+		
+		if (1 == strn_cpy_cmp(find_string, win[0].txt, FIND_LEN + 1, &len) ){
+			if (is_new){
+				if ( (win[0].txt[0] >= 'A') && (win[0].txt[0] <= 'Z') && (win[0].txt[1] == '\0')
+						&& ((len = mpd_jump_pos(JUMP_QUEUE, win[0].txt[0])) >= 0) )
+					scroll_list_start(&track_list, len);
+				else
+					user_tracklist_find(win[0].txt, scroll_list_selected(&track_list));
+			};
+			is_new = 0;
+		} else
+			is_new = 1;
+		timer_set(&tmr, FIND_DELAY, 0);
+	};
+	
+	PT_END(pt);
+};
+
+static void
+find_start(){
+	if (find_mode)
+		return;
+	find_mode = 1;
+	win[0].flags &= ~WINFLG_CENTER;
+	win_new_text(&win[0], "");
+	win_cursor_set(&win[0], FIND_LEN);
+	find_task = task_add(&auto_find);
+};
+
+/* A digit key: the first one starts the find mode */
+static void
+find_input(int n){
+	find_start();
+	win_cursor_input(n);
+};
+
+static void
+find_end(){
+	if (! find_mode)
+		return;
+	find_mode = 0;
+	task_del(find_task);
+	user_tracklist_find(NULL, 0);			// a find which is not answered yet is of no use any more
+	win_cursor_set(NULL, 15);
+	win[0].flags |= WINFLG_CENTER;
+	win_new_text(&win[0], "Current playlist");
+};
+
+/* The model has found a song (pos >= 0) or not */
+void
+view_tracklist_found(int pos){
+	if (! find_mode)
+		return;
+	if (pos >= 0)
+		scroll_list_start(&track_list, pos);
+	else
+		view_message("\n   Not found", 2 * TICKS_PER_SEC);
+};
+
 
 void
 view_tracklist_changed(){
@@ -152,6 +240,7 @@ screen_enter(){
 
 static void 
 screen_exit(){
+	find_end();
 	last_selected = scroll_list_selected(&track_list) ;
 };
 
@@ -247,7 +336,10 @@ keypress(Screen *track_screen, int cur_key){
 			break;
 			
 		case KEY_Exit:	
-			show_screen(PLAYLIST_SCREEN);
+			if (find_mode)
+				find_end();
+			else
+				show_screen(PLAYLIST_SCREEN);
 			break;
 			
 		case KEY_A:	
@@ -268,6 +360,9 @@ keypress(Screen *track_screen, int cur_key){
 				"\xB0 = Page FWD\n"
 				"\xB2 = Down\n"
 				"\xB3 = Up\n"				
+				"P+ P- = 5 % Jump\n"
+				"0 .. 9 = Find\n"
+				"Blue = Find next\n"
 				"\xAD = Clear\n     playlist", 
 				  0, keypress_info_popup);
 			break;
@@ -277,22 +372,89 @@ keypress(Screen *track_screen, int cur_key){
 			show_screen(PLAYING_SCREEN);
 			break;
 		
-		case KEY_Pplus:	
+		case KEY_Pplus:
+			scroll_list_bucket(&track_list, -1);
+			break;
+			
+		case KEY_Pminus:
+			scroll_list_bucket(&track_list, 1);
+			break;
+			
 		case KEY_Up:
 			scroll_list_up(&track_list);
 			break;
 			
-		case KEY_Pminus:	
 		case KEY_Down:
 			scroll_list_down(&track_list);
 			break;
 			
 		case KEY_Left:
-			scroll_list_back(&track_list);
+			if (find_mode)
+				win_cursor_input(CURSOR_LEFT);
+			else
+				scroll_list_back(&track_list);
 			break;
 					
 		case KEY_Right:
-			scroll_list_fwd(&track_list);
+			if (find_mode)
+				win_cursor_input(CURSOR_RIGHT);
+			else
+				scroll_list_fwd(&track_list);
+			break;
+			
+		case KEY_Minus:
+			if (find_mode)
+				win_cursor_input(CURSOR_BACKSPACE);
+			break;
+			
+		case KEY_AV:
+			if (find_mode)
+				win_cursor_clr();
+			break;
+			
+		case KEY_Blue:
+			if (find_mode)
+				user_tracklist_find(win[0].txt, scroll_list_selected(&track_list) + 1);
+			break;
+			
+		case KEY_0:
+			find_input(0);
+			break;
+			
+		case KEY_1:
+			find_input(1);
+			break;
+			
+		case KEY_2:
+			find_input(2);
+			break;
+			
+		case KEY_3:
+			find_input(3);
+			break;
+			
+		case KEY_4:
+			find_input(4);
+			break;
+			
+		case KEY_5:
+			find_input(5);
+			break;
+			
+		case KEY_6:
+			find_input(6);
+			break;
+			
+		case KEY_7:
+			find_input(7);
+			break;
+			
+		case KEY_8:
+			find_input(8);
+			break;
+			
+		case KEY_9:
+			find_input(9);
 			break;
 			
 		// This clears the current tracklist
@@ -13,6 +13,7 @@ int tracklist_arg(void);
 void tracklist_screen_exit();
 void view_pl_length_changed(int len, int added);
 void view_tracklist_changed();
+void view_tracklist_found(int pos);
 
 #endif
 
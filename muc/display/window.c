@@ -543,6 +543,40 @@ scroll_list_start(scroll_list *sl, int pos){
 	scroll_list_changed(sl);	
 };
 
+/* Number of parts of a scroll list for scroll_list_bucket() */
+#define SCROLL_BUCKETS 20
+
+/* The first position in bucket b of a list with len entries */
+#define bucket_start(b, len) ( ((b) * (len) + SCROLL_BUCKETS - 1) / SCROLL_BUCKETS )
+
+/* 
+	Jump to the start of the next (dir > 0) or previous (dir < 0) bucket of the list.
+	Each bucket is 1/SCROLL_BUCKETS (5 %) of the list.
+	If the selected entry is not at the start of its bucket, back means the start of this bucket.
+	Does nothing if the length of the list is unknown.
+*/
+void
+scroll_list_bucket(scroll_list *sl, int dir){
+	int len = sl->last_pos + 1;
+	int sel = scroll_list_selected(sl);
+	int b;
+	
+	if (len <= 0)
+		return;
+	b = sel * SCROLL_BUCKETS / len;
+	if (dir > 0){
+		if (b + 1 < SCROLL_BUCKETS)
+			scroll_list_start(sl, bucket_start(b + 1, len));
+		else
+			scroll_list_start(sl, sl->last_pos);
+		return;
+	};
+	/* Short lists have empty buckets */
+	while ( (b > 0) && (bucket_start(b, len) >= sel) )
+		b--;
+	scroll_list_start(sl, bucket_start(b, len));
+};
+
 /* 
 	set the total length of the given scroll list 
 	-1 means unknown
@@ -600,6 +634,7 @@ init_scroll_list(scroll_list *sl, struct Window *pwl, char *win_txt, int win_txt
 			win_init(pwin, start_row, 0, WL_NORMAL_HEIGHT, 128, 0, &(win_txt[i*win_txt_len]));
 			unselect_win(pwin);
 		};
+		pwin->buffer_size = win_txt_len;			// long titles are cut to our buffers
 		start_row += pwin->height;
 		/* Every second window has a different background color */
 		if (0 == (i & 1)) pwin->bg_color = LIGHT_GREY;
@@ -787,9 +822,18 @@ PT_THREAD (win_cursor_blink(struct pt *pt)){
 			continue;
 		};
 		
-		if (! (pcursor_win->flags & WINFLG_VISIBLE)) continue;
-		if (pcursor_win->txt == NULL) continue; 	
-		if (pcursor_win->flags & WINFLG_HIDE) continue;
+		/* We cannot draw now (a popup may cover the window). 
+			An expired char_tmr must be handled anyway, else we would not wait for the next period.
+		*/
+		if ( (! (pcursor_win->flags & WINFLG_VISIBLE)) || (pcursor_win->txt == NULL) || (pcursor_win->flags & WINFLG_HIDE) ){
+			if (timer_expired(&char_tmr)){
+				timer_stop(&char_tmr);
+				key_cnt = -1;
+				if ( (pcursor_win->txt != NULL) && (pcursor_win->txt[cursor_pos] != '\0') )
+					cursor_pos++;
+			};
+			continue;
+		};
 		
 		/* Check if we should advance the cursor because user did not press a key again within time */
 		if ( timer_expired(&char_tmr)) {	
@@ -830,10 +874,11 @@ win_cursor_init(){
 };	
 
 
-static char
+/* Like a phone, the digit comes after the letters of each key */
+char
 key2char(int key, int cnt){
-//	const char key_table[10][5] = {" ", ".-@", "abc", "def", "ghi", "jkl", "mno", "pqrs", "tuv", "wxyz"};
-	const char key_table[10][5] = {" ", ".-@", "ABC", "DEF", "GHI", "JKL", "MNO", "PQRS", "TUV", "WXYZ"};
+//	const char key_table[10][6] = {" 0", ".-@1", "abc2", "def3", "ghi4", "jkl5", "mno6", "pqrs7", "tuv8", "wxyz9"};
+	const char key_table[10][6] = {" 0", ".-@1", "ABC2", "DEF3", "GHI4", "JKL5", "MNO6", "PQRS7", "TUV8", "WXYZ9"};
 	cnt = cnt % strlen(key_table[key]) ;
 	return key_table[key][cnt];
 };
@@ -127,11 +127,13 @@ void scroll_list_back(scroll_list *sl);
 void scroll_list_start(scroll_list *sl, int pos);
 int scroll_list_selected(scroll_list *sl);
 void scroll_list_total_len(scroll_list *sl, int length);
+void scroll_list_bucket(scroll_list *sl, int dir);
 
 void win_cursor_set(struct Window *pwin, int size);
 void win_cursor_input(int new_key);
 void win_cursor_init();
 void win_cursor_clr();
+char key2char(int key, int cnt);
 
 
 #endif
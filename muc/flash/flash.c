@@ -0,0 +1,112 @@
+/*
+    flash.c - writing/erasing flash
+    Copyright (C) 2007  Ch. Klippel <ck@mamalala.net>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Taken from boop. McBetty runs from chip 0 and only writes to chip 1 (see bfs.h),
+	so the code may run from flash while the other chip is busy.
+	Only the functions that BFS needs are left.
+*/
+
+#include "global.h"
+#include "flash.h"
+
+const unsigned long secaddr[19] = 
+{ 0x00000,
+  0x02000,
+  0x03000,
+  0x04000,
+  0x08000,
+  0x10000,
+  0x18000,
+  0x20000,
+  0x28000,
+  0x30000,
+  0x38000,
+  0x40000,
+  0x48000,
+  0x50000,
+  0x58000,
+  0x60000,
+  0x68000,
+  0x70000,
+  0x78000 };
+
+static unsigned long flash_base;
+static unsigned long erase_base;		// chip of the running erase
+
+/* Starts erasing a sector and returns at once. Erasing a 64 KByte sector takes about 1 s.
+	The chip can not be read until eraseDone() returns TRUE.
+	Returns 0 iff the erase has started.
+*/
+int eraseStart(unsigned char chip, unsigned char secnum)
+{
+
+	if(chip == 0)
+		flash_base = FLASH0_BASE;
+	else
+		flash_base = FLASH1_BASE;
+	erase_base = flash_base;
+
+	*((volatile unsigned short *)(flash_base | 0xAAA)) = 0xAA;
+	*((volatile unsigned short *)(flash_base | 0x554)) = 0x55;
+	*((volatile unsigned short *)(flash_base | 0xAAA)) = 0x80;
+	*((volatile unsigned short *)(flash_base | 0xAAA)) = 0xAA;
+	*((volatile unsigned short *)(flash_base | 0x554)) = 0x55;
+	*((volatile unsigned short *)(flash_base + (secaddr[secnum]<<1))) = 0x30;
+
+	if((*((volatile unsigned short *)(flash_base)) & 0x44) == (*((volatile unsigned short *)(flash_base)) & 0x44))
+	{
+		debug_out("Erase failed ", secnum);
+		*((volatile unsigned short *)(flash_base)) = 0xF0;
+		return -1;
+	}
+	return 0;
+}
+
+/* Returns TRUE iff the erase started by eraseStart() has finished. The toggle bits stand still then. */
+int eraseDone()
+{
+	return ((*((volatile unsigned short *)(erase_base)) & 0x44) == (*((volatile unsigned short *)(erase_base)) & 0x44));
+}
+
+int eraseSector(unsigned char chip, unsigned char secnum)
+{
+	if(eraseStart(chip, secnum) != 0)
+		return -1;
+	while (! eraseDone())
+	{}
+	return 0;
+}
+
+int writeWord(unsigned long addr, unsigned short data)
+{
+	flash_base = addr & 0xFF000000;
+	*((volatile unsigned short *)(flash_base | 0xAAA)) = 0xAA;
+	*((volatile unsigned short *)(flash_base | 0x554)) = 0x55;
+	*((volatile unsigned short *)(flash_base | 0xAAA)) = 0xA0;
+	*((volatile unsigned short *)(addr)) = data;
+
+	if(*((volatile unsigned short *)(addr)) == *((volatile unsigned short *)(addr)))
+	{
+		*((volatile unsigned short *)(flash_base)) = 0xF0;
+		return -1;
+	}
+
+	while(*((volatile unsigned short *)(addr)) != *((volatile unsigned short *)(addr)))
+	{}
+	return 0;
+}
@@ -0,0 +1,33 @@
+/*
+    flash.h - writing/erasing flash
+    Copyright (C) 2007  Ch. Klippel <ck@mamalala.net>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FLASH_H
+#define FLASH_H
+
+#define FLASH0_BASE	0x80000000
+#define FLASH1_BASE	0x82000000
+
+/* Sector start addresses of one chip, in 16 bit words */
+extern const unsigned long secaddr[19];
+
+int eraseSector(unsigned char chip, unsigned char secnum);
+int eraseStart(unsigned char chip, unsigned char secnum);
+int eraseDone();
+int writeWord(unsigned long addr, unsigned short data);
+
+#endif
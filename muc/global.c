@@ -106,6 +106,27 @@ strlcat(char *dst, const char *src, int size){
 	return i;
 };
 
+/* As in boop, for the flash file system */
+void *
+memcpy(void *dest, const void *src, int count){
+	char *d = dest;
+	const char *s = src;
+
+	while (count--)
+		*d++ = *s++;
+	return dest;
+};
+
+int
+memcmp(const void *cs, const void *ct, int count){
+	const unsigned char *su1, *su2;
+
+	for (su1 = cs, su2 = ct; count > 0; su1++, su2++, count--)
+		if (*su1 != *su2)
+			return *su1 - *su2;
+	return 0;
+};
+
 
 /* Delete the character at position pos in the string 
 	Deletes in place, original string is changed
@@ -129,6 +150,29 @@ str_del(char *s, int pos){
 	return pos - 1;	
 };
 
+/* Returns a pointer to the first occurrence of pat in s, or NULL if there is none.
+	Letters are compared without case (only 'a' to 'z'), like the search of MPD.
+*/
+char *
+str_find(char *s, char *pat){
+	int i;
+	char a, b;
+	
+	for (; *s; s++){
+		for (i=0; pat[i]; i++){
+			a = s[i];
+			b = pat[i];
+			if ( (a >= 'a') && (a <= 'z') ) a -= 'a' - 'A';
+			if ( (b >= 'a') && (b <= 'z') ) b -= 'a' - 'A';
+			if (a != b)
+				break;
+		};
+		if (0 == pat[i])
+			return s;
+	};
+	return (*pat) ? NULL : s;
+};
+
 /* String copy and compare.
 	Copies str2 to str1.
 	Returns 1 if both strings were identical.
@@ -295,6 +339,15 @@ int rand(){
 
 /* ==================================== String cache functions ========================================= */
 
+/* The arena that all caches share (see global.h) */
+static char cache_arena[CACHE_ARENA_SIZE];
+static int arena_used;		// bytes of the arena in use, dead records included
+static int arena_live;		// bytes of the live records
+
+static STR_CACHE *cache_list[CACHE_LISTS];
+static int num_lists;
+static unsigned long use_count;		// counts the changes of the list shown, see cache_range_set()
+
 /* Given a string pos, we return the index of the cache entry corresponding to this number.
 	If the number is outside of our list, we return -1.
 */
@@ -328,25 +381,32 @@ cache_info(STR_CACHE *pc, int pos){
 		return "...";
 		
 	p = pc->entry[i].pos;
-	if (p == NOT_KNOWN)
+	if ( (p == NOT_KNOWN) || (p == REQUESTED) || (p == DROPPED) )
 		return "...";
 	
-	if (p == NOT_AVAIL)
+	if ( (p == NOT_AVAIL) || (pc->entry[i].off < 0) )
 		return "";
-	return pc->entry[i].cache_str;	
+	return cache_arena + pc->entry[i].off;	
 };
 
+/* The record of the entry is dead now */
+static void
+entry_free(STR_CACHE *pc, int idx){
+	if (pc->entry[idx].off >= 0)
+		arena_live -= (unsigned char) cache_arena[pc->entry[idx].off - 1] + 3;
+	pc->entry[idx].off = -1;
+};
 	
 static void inline 
 entry_unknown(STR_CACHE *pc, int idx){
 	pc->entry[idx].pos = NOT_KNOWN;
-	pc->entry[idx].cache_str[0] = '\0';	
+	entry_free(pc, idx);
 };
 
 static void inline 
 entry_not_avail(STR_CACHE *pc, int idx){
 	pc->entry[idx].pos = NOT_AVAIL;
-	pc->entry[idx].cache_str[0] = '\0';
+	entry_free(pc, idx);
 };
 
 static void inline
@@ -368,25 +428,120 @@ pos_not_avail (STR_CACHE *pc, int pos){
 }
 	
 
+/* Moves the live records of the arena down over the dead ones.
+	A record is live if its owner still points to it.
+*/
+static void
+cache_compact(){
+	int src = 0, dst = 0;
+	int size, owner, i;
+	struct cache_entry *e;
+	
+	while (src < arena_used){
+		owner = (unsigned char) cache_arena[src];
+		size = (unsigned char) cache_arena[src + 1] + 3;
+		e = &(cache_list[owner / CACHE_LIM]->entry[owner % CACHE_LIM]);
+		if (e->off == src + 2){
+			if (dst != src){
+				for (i=0; i<size; i++)
+					cache_arena[dst + i] = cache_arena[src + i];
+				e->off = dst + 2;
+			};
+			dst += size;
+		};
+		src += size;
+	};
+	arena_used = dst;
+};
+
+/* Drops the string that is farthest away from the rows shown, but keeps the rows shown
+	and keep rows on either side of them. Returns FALSE if there is no such string.
+*/
+static int
+cache_drop(STR_CACHE *pc, int keep){
+	int first = pc->shown_first, last = pc->shown_last;
+	int p, d, idx, best = -1, best_d = keep;
+	
+	if (first < 0)
+		first = last = pc->first_pos;
+	for (p = pc->first_pos; p <= last_pos(pc); p++){
+		d = (p < first) ? first - p : p - last;
+		idx = cache_index(pc, p);
+		if ( (d > best_d) && (pc->entry[idx].off >= 0) ){
+			best = idx;
+			best_d = d;
+		};
+	};
+	if (best < 0)
+		return 0;
+	entry_free(pc, best);
+	pc->entry[best].pos = DROPPED;
+	return 1;
+};
+
+/* Drops strings until need bytes of the arena are free for a string of pc (see global.h).
+	The lists that were used less recently than pc come first, the least recently used one first.
+	We drop a bit more than needed, so that the next strings fit without another compaction.
+*/
+static void
+cache_make_room(STR_CACHE *pc, int need){
+	STR_CACHE *victim;
+	int i, done = 0;			// bit i is set if list i has nothing more to drop
+	
+	need += CACHE_ENTRY_SIZE;
+	while (arena_live + need > CACHE_ARENA_SIZE){
+		victim = NULL;
+		for (i = 0; i < num_lists; i++)
+			if ( !(done & (1 << i)) && (cache_list[i]->last_use < pc->last_use)
+				&& ((victim == NULL) || (cache_list[i]->last_use < victim->last_use)) )
+				victim = cache_list[i];
+		if (victim == NULL){
+			if (! cache_drop(pc, 0))
+				break;
+		} else if (! cache_drop(victim, CACHE_WARM))
+			done |= 1 << victim->list;
+	};
+};
+
 /* 
 	Given a string, store this info in our cache (if it fits) 
 	If the string is NULL, pos is set to NOT_KNOWN and "" is stored 
-	else the string is copied length-limited by CACHE_ENTRY_LEN
-	and pos is set to pos
+	else the string is copied length-limited by CACHE_ENTRY_LEN 
+	(and by the room left in the arena) and pos is set to pos
 */
 void
 cache_store(STR_CACHE *pc, int pos, char *content){
-	int idx;
+	int idx, len, room, p;
 	
 	idx = cache_index(pc, pos);
 	if (idx < 0)
 		return;
 	if (NULL == content){
 		entry_unknown(pc,idx);
-	} else {
-		strlcpy(pc->entry[idx].cache_str, content, CACHE_ENTRY_SIZE); 
-		pc->entry[idx].pos = pos;
-	};	
+		return;
+	};
+	
+	entry_free(pc, idx);			// the old record is dead now
+	pc->entry[idx].pos = pos;
+	
+	len = min(strlen(content), CACHE_ENTRY_LEN);
+	if (arena_used + len + 3 > CACHE_ARENA_SIZE){
+		if (arena_live + len + 3 > CACHE_ARENA_SIZE)
+			cache_make_room(pc, len + 3);
+		cache_compact();
+	};
+	room = CACHE_ARENA_SIZE - arena_used - 3;
+	if (room < 0)
+		return;
+	len = min(len, room);
+	
+	p = arena_used;
+	cache_arena[p] = pc->list * CACHE_LIM + idx;
+	cache_arena[p + 1] = len;
+	strlcpy(cache_arena + p + 2, content, len + 1);
+	pc->entry[idx].off = p + 2;
+	arena_used = p + len + 3;
+	arena_live += len + 3;
 };
 
 /* All the cache entries starting at pos are made unknown. */
@@ -404,78 +559,173 @@ cache_unknown(STR_CACHE *pc, int pos){
 };
 
 
+/* The first call for a cache adds it to the list of caches that share the arena */
 void
 cache_init(STR_CACHE *pc){
+	int i;
+	
+	for (i = 0; (i < num_lists) && (cache_list[i] != pc); i++)
+		;
+	if (i == num_lists){
+		if (num_lists >= CACHE_LISTS)
+			return;
+		cache_list[num_lists] = pc;
+		pc->list = num_lists++;
+		for (i = 0; i < CACHE_LIM; i++)
+			pc->entry[i].off = -1;
+	};
 	pc->first_idx = 0;
 	pc->first_pos = 0;
 	pc->pos_lim = -1;
+	pc->shown_first = pc->shown_last = -1;
+	pc->trend = 0;
+	pc->last_use = 0;
 	cache_unknown(pc, 0);
 };
 	
-/* We are shifting the start of our tracklist up by 1 position.
-	I.e. if the cache started at pos 17, it now starts at pos 18
-	We are not changing most of the information in str[], only the start and end of the array.
+/* The entry for pos gets a new position: it is NOT_KNOWN,
+	except when it is above the absolute information limit, then it is NOT_AVAIL
+*/
+static void inline
+pos_fresh(STR_CACHE *pc, int pos){
+	if ( (pc->pos_lim >= 0) && (pos >= pc->pos_lim) )		// valid limit known and pos is above it
+		pos_not_avail(pc, pos);
+	else
+		pos_unknown(pc, pos);
+};
 
-	The last information is set to UNKNOWN or NOT_AVAIL depending on pos_lim
+/* We are shifting the start of our cache up by diff positions.
+	I.e. if the cache started at pos 17 and diff is 3, it now starts at pos 20
+	We are not changing most of the information in the cache, only the start and end of the ring buffer:
+	The old first entries become the new last ones and are made fresh.
+	If diff is CACHE_LIM or more, nothing is left and all entries are fresh.
+	So the cost does not depend on how far we jump.
 */
 static void
-cache_inc_first(STR_CACHE *pc){
-	pc->first_pos++;			// sets last_pos() also
-
-	// the cache is a ring buffer, so the old first element will be the new last element
-	if ( (pc->pos_lim >= 0) && (last_pos(pc) >= pc->pos_lim) )
-		entry_not_avail(pc,pc->first_idx);
-	else
-		entry_unknown(pc,pc->first_idx);
+cache_shift_up(STR_CACHE *pc, int diff){
+	int n = min(diff, CACHE_LIM);		// number of fresh entries
+	int p;
 	
-	pc->first_idx++;
+	pc->first_pos += diff;				// sets last_pos() also
+	pc->first_idx += n;
 	if (pc->first_idx > CACHE_MAX)
-		pc->first_idx = 0;
+		pc->first_idx -= CACHE_LIM;
+	
+	for (p = last_pos(pc) - n + 1; p <= last_pos(pc); p++)
+		pos_fresh(pc, p);
 };
 
-/* We are shifting the start of our cache down by 1 pos 
-	I.e. if the cache started at pos 17, it now starts at pos 16
-	We are not changing most of the information in cache, only the start (and end) of the array.
-	We are setting the information of the new first info to NOT_KNOWN,, because we do not know it,
-	except when it is above the absolute information limit, then it is NOT_AVAIL
+/* We are shifting the start of our cache down by diff positions.
+	I.e. if the cache started at pos 17 and diff is 3, it now starts at pos 14
+	The old last entries become the new first ones and are made fresh, see cache_shift_up().
 */
 static void
-cache_dec_first(STR_CACHE *pc){
-	pc->first_pos--;
-	pc->first_idx--;
+cache_shift_down(STR_CACHE *pc, int diff){
+	int n = min(diff, CACHE_LIM);		// number of fresh entries
+	int p;
+	
+	pc->first_pos -= diff;
+	pc->first_idx -= n;
 	if (pc->first_idx < 0)
-		pc->first_idx = CACHE_MAX;
+		pc->first_idx += CACHE_LIM;
 	
-	if ( (pc->pos_lim >= 0)	&& (pc->first_pos >= pc->pos_lim) )			// valid limit known and start is above it
-		entry_not_avail(pc,pc->first_idx);
-	else 
-		entry_unknown(pc,pc->first_idx);
+	for (p = pc->first_pos; p < pc->first_pos + n; p++)
+		pos_fresh(pc, p);
 };
 
-static void
-cache_shift_up(STR_CACHE *pc, int diff){
-	for (;diff > 0; diff --)
-		cache_inc_first(pc);
-};
+/* Returns the first unknown pos from 'from' to 'to' inclusive, going in steps of step (1 or -1).
+	Only positions in our cache and below limit are looked at.
+	A DROPPED entry counts as unknown if dropped is TRUE.
+*/
+static int
+find_unknown_in(STR_CACHE *pc, int from, int to, int step, int limit, int dropped){
+	int p;
 
-static void
-cache_shift_down(STR_CACHE *pc, int diff){
-	for (;diff > 0; diff --)
-		cache_dec_first(pc);
+	int pos;
+	
+	if (step > 0){
+		from = max(from, pc->first_pos);
+		to = min(to, min(last_pos(pc), limit - 1));
+	} else {
+		from = min(from, min(last_pos(pc), limit - 1));
+		to = max(to, pc->first_pos);
+	};
+	for (pos=from; (to - pos) * step >= 0; pos += step){
+		p = cache_pos(pc, pos);
+		if ( (p == NOT_KNOWN) || (dropped && (p == DROPPED)) )
+			return pos;
+	};
+	return -1;
 };
 
-/* Returns the first unknown pos in our cache 
+/* Returns the unknown pos below limit in our cache that we should ask for next
 	or -1 if every pos is either known or not available.
+	The rows shown come first, then the ones in the direction of scrolling, then the rest.
+	Down is the default. Dropped entries are only given out if they are shown.
 */
 int
-cache_find_unknown(STR_CACHE *pc){
+cache_find_unknown(STR_CACHE *pc, int limit){
 	int pos;
-	for (pos=pc->first_pos; pos <= last_pos(pc); pos++)
-		if (cache_pos(pc, pos) == NOT_KNOWN)
-			return pos;
-	return -1;
+	int first = pc->shown_first, last = pc->shown_last;
+	
+	if (first < 0)
+		first = last = pc->first_pos;
+		
+	pos = find_unknown_in(pc, first, last, 1, limit, 1);
+	if (pos >= 0)
+		return pos;
+		
+	if (pc->trend >= 0){
+		pos = find_unknown_in(pc, last + 1, last_pos(pc), 1, limit, 0);
+		if (pos < 0)
+			pos = find_unknown_in(pc, first - 1, pc->first_pos, -1, limit, 0);
+	} else {
+		pos = find_unknown_in(pc, first - 1, pc->first_pos, -1, limit, 0);
+		if (pos < 0)
+			pos = find_unknown_in(pc, last + 1, last_pos(pc), 1, limit, 0);
+	};
+	return pos;
 }
 
+/* We have asked MPD for the info at pos.
+	The entry is not given out by cache_find_unknown() again,
+	so that further requests can be sent while the answer is still on its way.
+*/
+void
+cache_requested(STR_CACHE *pc, int pos){
+	int idx = cache_index(pc, pos);
+	if ( (idx >= 0) && ((pc->entry[idx].pos == NOT_KNOWN) || (pc->entry[idx].pos == DROPPED)) )
+		pc->entry[idx].pos = REQUESTED;
+};
+
+/* Looks for the first string from *pos on that contains pat (see str_find()).
+	Only the known strings that follow each other in our cache can be checked.
+	Returns 1 if one of them matches, *pos is its position then.
+	Else returns 0, *pos is the first position that we could not check.
+*/
+int
+cache_match(STR_CACHE *pc, int *pos, char *pat){
+	int p;
+	
+	for (p = max(*pos, 0); cache_pos(pc, p) >= 0; p++)
+		if (NULL != str_find(cache_info(pc, p), pat)){
+			*pos = p;
+			return 1;
+		};
+	*pos = p;
+	return 0;
+};
+
+/* We never got an answer for the info at pos. 
+	Make it unknown again, so that we ask once more.
+*/
+void
+cache_lost(STR_CACHE *pc, int pos){
+	int idx = cache_index(pc, pos);
+	if ( (idx >= 0) && (pc->entry[idx].pos == REQUESTED) )
+		entry_unknown(pc, idx);
+};
+
 
 /* 
 	The cache containing track info has to follow the information that we show on screen.
@@ -498,17 +748,43 @@ cache_find_unknown(STR_CACHE *pc){
 */
 void
 cache_range_set(STR_CACHE *pc, int start_pos, int end_pos){
-	int p, margin, left_margin;
+	int p, margin, left_margin, step;
+	
+	// Follow the scrolling. Small steps in one direction add up to a trend,
+	// a change of direction starts a new one and a long jump ends it.
+	step = start_pos - pc->shown_first;
+	if ( (pc->shown_first < 0) || (abs(step) > 2 * (end_pos - start_pos + 1)) )
+		pc->trend = 0;
+	else if ( (step > 0) && (pc->trend < 0) )
+		pc->trend = min(step, TREND_MAX);
+	else if ( (step < 0) && (pc->trend > 0) )
+		pc->trend = max(step, -TREND_MAX);
+	else
+		pc->trend = max(-TREND_MAX, min(TREND_MAX, pc->trend + step));
+	pc->shown_first = start_pos;
+	pc->shown_last = end_pos;
+	
+	// This list is on screen now. If it was not the last one shown,
+	// it gets the arena back and fetches again what was dropped.
+	if ( (pc->last_use == 0) || (pc->last_use != use_count) ){
+		pc->last_use = ++use_count;
+		for (p = pc->first_pos; p <= last_pos(pc); p++)
+			if (cache_pos(pc, p) == DROPPED)
+				pos_unknown(pc, p);
+	};
 	
 	// ideally we want to keep the needed info in the middle of our cache,
 	// so that the user can scroll back and forth relatively fast without
 	// reloading a lot of cache values.
-	// We center the info in the cache like a text on a page
+	// We center the info in the cache like a text on a page.
+	// While the user keeps scrolling in one direction, up to 3/4 of the margin go ahead of the info.
 	
 	// Check if the needed info fits completely within our cache
 	if ( end_pos - start_pos + 1 <= CACHE_LIM ) {
 		margin = CACHE_LIM - (end_pos - start_pos + 1);				// size of cache - size of needed info
-		left_margin = margin / 2;
+		left_margin = margin / 2 - margin * abs(pc->trend) / (4 * TREND_MAX);	// margin behind the info
+		if (pc->trend < 0)
+			left_margin = margin - left_margin;
 		start_pos = start_pos - left_margin;
 	};
 		
@@ -524,7 +800,8 @@ cache_range_set(STR_CACHE *pc, int start_pos, int end_pos){
 	end_pos = start_pos + CACHE_MAX;
 		
 	// Maybe some of the values in our cache are still good
-	// for ex. the user just shifted the range by 1
+	// for ex. the user just shifted the range by 1.
+	// A long jump (for ex. to the current song) costs no more than a short one.
 	if (pc->first_pos > start_pos)
 		cache_shift_down(pc, pc->first_pos - start_pos);
 	// pc->first_pos is now <= start_pos
@@ -574,6 +851,225 @@ cache_set_limit(STR_CACHE *pc, int limit){
 
 };
 
+/* Stores v in 4 bytes at p, least significant byte first */
+void
+put_int(char *p, int v){
+	int i;
+	
+	for (i=0; i<4; i++, v >>= 8)
+		p[i] = v & 0xFF;
+};
+
+int
+get_int(const char *p){
+	return (p[0] & 0xFF) | ((p[1] & 0xFF) << 8) | ((p[2] & 0xFF) << 16) | ((p[3] & 0xFF) << 24);
+};
+
+/* Returns the string at pos p, if the cache knows it, else NULL */
+static char *
+saved_str(STR_CACHE *pc, int p){
+	int i = cache_index(pc, p);
+	
+	if ( (pc->entry[i].pos != p) || (pc->entry[i].off < 0) )
+		return NULL;						// not known or no room in the arena
+	return cache_arena + pc->entry[i].off;
+};
+
+/* Hands the known strings of the cache to put(), at most size bytes, so they can go to flash without a copy in RAM.
+	Layout: first_pos, pos_lim (4 bytes each), number of strings (1 byte), 
+	then for each string: its pos - first_pos (1 byte), its length (1 byte), the characters.
+	Strings that do not fit are left out.
+	Returns the number of bytes handed over.
+*/
+int
+cache_save(STR_CACHE *pc, SAVE_FUNC put, int size){
+	char head[CACHE_SAVE_HEAD];
+	int p, len, end;
+	int n = 0, used = CACHE_SAVE_HEAD;
+	char *s;
+	
+	if (size < used)
+		return 0;
+	/* The number of strings comes first, so count what fits */
+	for (p = pc->first_pos; p <= last_pos(pc); p++){
+		if (NULL == (s = saved_str(pc, p)))
+			continue;
+		len = (unsigned char) s[-1];
+		if (used + 2 + len > size)
+			break;
+		used += 2 + len;
+		n++;
+	};
+	end = p;
+	
+	put_int(head, pc->first_pos);
+	put_int(head + 4, pc->pos_lim);
+	head[8] = n;
+	put(head, CACHE_SAVE_HEAD);
+	for (p = pc->first_pos; p < end; p++){
+		if (NULL == (s = saved_str(pc, p)))
+			continue;
+		head[0] = p - pc->first_pos;
+		head[1] = s[-1];
+		put(head, 2);
+		put(s, (unsigned char) s[-1]);
+	};
+	return used;
+};
+
+/* Fills a cache, that has just been initialized, from buf (see cache_save()).
+	Returns the number of bytes read, or -1 if buf does not hold a valid cache.
+*/
+int
+cache_load(STR_CACHE *pc, const char *buf, int size){
+	char tmp[CACHE_ENTRY_SIZE];
+	int n, d, len, p;
+	int used = CACHE_SAVE_HEAD;
+	
+	if (size < used)
+		return -1;
+	pc->first_pos = get_int(buf);
+	pc->pos_lim = get_int(buf + 4);
+	if (pc->first_pos < 0)
+		pc->first_pos = 0;
+	for (p = pc->first_pos; p <= last_pos(pc); p++)
+		pos_fresh(pc, p);
+	
+	for (n = (unsigned char) buf[8]; n > 0; n--){
+		if (used + 2 > size)
+			return -1;
+		d = (unsigned char) buf[used++];
+		len = (unsigned char) buf[used++];
+		if ( (d >= CACHE_LIM) || (len > CACHE_ENTRY_LEN) || (used + len > size) )
+			return -1;
+		memcpy(tmp, buf + used, len);
+		tmp[len] = '\0';
+		cache_store(pc, pc->first_pos + d, tmp);
+		used += len;
+	};
+	return used;
+};
+
 /* ==================================== End of string cache functions ========================================= */
 
 
+/* ------------------------------------- String pool ----------------------------------------- */
+
+static struct {
+	short off;			// offset of the string in the arena
+	uint8_t refs;		// number of owners, 0 if the slot is free
+} pool_slot[POOL_SLOTS];
+
+static char pool_arena[POOL_ARENA_SIZE];
+static int pool_used;	// bytes of the arena in use, dead records included
+
+/* Moves the live records of the arena down over the dead ones. */
+static void
+pool_compact(){
+	int src = 0, dst = 0;
+	int size, owner, i;
+	
+	while (src < pool_used){
+		owner = pool_arena[src];
+		size = (unsigned char) pool_arena[src + 1] + 3;
+		if ( (pool_slot[owner].refs > 0) && (pool_slot[owner].off == src + 2) ){
+			if (dst != src){
+				for (i=0; i<size; i++)
+					pool_arena[dst + i] = pool_arena[src + i];
+				pool_slot[owner].off = dst + 2;
+			};
+			dst += size;
+		};
+		src += size;
+	};
+	pool_used = dst;
+};
+
+/* Copies at most maxlen (< 256) characters of s into the pool.
+	Returns the reference of the first owner, NO_STR if s is NULL or the pool is full.
+	If the arena is too full for all of s, the string is cut (see pool_set()).
+	NOTE s must not be a string of the pool, use pool_ref() to share it.
+*/
+STR_REF
+pool_new(char *s, int maxlen){
+	int r, len, p;
+	
+	if (NULL == s)
+		return NO_STR;
+	for (r = 1; r < POOL_SLOTS; r++)
+		if (0 == pool_slot[r].refs)
+			break;
+	if (r >= POOL_SLOTS){
+		debug_out("Pool slots full", 0);
+		return NO_STR;
+	};
+	
+	len = min(strlen(s), maxlen);
+	if (pool_used + len + 3 > POOL_ARENA_SIZE)
+		pool_compact();
+	if (pool_used + len + 3 > POOL_ARENA_SIZE){
+		debug_out("Pool arena full ", len);
+		len = POOL_ARENA_SIZE - pool_used - 3;
+		if (len < 0)
+			return NO_STR;
+	};
+	
+	p = pool_used;
+	pool_arena[p] = r;
+	pool_arena[p + 1] = len;
+	strlcpy(pool_arena + p + 2, s, len + 1);
+	pool_slot[r].off = p + 2;
+	pool_slot[r].refs = 1;
+	pool_used = p + len + 3;
+	return r;
+};
+
+/* Another owner shares the string r. Returns r. */
+STR_REF
+pool_ref(STR_REF r){
+	if (NO_STR != r)
+		pool_slot[r].refs++;
+	return r;
+};
+
+/* An owner does not need the string r any more */
+void
+pool_put(STR_REF r){
+	if ( (NO_STR != r) && (pool_slot[r].refs > 0) )
+		pool_slot[r].refs--;
+};
+
+/* The owner of *pr gets a copy of s instead of its old string.
+	Returns FALSE iff the pool had no room for all of s, then *pr holds a cut string or NO_STR.
+*/
+int
+pool_set(STR_REF *pr, char *s, int maxlen){
+	pool_put(*pr);
+	*pr = pool_new(s, maxlen);
+	if (NULL == s)
+		return 1;
+	return (NO_STR != *pr) && (strlen(pool_str(*pr)) == min(strlen(s), maxlen));
+};
+
+/* Returns the string r, NULL if r is NO_STR */
+char *
+pool_str(STR_REF r){
+	if (NO_STR == r)
+		return NULL;
+	return pool_arena + pool_slot[r].off;
+};
+
+/* Returns TRUE iff a and b are the same string (or both NO_STR) */
+int
+pool_equal(STR_REF a, STR_REF b){
+	char *s1 = pool_str(a);
+	char *s2 = pool_str(b);
+	
+	if ( (NULL == s1) || (NULL == s2) )
+		return (s1 == s2);
+	while ( (*s1 == *s2) && *s1 ){
+		s1++;
+		s2++;
+	};
+	return (*s1 == *s2);
+};
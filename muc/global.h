@@ -94,14 +94,26 @@ typedef struct format_values {
 #define PCSSP	21
 
 #define EOT 0x04
+#define ENQ 0x05
 
-#define CACHE_LIM	33
+#define CACHE_LIM	64
 #define CACHE_MAX	(CACHE_LIM -1)
 
-#define CACHE_ENTRY_SIZE 64
+#define CACHE_ENTRY_SIZE 128
 /* Max length of a string stored in our cache (final 0 is not counted) */
 #define CACHE_ENTRY_LEN (CACHE_ENTRY_SIZE - 1)
 
+/* The caches of tracklist, playlists and search results share one arena for their strings.
+	CACHE_LISTS * CACHE_LIM must fit into a byte (see the records below).
+*/
+#define CACHE_LISTS	3
+
+/* Bytes for the strings of all caches. Each string takes its length + 3 bytes */
+#define CACHE_ARENA_SIZE 6144
+
+/* A list that is not in use keeps the rows it shows and CACHE_WARM rows on either side */
+#define CACHE_WARM	4
+
 /* 
 	This structure is an indexed cache of consecutive string values.
 	It is a ring buffer.
@@ -111,21 +123,45 @@ typedef struct format_values {
 	and each following string has its pos incremented by 1 
 	pos == -1 means information is not yet known
 	pos == -2 means information is not available (non-existant)
+	pos == -3 means information has been requested from MPD, but the answer has not yet arrived
 	We always store only a small portion of all strings.
 	The first string that we currently have in our cache is given by the variable first_pos.
 	The variable first_idx gives the index into our array that corresponds to first_pos.
 	The constant CACHE_LIM gives the maximum total number of entries in our cache.
 
-	The real strings are stored in cache_entry[i].cache_str. 
+	The real strings are stored in an arena that all caches share, packed one after the other.
+	Each record in the arena is: owner (list * CACHE_LIM + index of the entry), length, the characters and a final 0.
+	cache_entry[i].off gives the offset of the characters in the arena, or -1 if the entry has no string.
+	A record is dead when its entry gets a new string or becomes unknown.
+	New records are appended to the arena. If the arena is full, the live records are moved down
+	over the dead ones. So a pointer returned by cache_info() is only good until the next cache_store()
+	to any of the caches.
+
+	Only one list is on screen at a time, so the arena goes to the list that was shown last.
+	Each cache_range_set() marks its list as the most recently used one. If the arena is full, 
+	cache_store() drops strings of the other lists, the least recently used list first,
+	until each of them only keeps the rows it shows and CACHE_WARM rows around them.
+	Then it drops strings of its own list, the ones farthest away from the rows shown.
+	Such an entry is DROPPED. It is fetched again when it is shown, or when its list is used again.
+	If there is still no room, the new string is cut to the room that is left.
+
+	cache_range_set() also follows how the user scrolls. trend counts the rows moved in one direction
+	(> 0 down, < 0 up), up to TREND_MAX. The further the user keeps going, the more of the cache lies
+	ahead of the rows shown. cache_find_unknown() gives out the rows shown first, then the ones ahead,
+	the nearest first, and the ones behind last.
 
 */
 
 #define NOT_KNOWN	-1
 #define NOT_AVAIL	-2
+#define REQUESTED	-3
+#define DROPPED		-4
+
+#define TREND_MAX	8
 
 struct cache_entry {
-	int pos;		// positional id of this entry, or NOT_KNOWN or NOT_AVAIL
-	char cache_str[CACHE_ENTRY_SIZE];	// the cached string
+	int pos;		// positional id of this entry, or NOT_KNOWN, NOT_AVAIL, REQUESTED or DROPPED
+	short off;		// offset of the cached string in the arena, -1 if none
 };
 
 typedef struct str_cache {
@@ -133,6 +169,11 @@ typedef struct str_cache {
 	int first_pos;	// positional id of first cached information
 	int first_idx;	// index of cache-entry corresponding to first_pos.
 	int pos_lim;	// positional index of the last available info + 1 (-1 means unknown) 
+	int shown_first;	// first pos shown on screen, -1 if none
+	int shown_last;		// last pos shown on screen
+	int trend;			// scroll direction and speed
+	int list;			// index of this cache in the list of caches that share the arena
+	unsigned long last_use;	// when the list was shown last, in calls of cache_range_set()
 } STR_CACHE;
 
 /* 
@@ -149,9 +190,12 @@ int strlen( char *s);
 int strstart( char *s1, char *s2);
 int strlcpy(char *dst, const char *src, int size);
 int strlcat(char *dst, const char *src, int size);
+void *memcpy(void *dest, const void *src, int count);
+int memcmp(const void *cs, const void *ct, int count);
 int strn_cpy_cmp(char *str1, char *str2, int n, int *length);
 int atoi(const char *s);
 int str_del(char *s, int pos);
+char *str_find(char *s, char *pat);
 char *strchr(const char *s, int c);
 char *get_hex_digits(unsigned long v, char *s);
 char *get_digits(unsigned int val, char *s, int z);
@@ -165,8 +209,52 @@ void cache_init(STR_CACHE *pc);
 void cache_unknown(STR_CACHE *pc, int pos);
 void cache_clear(STR_CACHE *pc, int pos);
 void cache_store(STR_CACHE *pc, int pos, char *content);
-int cache_find_unknown(STR_CACHE *pc);
+int cache_find_unknown(STR_CACHE *pc, int limit);
+void cache_requested(STR_CACHE *pc, int pos);
+void cache_lost(STR_CACHE *pc, int pos);
+int cache_match(STR_CACHE *pc, int *pos, char *pat);
 void cache_range_set(STR_CACHE *pc, int start_pos, int end_pos);
 void cache_set_limit(STR_CACHE *pc, int limit);
 
+/* cache_save() needs CACHE_SAVE_HEAD bytes and 2 bytes + the characters for each string.
+	CACHE_SAVE_SIZE holds the strings of one list in its share of the arena.
+*/
+#define CACHE_SAVE_HEAD		9
+#define CACHE_SAVE_SIZE		(CACHE_SAVE_HEAD + CACHE_ARENA_SIZE / CACHE_LISTS)
+typedef void (*SAVE_FUNC)(const char *p, int n);
+int cache_save(STR_CACHE *pc, SAVE_FUNC put, int size);
+int cache_load(STR_CACHE *pc, const char *buf, int size);
+void put_int(char *p, int v);
+int get_int(const char *p);
+
+/* 
+	The string pool holds the strings that we only need a few of at a time,
+	but which can be long: title, artist and name of a song, error messages from MPD.
+	Several owners can share one string. Each owner holds a reference (STR_REF), NO_STR means no string.
+	pool_new() copies a string into the pool for its first owner, pool_ref() adds an owner,
+	pool_put() drops one. The string dies with its last owner.
+	
+	The strings are packed in an arena like those of STR_CACHE. Each record is: slot, length, the characters and a final 0.
+	If the arena is full, the live records are moved down over the dead ones.
+	So a pointer returned by pool_str() is only good until the next pool_new().
+	
+	Worst case: mpd_model holds artist, title and name (149 characters each), the answer that mpd.c is parsing
+	holds them and an error message (63), the next song holds 2 titles, and a "?" is on its way to its owner.
+	That is 10 strings in 1286 bytes, slot 0 is NO_STR. Only one answer holds strings at a time, 
+	mpd.c gives back those of an answer that was cut off. If the pool is full nevertheless, 
+	pool_set() tells the owner, so that it can fetch the string again later.
+*/
+#define POOL_SLOTS		12
+#define POOL_ARENA_SIZE	1296
+
+typedef uint8_t STR_REF;
+#define NO_STR			0
+
+STR_REF pool_new(char *s, int maxlen);
+STR_REF pool_ref(STR_REF r);
+void pool_put(STR_REF r);
+int pool_set(STR_REF *pr, char *s, int maxlen);
+char *pool_str(STR_REF r);
+int pool_equal(STR_REF a, STR_REF b);
+
 #endif
@@ -0,0 +1,106 @@
+/*
+    flash_host.c - the second flash chip of Betty for the host build
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* 
+	bfs.c reads the flash through pointers to FLASH1_BASE. So we map the memory of the chip at that address
+	and the real file system runs unchanged. This replaces flash.c:
+	- eraseSector() sets all bytes of the sector to 0xFF.
+	- eraseStart() does the same, but eraseDone() only returns TRUE a second later, like the real chip.
+	- writeWord() can only clear bits, like the real chip.
+	
+	If a file is given, the chip is kept in that file, so a snapshot survives until the next run.
+*/
+
+#include "flash.h"
+#include "host.h"
+#include "kernel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#define CHIP_SIZE	0x100000
+
+const unsigned long secaddr[19] = 
+{ 0x00000, 0x02000, 0x03000, 0x04000, 0x08000, 0x10000, 0x18000, 0x20000, 0x28000, 0x30000, 
+  0x38000, 0x40000, 0x48000, 0x50000, 0x58000, 0x60000, 0x68000, 0x70000, 0x78000 };
+
+static unsigned char *chip;
+static unsigned int erase_start;		// system_time() when eraseStart() was called
+
+void
+host_flash_init(char *filename){
+	int fd = -1;
+	int flags = MAP_SHARED | MAP_FIXED_NOREPLACE;
+	int fresh = 1;
+	
+	if (filename != NULL){
+		fd = open(filename, O_RDWR | O_CREAT, 0644);
+		if (fd < 0){
+			perror(filename);
+			exit(1);
+		};
+		fresh = (lseek(fd, 0, SEEK_END) < CHIP_SIZE);
+		if (ftruncate(fd, CHIP_SIZE) != 0){
+			perror(filename);
+			exit(1);
+		};
+	} else
+		flags |= MAP_ANONYMOUS;
+	
+	chip = mmap((void *) FLASH1_BASE, CHIP_SIZE, PROT_READ | PROT_WRITE, flags, fd, 0);
+	if (chip != (unsigned char *) FLASH1_BASE){
+		fprintf(stderr, "Cannot map the flash at 0x%X\n", FLASH1_BASE);
+		exit(1);
+	};
+	if (fresh)
+		memset(chip, 0xFF, CHIP_SIZE);	// erased
+	if (fd >= 0)
+		close(fd);
+};
+
+int
+eraseSector(unsigned char chip_nr, unsigned char secnum){
+	unsigned long end = (secnum < 18) ? secaddr[secnum + 1] * 2 : CHIP_SIZE;
+	
+	if ( (chip_nr != 1) || (secnum > 18) )
+		return -1;						// McBetty runs from chip 0
+	memset(chip + secaddr[secnum] * 2, 0xFF, end - secaddr[secnum] * 2);
+	return 0;
+};
+
+int
+eraseStart(unsigned char chip_nr, unsigned char secnum){
+	erase_start = system_time();
+	return eraseSector(chip_nr, secnum);
+};
+
+int
+eraseDone(){
+	return (system_time() - erase_start >= TICKS_PER_SEC);
+};
+
+int
+writeWord(unsigned long addr, unsigned short data){
+	if ( (addr < FLASH1_BASE) || (addr >= FLASH1_BASE + CHIP_SIZE) || (addr & 1) )
+		return -1;
+	*((unsigned short *) addr) &= data;
+	return 0;
+};
@@ -0,0 +1,44 @@
+/*
+    host.h - interfaces of the simulated hardware for the host build
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HOST_H
+#define HOST_H
+
+/* Signals of the kernel. Needed to find out when the simulated CPU may sleep. */
+extern volatile unsigned int signals;
+
+/* lcd_port.c */
+extern unsigned long lcd_changes;
+int lcd_pixel(int x, int y);
+int lcd_dump(char *filename);
+
+/* rf_host.c */
+int rf_host_deliver(unsigned char *pkt, int len);
+void rf_host_stats(void);
+
+/* The transport for the radio, provided by the program (host_main.c or sim_link.c) */
+void host_radio_send(char *pkt, int len);
+
+/* flash_host.c */
+void host_flash_init(char *filename);
+
+/* keyboard_host.c */
+int key_script_open(char *filename);
+int key_script_done(void);
+void key_push(int key);
+
+#endif
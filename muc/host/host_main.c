@@ -0,0 +1,218 @@
+/*
+    host_main.c - runs the firmware on a Linux host
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+	The kernel, the model, the MPD protocol and all of the display code run unchanged.
+	Only the hardware below them is simulated (see host.h):
+	- the lcd controller is emulated in memory, its contents can be written to a PGM file,
+	- the radio reads from and writes to file descriptors (stdin and stdout by default),
+	- key presses come from a script,
+	- debug output goes to stderr.
+	
+	The timer interrupt is played by the main loop. Normally a tick is 10 ms of real time.
+	With option -f the clock is virtual: whenever the scheduler has nothing to do, time jumps to the next tick.
+	So a script of several minutes runs in a fraction of a second and each run gives the same result.
+	
+	Usage: betty_host [-f] [-q] [-i radio_in] [-o radio_out] [-k key_script] [-t ticks] [-l lcd.pgm]
+*/
+
+#include "global.h"
+#include "kernel.h"
+#include "lcd.h"
+#include "keyboard.h"
+#include "serial.h"
+#include "pwmirq.h"
+#include "rf.h"
+#include "cc1100_defs.h"
+#include "mpd.h"
+#include "window.h"
+#include "screen.h"
+#include "host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <poll.h>
+
+volatile unsigned long host_reg;
+
+/* Milliseconds per tick */
+#define TICK_MS		(T0PERIOD / 1000)
+
+static int radio_in_fd = 0;
+static int radio_out_fd = 1;
+
+/* Commands from Betty go to the radio output */
+void
+host_radio_send(char *pkt, int len){
+	int res;
+	
+	while (len > 0){
+		res = write(radio_out_fd, pkt, len);
+		if (res <= 0){
+			perror("radio output");
+			return;
+		};
+		pkt += res;
+		len -= res;
+	};
+};
+
+/* Waits at most timeout_ms for input on the radio and delivers it to Betty as one packet.
+	A packet that Betty has no room for is kept until the next call.
+*/
+static void
+radio_poll(int timeout_ms){
+	static unsigned char pkt[MAX_PKTLEN];
+	static int len;
+	struct pollfd pfd;
+	
+	if ((len > 0) && rf_host_deliver(pkt, len))
+		len = 0;
+	
+	if ((radio_in_fd < 0) || (len > 0)){
+		if (timeout_ms > 0)
+			usleep(timeout_ms * 1000);
+		return;
+	};
+		
+	pfd.fd = radio_in_fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, timeout_ms) <= 0)
+		return;
+
+	len = read(radio_in_fd, pkt, MAX_PKTLEN);
+	if (len <= 0){
+		radio_in_fd = -1;				// end of input, Betty goes on without answers
+		len = 0;
+	} else if (rf_host_deliver(pkt, len))
+		len = 0;
+};
+
+static unsigned long long
+now_ms(){
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+};
+
+static void
+usage(char *name){
+	fprintf(stderr, "Usage: %s [-f] [-q] [-i radio_in] [-o radio_out] [-k key_script] [-t ticks] [-l lcd.pgm]\n", name);
+	fprintf(stderr, "  -f  virtual clock, time jumps to the next tick while the firmware is idle\n");
+	fprintf(stderr, "  -q  no debug output\n");
+	fprintf(stderr, "  -t  stop after this number of ticks (1 tick = %d ms)\n", TICK_MS);
+	fprintf(stderr, "  -l  write the display contents to this file at the end\n");
+	exit(1);
+};
+
+static int
+open_or_die(char *filename, int flags){
+	int fd = open(filename, flags, 0644);
+	
+	if (fd < 0){
+		perror(filename);
+		exit(1);
+	};
+	return fd;
+};
+
+int
+main(int argc, char *argv[]){
+	int opt;
+	int fast = 0;
+	unsigned int max_ticks = 0;
+	char *lcd_file = NULL;
+	unsigned long long next_tick;
+	int wait_ms;
+	
+	while ((opt = getopt(argc, argv, "fqi:o:k:t:l:")) != -1){
+		switch (opt){
+			case 'f':
+				fast = 1;
+				break;
+			case 'q':
+				fDebug = 0;
+				break;
+			case 'i':
+				radio_in_fd = open_or_die(optarg, O_RDONLY);
+				break;
+			case 'o':
+				radio_out_fd = open_or_die(optarg, O_WRONLY | O_CREAT | O_TRUNC);
+				break;
+			case 'k':
+				if (key_script_open(optarg))
+					exit(1);
+				break;
+			case 't':
+				max_ticks = strtoul(optarg, NULL, 0);
+				break;
+			case 'l':
+				lcd_file = optarg;
+				break;
+			default:
+				usage(argv[0]);
+		};
+	};
+	
+	host_flash_init(NULL);
+	
+	/* Same order as in main.c */
+	kernel_init();
+	lcd_init(0);
+	RF_init();
+	inactivity_cnt = 0;
+	key_init();
+	model_init();
+	mainscreen_init();
+	dbg("RESET");
+	task_add(&controller);
+	
+	next_tick = now_ms() + TICK_MS;
+	while ((0 == max_ticks) || (system_time() < max_ticks)){
+		schedule();
+		
+		/* The CPU may only sleep if no event is waiting (see kernel_idle) */
+		if (signals || ! rx_buf_empty())
+			wait_ms = 0;
+		else if (fast)
+			wait_ms = -1;
+		else {
+			wait_ms = next_tick - now_ms();
+			if (wait_ms < 0)
+				wait_ms = 0;
+		};
+		
+		radio_poll(wait_ms < 0 ? 0 : wait_ms);
+		if (signals)
+			continue;
+		
+		if ((wait_ms < 0) || (now_ms() >= next_tick)){
+			timerIRQ();
+			next_tick += TICK_MS;
+		};
+	};
+	
+	fprintf(stderr, "stopped after %u ticks\n", system_time());
+	rf_host_stats();
+	if (lcd_file)
+		lcd_dump(lcd_file);
+	return 0;
+};
@@ -0,0 +1,27 @@
+/*
+    irq.h - interrupt definitions for the host build
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* There are no interrupts on the host. The kernel only needs the VIC constants. */
+
+#ifndef IRQ_H
+#define IRQ_H
+
+#define		INT_TIMER0		0x00000010
+#define		INT_SRC_TIMER0	4
+#define		VIC_SLOT_EN		0x00000020
+
+#endif
@@ -0,0 +1,29 @@
+/*
+    isr.h - interrupt locking for the host build
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* On the host the "interrupts" (timer tick, radio input, key presses) are called from the main loop,
+	so locking is not necessary.
+*/
+
+#ifndef isr_h
+#define isr_h
+
+#define ARM_INT_KEY_TYPE		unsigned int
+#define ARM_INT_LOCK(key_)		((key_) = 0)
+#define ARM_INT_UNLOCK(key_)	((void) (key_))
+
+#endif
@@ -0,0 +1,178 @@
+/*
+    keyboard_host.c - scripted key presses for the host build
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+	Instead of scanning the keyboard matrix we read key presses from a script
+	or get them from key_push().
+	Each line of the script contains the system time (in ticks) and the key:
+		<ticks> <key name or number>
+	for example
+		100 OK
+		250 Down
+	Lines starting with '#' are ignored. The times must not decrease.
+	
+	A key is pressed for one tick, then released. Auto repeat is not simulated.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kernel.h"
+#include "timerirq.h"
+#include "keyboard.h"
+#include "host.h"
+
+/* The key currently pressed (-1 means no key pressed)*/
+int cur_key;
+
+/* Normally in pwmirq.c */
+unsigned int inactivity_cnt;
+
+static FILE *script;
+
+/* The next key from the script and when it is pressed */
+static int next_key;
+static unsigned int next_time;
+
+/* A key given by key_push() */
+static int pushed_key = NO_KEY;
+
+/* Names as in keyboard.h, indexed by key code */
+static char *key_names[] = {
+	"5", "6", "C", "B", "A", "1",
+	"8", "9", "D", "Up", "Betty", "4",
+	"0", "AV", "Right", "Left", "Vplus", "7",
+	"AB", "16_9", "Exit", "OK", "Vminus", "Minus",
+	"VTX2", "VTX3", "Pplus", "Down", "Menu", "PiP",
+	"Yellow", "Blue", "Pminus", "Mute", "Info", "VTX1",
+	"TV", "Power", "3", "2", "Red", "Green"
+};
+
+#define NUM_KEYS (sizeof(key_names) / sizeof(key_names[0]))
+
+/* Returns the key code for the given name or number, NO_KEY if unknown */
+static int
+key_code(char *name){
+	unsigned int i;
+	char *end;
+	long n;
+	
+	for (i=0; i<NUM_KEYS; i++)
+		if (0 == strcmp(name, key_names[i]))
+			return i;
+	
+	n = strtol(name, &end, 0);
+	if ((*end == '\0') && (n >= 0) && (n < (long) NUM_KEYS))
+		return n;
+	return NO_KEY;
+};
+
+/* Reads the next event from the script.
+	Sets next_key to NO_KEY at the end of the script.
+*/
+static void
+read_next(){
+	char line[80];
+	char name[20];
+	
+	next_key = NO_KEY;
+	if (NULL == script)
+		return;
+	
+	while (fgets(line, sizeof(line), script)){
+		if ((line[0] == '#') || (2 != sscanf(line, "%u %19s", &next_time, name)))
+			continue;
+		next_key = key_code(name);
+		if (next_key != NO_KEY)
+			return;
+		fprintf(stderr, "key script: unknown key %s\n", name);
+	};
+	fclose(script);
+	script = NULL;
+};
+
+int
+key_script_open(char *filename){
+	script = fopen(filename, "r");
+	if (NULL == script){
+		perror(filename);
+		return -1;
+	};
+	read_next();
+	return 0;
+};
+
+/* Returns TRUE iff all keys of the script have been pressed */
+int
+key_script_done(){
+	return (next_key == NO_KEY) && (cur_key == NO_KEY) && (pushed_key == NO_KEY);
+};
+
+/* The key is pressed with the next tick */
+void
+key_push(int key){
+	pushed_key = key;
+};
+
+/* Plays the key script */
+PT_THREAD (key_scan(struct pt *pt)){
+	static struct timer tmr;
+	
+	PT_BEGIN(pt);
+	timer_add(&tmr, 1, 1);
+	
+	do {
+		PT_WAIT_UNTIL(pt, timer_expired(&tmr));
+		tmr.expired = 0;
+		
+		if (cur_key != NO_KEY)
+			cur_key = NO_KEY;				// released after one tick
+		else if (pushed_key != NO_KEY){
+			cur_key = pushed_key;
+			pushed_key = NO_KEY;
+			signal_set(SIG_KEY_CHG);
+		} else if ((next_key != NO_KEY) && (system_time() >= next_time)){
+			cur_key = next_key;
+			signal_set(SIG_KEY_CHG);
+			read_next();
+		};
+	} while (1);	
+	PT_END(pt);	
+};
+
+void 
+key_init(){
+	cur_key = NO_KEY;
+	task_add(&key_scan);
+};
+
+/* Variable which holds the current function to receive key presses */
+static void (*keypress_handler) (int cur_key) = NULL;
+
+void 
+set_keypress_handler (void (*new_handler) (int cur_key)){
+	keypress_handler = new_handler;
+};
+
+/* Same as in keyboard.c */
+void 
+key_change(){
+	signal_clr(SIG_KEY_CHG);
+	inactivity_cnt = 0;
+    if (NULL != keypress_handler) (*keypress_handler)(cur_key);
+};
@@ -0,0 +1,146 @@
+/*
+    lcd_port.c - lcd controller emulation for the host build
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* 
+	lcd.c talks to the controller only through lcd_cmd(), lcd_write() and lcd_read().
+	Here we keep the display RAM of the controller in memory, so that the real drawing code runs unchanged.
+	
+	We only emulate what lcd.c uses:
+	- page address (0xB0 followed by the page number)
+	- column address (0x10 + high nibble, then 0x00 + low nibble)
+	- 2 bytes per column (msb plane, then lsb plane), the column address increments after the second byte.
+	- The first read after setting the address returns a dummy byte.
+	All other commands (and their arguments) are ignored.
+*/
+
+#include "global.h"
+#include "lcd.h"
+#include "host.h"
+
+#include <stdio.h>
+
+/* Number of pages in LCD RAM (only the first 20 are visible) */
+#define RAM_PAGES	22
+
+static uint8 lcd_ram[RAM_PAGES][2 * LCD_SIZE_X];
+
+/* Number of writes that changed the contents of the visible LCD RAM */
+unsigned long lcd_changes;
+
+static int cur_page;
+static int cur_col;			// column address
+static int cur_byte;		// 0 or 1, which byte of the column comes next
+static int dummy_read;		// the next read is a dummy read
+
+/* The command that waits for its argument (0 if none) */
+static unsigned char cmd_arg;
+
+/* Commands which are followed by one argument byte */
+static int
+has_arg(unsigned char c){
+	return (c == 0x81) || (c == 0xB0) || ((c >= 0x60) && (c <= 0x63)) || ((c >= 0x88) && (c <= 0x8F));
+};
+
+static void
+set_address(){
+	cur_byte = 0;
+	dummy_read = 1;
+};
+
+void
+lcd_cmd(unsigned char c){
+	if (cmd_arg){
+		if (cmd_arg == 0xB0)
+			cur_page = c % RAM_PAGES;
+		cmd_arg = 0;
+		set_address();
+		return;
+	};
+	
+	if (has_arg(c))
+		cmd_arg = c;
+	else if (c <= 0x0F){
+		cur_col = (cur_col & 0xF0) | c;
+		set_address();
+	} else if (c <= 0x17){
+		cur_col = ((c & 0x07) << 4) | (cur_col & 0x0F);
+		set_address();
+	};
+};
+
+/* Advance to the next byte in LCD RAM */
+static void
+next_byte(){
+	if (cur_byte == 0)
+		cur_byte = 1;
+	else {
+		cur_byte = 0;
+		cur_col = (cur_col + 1) % LCD_SIZE_X;
+	};
+};
+
+void
+lcd_write(unsigned char d){
+	dummy_read = 0;
+	if ((cur_page < LCD_SIZE_Y / 8) && (lcd_ram[cur_page][2 * cur_col + cur_byte] != d))
+		lcd_changes++;
+	lcd_ram[cur_page][2 * cur_col + cur_byte] = d;
+	next_byte();
+};
+
+unsigned char
+lcd_read(void){
+	unsigned char d;
+	
+	if (dummy_read){
+		dummy_read = 0;
+		return 0;
+	};
+	d = lcd_ram[cur_page][2 * cur_col + cur_byte];
+	next_byte();
+	return d;
+};
+
+/* Returns the color (WHITE .. BLACK) of the given pixel */
+int
+lcd_pixel(int x, int y){
+	uint8 *p = &lcd_ram[y >> 3][2 * x];
+	int bit = y & 7;
+	
+	return (((p[0] >> bit) & 1) << 1) | ((p[1] >> bit) & 1);
+};
+
+/* Write the visible part of the display as a grey scale image (PGM). 
+	Returns 0 on success.
+*/
+int
+lcd_dump(char *filename){
+	FILE *f;
+	int x, y;
+	
+	f = fopen(filename, "wb");
+	if (NULL == f){
+		perror(filename);
+		return -1;
+	};
+	fprintf(f, "P5\n%d %d\n3\n", LCD_SIZE_X, LCD_SIZE_Y);
+	for (y=0; y<LCD_SIZE_Y; y++)
+		for (x=0; x<LCD_SIZE_X; x++)
+			fputc(BLACK - lcd_pixel(x, y), f);
+	fclose(f);
+	return 0;
+};
@@ -0,0 +1,45 @@
+/*
+    lpc2220.h - register definitions for the host build
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* The portable modules include lpc2220.h, but only the kernel touches a few registers
+	(timer0, VIC and PCON). On the host all of them are written to a dummy variable.
+	The host include path puts this directory first, so this file replaces the real one.
+*/
+
+#ifndef LPC2220_H
+#define LPC2220_H
+
+extern volatile unsigned long host_reg;
+
+#define VICIntSelect	host_reg
+#define VICIntEnable	host_reg
+#define VICIntEnClr		host_reg
+#define VICDefVectAddr	host_reg
+#define VICVectAddr15	host_reg
+#define VICVectCntl15	host_reg
+
+#define T0IR			host_reg
+#define T0TCR			host_reg
+#define T0TC			host_reg
+#define T0PR			host_reg
+#define T0MCR			host_reg
+#define T0MR0			host_reg
+#define T0CTCR			host_reg
+
+#define PCON			host_reg
+
+#endif
@@ -0,0 +1,179 @@
+/*
+    rf_host.c - radio emulation for the host build
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+	Implements the interface of rf.h without the CC1100.
+	
+	The program that uses the simulated hardware provides the transport (see host.h):
+	What Betty sends is given to host_radio_send(), each command followed by EOT,
+	just like the scart adapter forwards it to mpdtool.
+	Received packets are handed to rf_host_deliver(). This plays the interrupt (rxIRQ)
+	and sets SIG_RX_PACKET, the kernel then calls rfRcvPacket() which fills the ring buffer.
+	EOT is dropped as in the real rfRcvPacket().
+	
+	There is no airtime budget. Every command is sent at once.
+*/
+
+#include "global.h"
+#include "kernel.h"
+#include "cc1100_defs.h"
+#include "rf.h"
+#include "host.h"
+
+#include <stdio.h>
+
+/* Time of the last transmission */
+static unsigned int last_tx;
+
+/* Some statistics */
+static unsigned int tx_packets, tx_bytes, rx_count, rx_bytes;
+
+/* Packets that rxIRQ has seen, but rfRcvPacket has not yet read.
+	The real radio chip has room for one packet in its fifo, we allow a few more.
+*/
+#define RX_PACKETS_LIM	(4 * MAX_PKTLEN)
+static uint8_t rx_packets[RX_PACKETS_LIM];
+static int rx_packets_len;
+
+void
+rf_host_stats(){
+	fprintf(stderr, "radio: sent %u packets (%u bytes), received %u packets (%u bytes)\n", 
+			tx_packets, tx_bytes, rx_count, rx_bytes);
+};
+
+/* ---------------------------- Sending ------------------------------------- */
+
+int
+send_cmd(char *cmd_str, int prio){
+	char pkt[RX_PACKETS_LIM];
+	int len = min(strlcpy(pkt, cmd_str, sizeof(pkt) - 1), sizeof(pkt) - 2);
+	
+	pkt[len] = EOT;
+	host_radio_send(pkt, len + 1);
+	last_tx = system_time();
+	tx_packets++;
+	tx_bytes += len + 1;
+	return 1;
+};
+
+int
+rf_tx_queued(){
+	return 0;
+};
+
+unsigned int
+rf_last_tx(){
+	return last_tx;
+};
+
+void
+rf_sleep(){
+};
+
+void
+rf_wake(){
+};
+
+void
+rx_reset(){
+};
+
+int
+rf_rx_active(){
+	return 0;
+};
+
+/* ---------------------------------- Receiving ------------------------------------ */
+
+/* Same ring buffer as in rf.c */
+#define RX_BUF_LIM 1024
+#define RX_BUF_MAX (RX_BUF_LIM - 1)
+
+static uint8_t rx_buf[RX_BUF_LIM];
+static int rx_buf_first;
+static int rx_buf_free;
+
+int
+rx_buf_empty(){
+	return (rx_buf_first == rx_buf_free);
+};
+
+uint8_t
+get_from_rx_buf(){
+	uint8_t val = rx_buf[rx_buf_first++];
+	if (rx_buf_first > RX_BUF_MAX)
+		   rx_buf_first = 0;
+	return val;
+};
+
+static int 
+put_in_buf(uint8_t c){
+	int new_free = rx_buf_free+1;
+	if (new_free > RX_BUF_MAX)
+		new_free=0;
+	if (new_free == rx_buf_first)
+		return 0;
+	rx_buf[rx_buf_free]=c;
+	rx_buf_free = new_free;
+	return 1;
+};
+
+/* A packet has arrived. */
+void 
+rxIRQ(){
+	signal_set(SIG_RX_PACKET);
+};
+
+void 
+rfRcvPacket(){
+	int i;
+	
+	signal_clr(SIG_RX_PACKET);
+	for (i=0; i<rx_packets_len; i++){
+		if (rx_packets[i] == EOT)
+			continue;
+		if (!put_in_buf(rx_packets[i])){
+			debug_out("rx buffer overrun", 0);
+			break;
+		};
+	};
+	rx_packets_len = 0;
+};
+
+/* A packet has been received.
+	Returns 0 if there is no room for it (the packet is lost), else 1.
+*/
+int
+rf_host_deliver(uint8_t *pkt, int len){
+	int i;
+	
+	if (rx_packets_len + len > RX_PACKETS_LIM)
+		return 0;
+	for (i=0; i<len; i++)
+		rx_packets[rx_packets_len++] = pkt[i];
+	rx_count++;
+	rx_bytes += len;
+	rxIRQ();
+	return 1;
+};
+
+void 
+RF_init(){
+	rx_buf_first = 0;
+	rx_buf_free = 0;
+	rx_packets_len = 0;
+};
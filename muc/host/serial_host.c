@@ -0,0 +1,55 @@
+/*
+    serial_host.c - debug output for the host build
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* The debug output goes to stderr, together with the system time, instead of the serial port. */
+
+#include "global.h"
+#include "kernel.h"
+#include "serial.h"
+
+#include <stdio.h>
+
+int fDebug = 1;
+
+void 
+debug_out(char *s, unsigned int v){	
+	if (!fDebug) return;
+	fprintf(stderr, "%8u %s%x\n", system_time(), s, v);
+};
+
+void 
+dbg(char *s){	
+	if (!fDebug) return;
+	fprintf(stderr, "%8u %s\n", system_time(), s);
+};
+
+#ifdef TRACE
+int
+serial_flush_output(){
+	return fflush(stderr);
+};
+
+void
+serial_outs(const char *s){
+	fputs(s, stderr);
+};
+
+void
+serial_out_hex(unsigned char v){
+	fprintf(stderr, "%02x", v);
+};
+#endif
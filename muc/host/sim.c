@@ -0,0 +1,487 @@
+/*
+    sim.c - discrete event simulation of the link Betty - scart adapter - mpdtool - MPD
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+	Runs Betty's firmware (as in the host build), a model of the radio and the scart adapter (sim_link.c),
+	the real mpdtool code (sim_mpdtool.c) and a stub MPD (sim_mpd.c) on one virtual clock.
+	Nothing waits for real time, so a run takes well under a second and is reproducible for a given seed.
+	
+	Betty's CPU is assumed to be infinitely fast: at each event (a tick of the kernel timer, a received packet)
+	the scheduler runs until no signal is pending. 
+	
+	For each scenario we report the time to screen: the time from the first key press (or from power on)
+	until the last change of the display, after which the display did not change for SETTLE_TIME
+	and Betty did not wait for an answer. Changes long after any key or answer (scrolling lines, blinking cursor)
+	do not count.
+	
+	Scenarios:
+		boot	power on until the playing screen shows the current song
+		queue	open the tracklist (a queue of sim.tracks songs)
+		scroll	scroll 200 lines down in the tracklist, one key every SCROLL_KEY_TIME
+		search	type "ar" on the search screen, a key every TAP_TIME, the results follow the input
+		find	type "4321" on the tracklist screen, the list jumps to song 4321
+		jump	type "R" on the playlist screen, the list jumps to the first playlist with that initial
+		back	back to the tracklist, which opens at the current song again
+		again	to the playlist screen and back to the tracklist, both lists should still be cached
+	They run in this order, each one starts on the screen that the one before has left.
+*/
+
+#include "global.h"
+#include "kernel.h"
+#include "lcd.h"
+#include "keyboard.h"
+#include "serial.h"
+#include "rf.h"
+#include "pwmirq.h"
+#include "mpd.h"
+#include "model.h"
+#include "window.h"
+#include "screen.h"
+#include "host.h"
+#include "sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+
+volatile unsigned long host_reg;
+
+struct sim_params sim = {
+	38400,			// radio_bps
+	115200,			// serial_bps, what mpdtool negotiates by default
+	0.0,			// loss
+	50,				// scart_loop_us
+	2000,			// mpd_latency_us
+	20,				// mpd_line_us
+	5000,			// tracks
+	200,			// playlists
+	0,				// title_len
+	1,				// seed
+	0				// verbose
+};
+
+sim_time sim_now;
+
+/* The display must not change for so long, until we consider it settled */
+#define SETTLE_TIME		(2 * SIM_SEC)
+/* Display changes count only so long after a key or while Betty waits for an answer.
+	Long lines scroll and the cursor blinks forever, this is not what we measure.
+*/
+#define VIEW_DELAY		(300 * SIM_MS)
+/* We give up if a scenario takes longer */
+#define SCENARIO_LIM	(120 * SIM_SEC)
+/* Auto repeat of the keyboard */
+#define SCROLL_KEY_TIME	(200 * SIM_MS)
+#define SCROLL_LINES	200
+
+/* Time between two keys when the user types a word */
+#define TAP_TIME		(150 * SIM_MS)
+
+/* ----------------------------------- Events ----------------------------------------- */
+
+struct event {
+	sim_time t;
+	unsigned long seq;				// events at the same time are handled in order of creation
+	sim_handler h;
+	int len;
+	unsigned char data[SIM_DATA_LIM];
+};
+
+#define EVENTS_LIM	8192
+
+/* A binary heap, ordered by time */
+static struct event events[EVENTS_LIM];
+static int num_events;
+static unsigned long event_seq;
+
+static int
+before(struct event *a, struct event *b){
+	return (a->t < b->t) || ((a->t == b->t) && (a->seq < b->seq));
+};
+
+static void
+swap(int i, int j){
+	struct event e = events[i];
+	events[i] = events[j];
+	events[j] = e;
+};
+
+void
+sim_at(sim_time t, sim_handler h, unsigned char *data, int len){
+	int i, p, n;
+	
+	if (num_events >= EVENTS_LIM){
+		fprintf(stderr, "Too many events\n");
+		exit(1);
+	};
+	if (len > SIM_DATA_LIM)
+		len = SIM_DATA_LIM;
+	
+	i = num_events++;
+	events[i].t = t;
+	events[i].seq = event_seq++;
+	events[i].h = h;
+	events[i].len = len;
+	for (n=0; n<len; n++)
+		events[i].data[n] = data[n];
+	
+	while (i > 0){
+		p = (i - 1) / 2;
+		if (! before(&events[i], &events[p]))
+			break;
+		swap(i, p);
+		i = p;
+	};
+};
+
+/* Removes the first event from the heap and returns it in e */
+static void
+pop_event(struct event *e){
+	int i = 0, c;
+	
+	*e = events[0];
+	events[0] = events[--num_events];
+	while ((c = 2 * i + 1) < num_events){
+		if ((c + 1 < num_events) && before(&events[c + 1], &events[c]))
+			c++;
+		if (! before(&events[c], &events[i]))
+			break;
+		swap(i, c);
+		i = c;
+	};
+};
+
+/* xorshift, the same sequence for the same seed on every host */
+double
+sim_random(){
+	static unsigned int x;
+	
+	if (0 == x)
+		x = sim.seed ? sim.seed : 1;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x / 4294967296.0;
+};
+
+void
+sim_log(char *who, char *fmt, ...){
+	char line[200];
+	va_list ap;
+	int i;
+	
+	va_start(ap, fmt);
+	vsnprintf(line, sizeof(line), fmt, ap);
+	va_end(ap);
+	
+	printf("%10.3f ms  %-8s ", sim_now / 1000.0, who);
+	for (i=0; line[i]; i++){
+		if ((unsigned char) line[i] >= ' ')
+			putchar(line[i]);
+		else if ((line[i] != '\n') || line[i+1])
+			printf("<%02x>", line[i]);
+	};
+	putchar('\n');
+};
+
+/* ----------------------------------- Betty ----------------------------------------- */
+
+static sim_time next_tick;
+static unsigned long seen_changes;
+static sim_time last_change;
+static sim_time last_activity;			// the last key or the last time Betty waited for an answer
+
+/* Betty handles all pending events */
+static void
+run_betty(){
+	int rounds = 0;
+	
+	do {
+		schedule();
+	} while ((signals || ! rx_buf_empty()) && (++rounds < 100));
+	
+	if (! mpd_link_idle())
+		last_activity = sim_now;
+	if (lcd_changes != seen_changes){
+		seen_changes = lcd_changes;
+		if (sim_now - last_activity <= VIEW_DELAY)
+			last_change = sim_now;
+	};
+};
+
+/* Runs the simulation until the given time */
+static void
+run_until(sim_time end){
+	struct event e;
+	sim_time t;
+	
+	while (sim_now < end){
+		t = next_tick;
+		if ((num_events > 0) && (events[0].t < t))
+			t = events[0].t;
+		if (t > end){
+			sim_now = end;
+			break;
+		};
+		sim_now = t;
+		
+		while ((num_events > 0) && (events[0].t <= sim_now)){
+			pop_event(&e);
+			(*e.h)(e.data, e.len);
+		};
+		if (sim_now >= next_tick){
+			timerIRQ();
+			next_tick += T0PERIOD;
+		};
+		run_betty();
+	};
+};
+
+/* Runs until the display has settled. Returns the time of the last change or 0 if it did not settle. */
+static sim_time
+settle(sim_time start){
+	while (sim_now - start < SCENARIO_LIM){
+		run_until(sim_now + 100 * SIM_MS);
+		if ((sim_now - last_change >= SETTLE_TIME) && (sim_now - last_activity >= SETTLE_TIME))
+			return last_change;
+	};
+	return 0;
+};
+
+static void
+press(int key){
+	if (sim.verbose)
+		sim_log("user", "key %d", key);
+	key_push(key);
+	last_activity = sim_now;
+	run_until(sim_now + 2 * T0PERIOD);
+};
+
+/* ----------------------------------- Scenarios ----------------------------------------- */
+
+/* Each scenario returns the time when it started */
+
+static sim_time
+scn_boot(){
+	return 0;
+};
+
+static sim_time
+scn_queue(){
+	sim_time start = sim_now;
+	
+	press(KEY_B);						// from the playing screen to the tracklist
+	return start;
+};
+
+static sim_time
+scn_scroll(){
+	sim_time start = sim_now;
+	int i;
+	
+	for (i=0; i<SCROLL_LINES; i++){
+		press(KEY_Down);
+		run_until(sim_now + SCROLL_KEY_TIME - 2 * T0PERIOD);
+	};
+	printf("  last key after %.0f ms\n", (sim_now - start) / 1000.0);
+	return start;
+};
+
+/* Presses key n times, so that the last character of its key table is typed (see key2char()) */
+static void
+press_digit(int key, int n){
+	while (n-- > 0)
+		press(key);
+};
+
+/* Like press_digit(), but with TAP_TIME between the keys */
+static void
+tap_digit(int key, int n){
+	while (n-- > 0){
+		press(key);
+		run_until(sim_now + TAP_TIME - 2 * T0PERIOD);
+	};
+};
+
+/* Each input ("a", "ap", "aq", "ar") starts a search, the older ones are overtaken.
+	"ap" and "aq" find nothing, so the first result that we see belongs to "ar".
+*/
+static sim_time
+scn_search(){
+	sim_time start;
+	
+	press(KEY_C);						// from the tracklist to the search screen
+	settle(sim_now);
+	tap_digit(KEY_2, 1);				// "a"
+	tap_digit(KEY_7, 2);				// "ap", "aq"
+	start = sim_now;
+	press(KEY_7);						// "ar"
+	while ((mpd_get_num_results() <= 0) && (sim_now - start < SETTLE_TIME))
+		run_until(sim_now + T0PERIOD);
+	printf("  first result after %.0f ms\n", (sim_now - start) / 1000.0);
+	return start;
+};
+
+static sim_time
+scn_find(){
+	press(KEY_Exit);					// from the search screen to the tracklist
+	settle(sim_now);
+	press_digit(KEY_4, 4);				// "GHI4"
+	press_digit(KEY_3, 4);				// "DEF3"
+	press_digit(KEY_2, 4);				// "ABC2"
+	press_digit(KEY_1, 4);				// ".-@1"
+	return sim_now;
+};
+
+static sim_time
+scn_jump(){
+	sim_time start;
+	
+	press(KEY_Exit);					// ends the find mode
+	press(KEY_Exit);					// from the tracklist to the playlist screen
+	settle(sim_now);
+	start = sim_now;
+	press_digit(KEY_7, 3);				// "PQRS7"
+	return start;
+};
+
+static sim_time
+scn_back(){
+	sim_time start;
+	
+	press(KEY_Exit);					// ends the letter popup
+	settle(sim_now);
+	start = sim_now;
+	press(KEY_B);						// from the playlist screen to the tracklist
+	return start;
+};
+
+static sim_time
+scn_again(){
+	sim_time start = sim_now;
+	
+	press(KEY_Exit);					// from the tracklist to the playlist screen
+	run_until(sim_now + SIM_SEC);
+	press(KEY_B);						// and back
+	return start;
+};
+
+struct scenario {
+	char *name;
+	sim_time (*run)(void);
+};
+
+static struct scenario scenarios[] = {
+	{"boot", scn_boot},
+	{"queue", scn_queue},
+	{"scroll", scn_scroll},
+	{"search", scn_search},
+	{"find", scn_find},
+	{"jump", scn_jump},
+	{"back", scn_back},
+	{"again", scn_again}
+};
+
+#define NUM_SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+/* ----------------------------------- Main ----------------------------------------- */
+
+static void
+usage(char *name){
+	fprintf(stderr, "Usage: %s [options]\n", name);
+	fprintf(stderr, "  -r bps    radio bit rate (%d)\n", sim.radio_bps);
+	fprintf(stderr, "  -s bps    serial baud rate between scart adapter and mpdtool (%d)\n", sim.serial_bps);
+	fprintf(stderr, "  -l pct    radio packet loss in percent (%.0f)\n", sim.loss * 100);
+	fprintf(stderr, "  -c us     time for one round of the main loop of the scart adapter (%d)\n", sim.scart_loop_us);
+	fprintf(stderr, "  -m us     latency of MPD (%d)\n", sim.mpd_latency_us);
+	fprintf(stderr, "  -L us     time of MPD for each line of its answer (%d)\n", sim.mpd_line_us);
+	fprintf(stderr, "  -n num    songs in the queue (%d)\n", sim.tracks);
+	fprintf(stderr, "  -p num    stored playlists (%d)\n", sim.playlists);
+	fprintf(stderr, "  -t len    fill the song titles up to this length (%d)\n", sim.title_len);
+	fprintf(stderr, "  -S seed   for the random packet loss (%u)\n", sim.seed);
+	fprintf(stderr, "  -d file   write the display to this file (PGM) at the end\n");
+	fprintf(stderr, "  -f file   keep Betty's flash in this file, so the next run starts with its snapshot\n");
+	fprintf(stderr, "  -v        log the link, twice: also Betty's debug output\n");
+	exit(1);
+};
+
+int
+main(int argc, char *argv[]){
+	int opt;
+	unsigned int i;
+	char *lcd_file = NULL;
+	char *flash_file = NULL;
+	sim_time start, done;
+	
+	while ((opt = getopt(argc, argv, "r:s:l:c:m:L:n:p:t:S:d:f:v")) != -1){
+		switch (opt){
+			case 'r': sim.radio_bps = atoi(optarg); break;
+			case 's': sim.serial_bps = atoi(optarg); break;
+			case 'l': sim.loss = atof(optarg) / 100; break;
+			case 'c': sim.scart_loop_us = atoi(optarg); break;
+			case 'm': sim.mpd_latency_us = atoi(optarg); break;
+			case 'L': sim.mpd_line_us = atoi(optarg); break;
+			case 'n': sim.tracks = atoi(optarg); break;
+			case 'p': sim.playlists = atoi(optarg); break;
+			case 't': sim.title_len = atoi(optarg); break;
+			case 'S': sim.seed = strtoul(optarg, NULL, 0); break;
+			case 'd': lcd_file = optarg; break;
+			case 'f': flash_file = optarg; break;
+			case 'v': sim.verbose++; break;
+			default: usage(argv[0]);
+		};
+	};
+	if ((sim.radio_bps <= 0) || (sim.serial_bps <= 0))
+		usage(argv[0]);
+	fDebug = (sim.verbose > 1);
+	
+	printf("radio %d bps, loss %.1f %%, serial %d baud, scart loop %d us, MPD latency %d us + %d us/line, %d songs\n",
+			sim.radio_bps, sim.loss * 100, sim.serial_bps, sim.scart_loop_us, sim.mpd_latency_us, sim.mpd_line_us, sim.tracks);
+	
+	link_init();
+	mpdtool_init();
+	mpd_stub_init();
+	host_flash_init(flash_file);
+	
+	/* Same order as in main.c */
+	kernel_init();
+	lcd_init(0);
+	RF_init();
+	inactivity_cnt = 0;
+	key_init();
+	model_init();
+	mainscreen_init();
+	task_add(&controller);
+	next_tick = T0PERIOD;
+	
+	for (i=0; i<NUM_SCENARIOS; i++){
+		printf("%s:\n", scenarios[i].name);
+		start = (*scenarios[i].run)();
+		done = settle(start);
+		if (done)
+			printf("  time to screen %.0f ms\n", (done - start) / 1000.0);
+		else
+			printf("  did not settle within %llu s\n", SCENARIO_LIM / SIM_SEC);
+		link_stats();
+		mpdtool_stats();
+	};
+	
+	if (lcd_file)
+		lcd_dump(lcd_file);
+	return 0;
+};
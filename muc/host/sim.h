@@ -0,0 +1,71 @@
+/*
+    sim.h - discrete event simulation of the link Betty - scart adapter - mpdtool - MPD
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SIM_H
+#define SIM_H
+
+/* Simulated time in microseconds */
+typedef unsigned long long sim_time;
+
+#define SIM_MS	1000ULL
+#define SIM_SEC	1000000ULL
+
+extern sim_time sim_now;
+
+/* The parameters of the simulation (see usage() in sim.c) */
+struct sim_params {
+	int radio_bps;				// bit rate over radio
+	int serial_bps;				// baud rate between scart adapter and mpdtool
+	double loss;				// probability that a radio packet is lost
+	int scart_loop_us;			// time for one round of the main loop of the scart adapter
+	int mpd_latency_us;			// time until MPD starts to answer
+	int mpd_line_us;			// time that MPD needs for each line of its answer
+	int tracks;					// length of MPD's queue
+	int playlists;				// number of stored playlists
+	int title_len;				// the song titles are filled up to this length
+	unsigned int seed;			// for the random number generator
+	int verbose;				// 1 = log the link, 2 = also Betty's debug output
+};
+
+extern struct sim_params sim;
+
+/* An event handler gets a copy of the data given to sim_at() */
+typedef void (*sim_handler)(unsigned char *data, int len);
+
+/* Maximum length of the data of an event */
+#define SIM_DATA_LIM	64
+
+void sim_at(sim_time t, sim_handler h, unsigned char *data, int len);
+double sim_random(void);
+void sim_log(char *who, char *fmt, ...);
+
+/* sim_link.c: radio and scart adapter */
+void link_init(void);
+void link_serial_to_scart(unsigned char c);
+int link_serial_idle(void);
+void link_stats(void);
+
+/* sim_mpdtool.c: mpdtool */
+void mpdtool_init(void);
+void mpdtool_serial_in(unsigned char c);
+void mpdtool_stats(void);
+
+/* sim_mpd.c: MPD */
+void mpd_stub_init(void);
+char *mpd_stub_cmd(char *cmd);
+
+#endif
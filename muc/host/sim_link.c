@@ -0,0 +1,325 @@
+/*
+    sim_link.c - radio channel and scart adapter for the simulation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+	The radio channel is half duplex and shared by Betty and the scart adapter.
+	A packet occupies the channel for its airtime (payload plus preamble, sync word, length, address and CRC)
+	and the time to calibrate the synthesizer before sending. Each packet is lost with probability sim.loss.
+	
+	The scart adapter is modelled after the main loop of scart_image/main.c.
+	One round of the loop takes sim.scart_loop_us and does:
+	- check_etx(): sends ACK to mpdtool if there is room for MPDTOOL_PKTSIZE more bytes in the buffer
+	  and no answer waits there to be sent,
+	- check_radio_enq(): answers the probe of Betty,
+	- handle_tx(): copies one byte of a packet into the TX fifo, or starts sending the packet.
+	While the adapter forwards a packet from Betty to mpdtool, its loop waits for each byte on the serial line.
+	While it sends, it does not receive.
+	
+	Bytes on the serial line take 10 bit times each.
+*/
+
+#include <stdio.h>
+
+#include "sim.h"
+#include "host.h"
+
+#define ETX	0x03
+#define EOT	0x04
+#define ENQ 0x05
+#define ACK	0x06
+
+/* Preamble (4), sync word (4), length, address and CRC (2) */
+#define RADIO_OVERHEAD	12
+/* Calibration of the synthesizer before sending (SCAL) */
+#define RADIO_CAL_US	720
+
+/* Payload bytes in one packet of the scart adapter (MAX_TX_PAYLOAD in scart_image/cc1100.h) */
+#define SCART_PAYLOAD	60
+/* mpdtool sends so many bytes and then waits for ACK */
+#define MPDTOOL_PKTSIZE	16
+/* The serial input buffer of the scart adapter */
+#define SCART_BUFSIZE	(SCART_PAYLOAD + MPDTOOL_PKTSIZE + 2)
+
+/* ------------------------------- radio channel ------------------------------------ */
+
+static sim_time air_free;			// the channel is free from this time on
+
+static unsigned int pkts_up, bytes_up, pkts_down, bytes_down, pkts_lost, pkts_deaf;
+
+/* Sends a packet over the radio. The handler gets the packet when it is received.
+	Returns the time when sending has finished.
+*/
+static sim_time
+air_send(unsigned char *pkt, int len, sim_handler rcv){
+	sim_time start = (air_free > sim_now) ? air_free : sim_now;
+	
+	air_free = start + RADIO_CAL_US + (sim_time) (RADIO_OVERHEAD + len) * 8 * SIM_SEC / sim.radio_bps;
+	if (sim_random() < sim.loss)
+		pkts_lost++;
+	else
+		sim_at(air_free, rcv, pkt, len);
+	return air_free;
+};
+
+/* ------------------------------- serial line ------------------------------------ */
+
+static sim_time up_free;			// scart adapter -> mpdtool
+static sim_time down_free;			// mpdtool -> scart adapter
+
+static sim_time
+byte_time(){
+	return 10 * SIM_SEC / sim.serial_bps;
+};
+
+static void
+ev_mpdtool_byte(unsigned char *data, int len){
+	mpdtool_serial_in(data[0]);
+};
+
+/* The scart adapter sends a byte to mpdtool */
+static void
+serial_up(unsigned char c){
+	if (up_free < sim_now)
+		up_free = sim_now;
+	up_free += byte_time();
+	sim_at(up_free, ev_mpdtool_byte, &c, 1);
+};
+
+static void ev_scart_byte(unsigned char *data, int len);
+
+/* mpdtool sends a byte to the scart adapter */
+void
+link_serial_to_scart(unsigned char c){
+	if (down_free < sim_now)
+		down_free = sim_now;
+	down_free += byte_time();
+	sim_at(down_free, ev_scart_byte, &c, 1);
+};
+
+/* Returns TRUE iff mpdtool has no bytes on the way to the scart adapter */
+int
+link_serial_idle(){
+	return (down_free <= sim_now);
+};
+
+/* ------------------------------- scart adapter ------------------------------------ */
+
+static unsigned char buf[SCART_BUFSIZE];
+static int bufstart, bufnxt, bufcnt;
+static int got_etx, got_eot, got_radio_enq;
+
+#define TX_IDLE		0
+#define TX_COPY		1
+#define TX_SEND		2
+static int tx_state;
+static int tx_cnt;							// bytes still to copy into the fifo
+static unsigned char tx_pkt[SCART_PAYLOAD];
+static int tx_len;
+
+static sim_time radio_tx_start;				// the adapter sends from then
+static sim_time radio_tx_until;				// until then
+static sim_time busy_until;					// the main loop waits for the serial line until then
+static int loop_scheduled;
+
+static unsigned int acks_sent;
+static unsigned int eot_drops;				// bytes from mpdtool dropped because the last answer was not yet sent
+
+static void ev_scart_loop(unsigned char *data, int len);
+
+static void
+scart_kick(){
+	if (loop_scheduled)
+		return;
+	loop_scheduled = 1;
+	sim_at((busy_until > sim_now) ? busy_until : sim_now, ev_scart_loop, NULL, 0);
+};
+
+/* serial_isr() */
+static void
+ev_scart_byte(unsigned char *data, int len){
+	unsigned char x = data[0];
+	
+	if (x == ETX){
+		got_etx = 1;
+		scart_kick();
+		return;
+	};
+	if (got_eot){
+		eot_drops++;
+		return;
+	};
+	if (bufcnt >= SCART_BUFSIZE){
+		sim_log("scart", "buffer overrun");
+		bufnxt = (bufnxt + SCART_BUFSIZE - 1) % SCART_BUFSIZE;
+		bufcnt--;
+	};
+	buf[bufnxt] = x;
+	bufnxt = (bufnxt + 1) % SCART_BUFSIZE;
+	bufcnt++;
+	if (x == EOT)
+		got_eot = 1;
+	scart_kick();
+};
+
+static unsigned char
+buffer_out(){
+	unsigned char x = buf[bufstart];
+	
+	bufstart = (bufstart + 1) % SCART_BUFSIZE;
+	bufcnt--;
+	return x;
+};
+
+static void
+ev_betty_radio(unsigned char *data, int len){
+	if (! rf_host_deliver(data, len)){
+		sim_log("betty", "radio fifo overflow, packet lost");
+		pkts_lost++;
+	};
+};
+
+/* One round of the main loop */
+static void
+ev_scart_loop(unsigned char *data, int len){
+	static const char answer[] = "scart: V1.2\n\004";
+	int i, busy;
+	
+	loop_scheduled = 0;
+	if (busy_until > sim_now){
+		scart_kick();
+		return;
+	};
+	
+	/* check_etx() */
+	if (got_etx && ((SCART_BUFSIZE - bufcnt) > (MPDTOOL_PKTSIZE + 2)) && (! got_eot)){
+		got_etx = 0;
+		serial_up(ACK);
+		acks_sent++;
+	};
+	
+	/* check_radio_enq() */
+	if (got_radio_enq && (0 == bufcnt) && (! got_eot)){
+		got_radio_enq = 0;
+		for (i=0; answer[i]; i++){
+			buf[bufnxt] = answer[i];
+			bufnxt = (bufnxt + 1) % SCART_BUFSIZE;
+			bufcnt++;
+		};
+		got_eot = 1;
+	};
+	
+	/* handle_tx(), only while not sending */
+	if (sim_now >= radio_tx_until){
+		switch (tx_state){
+			case TX_IDLE:
+				if (got_eot && (bufcnt <= SCART_PAYLOAD)){
+					got_eot = 0;
+					tx_cnt = bufcnt;
+					tx_len = 0;
+					tx_state = TX_COPY;
+				} else if (bufcnt >= SCART_PAYLOAD){
+					tx_cnt = SCART_PAYLOAD;
+					tx_len = 0;
+					tx_state = TX_COPY;
+				};
+				break;
+				
+			case TX_COPY:
+				if (tx_cnt > 0){
+					tx_pkt[tx_len++] = buffer_out();
+					tx_cnt--;
+				} else
+					tx_state = TX_SEND;
+				break;
+				
+			case TX_SEND:
+				radio_tx_start = (air_free > sim_now) ? air_free : sim_now;
+				radio_tx_until = air_send(tx_pkt, tx_len, ev_betty_radio);
+				pkts_down++;
+				bytes_down += tx_len;
+				tx_state = TX_IDLE;
+				break;
+		};
+	};
+	
+	/* Is there more to do? */
+	busy = (tx_state != TX_IDLE) || got_eot || (bufcnt >= SCART_PAYLOAD) || got_etx || got_radio_enq;
+	if (busy){
+		loop_scheduled = 1;
+		if (radio_tx_until > sim_now + sim.scart_loop_us)
+			sim_at(radio_tx_until, ev_scart_loop, NULL, 0);
+		else
+			sim_at(sim_now + sim.scart_loop_us, ev_scart_loop, NULL, 0);
+	};
+};
+
+/* check_radio_input(): a packet from Betty */
+static void
+ev_scart_radio(unsigned char *data, int len){
+	int i;
+	
+	if ((sim_now > radio_tx_start) && (sim_now < radio_tx_until)){
+		pkts_deaf++;
+		return;
+	};
+	
+	/* The probe is answered by the adapter itself */
+	if ((2 == len) && (ENQ == data[0]) && (EOT == data[1])){
+		got_radio_enq = 1;
+		scart_kick();
+		return;
+	};
+	
+	for (i=0; i<len; i++)
+		serial_up(data[i]);
+	busy_until = up_free - byte_time();
+};
+
+/* ------------------------------- Betty's radio ------------------------------------ */
+
+void
+host_radio_send(char *pkt, int len){
+	int n;
+	
+	while (len > 0){
+		n = (len > SCART_PAYLOAD) ? SCART_PAYLOAD : len;
+		air_send((unsigned char *) pkt, n, ev_scart_radio);
+		pkts_up++;
+		bytes_up += n;
+		pkt += n;
+		len -= n;
+	};
+};
+
+void
+link_init(){
+	air_free = up_free = down_free = 0;
+	bufstart = bufnxt = bufcnt = 0;
+	got_etx = got_eot = got_radio_enq = 0;
+	tx_state = TX_IDLE;
+	radio_tx_start = radio_tx_until = busy_until = 0;
+	loop_scheduled = 0;
+};
+
+void
+link_stats(){
+	printf("  radio up:   %u packets, %u bytes\n", pkts_up, bytes_up);
+	printf("  radio down: %u packets, %u bytes\n", pkts_down, bytes_down);
+	printf("  radio lost: %u packets, %u missed while the adapter was sending\n", pkts_lost, pkts_deaf);
+	printf("  scart ACKs: %u, %u bytes dropped after EOT\n", acks_sent, eot_drops);
+	pkts_up = bytes_up = pkts_down = bytes_down = pkts_lost = pkts_deaf = acks_sent = eot_drops = 0;
+};
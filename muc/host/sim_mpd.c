@@ -0,0 +1,265 @@
+/*
+    sim_mpd.c - a stub MPD for the simulation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+	Answers the commands that mpdtool sends, with a generated music collection:
+	The queue holds sim.tracks songs. Song i is "Song i" by "Artist i/50" on "Album i/10".
+	There are sim.playlists stored playlists, their initials go from A to Z. Loading one gives a queue of 100 songs.
+	MPD is paused at the first song and refuses to play, so the display only changes because of the user.
+	
+	The answer is the complete text that MPD would send, including the final "OK" or "ACK".
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "sim.h"
+
+/* Songs in the queue after "load" */
+#define LOAD_TRACKS	100
+
+/* Longest command line */
+#define LINE_LIM	1024
+
+static int queue_len;
+static int version;
+static int song;
+static int volume;
+static int repeat, random_, single;
+static char *state;
+static int elapsed;
+
+static char *answer;
+static int answer_len, answer_lim;
+
+static void
+out(char *fmt, ...){
+	va_list ap;
+	int n;
+	
+	do {
+		va_start(ap, fmt);
+		n = vsnprintf(answer + answer_len, answer_lim - answer_len, fmt, ap);
+		va_end(ap);
+		if (answer_len + n < answer_lim)
+			break;
+		answer_lim = 2 * (answer_lim + n) + 1024;
+		answer = realloc(answer, answer_lim);
+	} while (1);
+	answer_len += n;
+};
+
+static void
+out_song(int i){
+	out("file: music/artist%03d/album%04d/%05d.mp3\n", i / 50, i / 10, i);
+	out("Last-Modified: 2010-05-01T12:00:00Z\n");
+	out("Time: 200\n");
+	out("Artist: Artist %d\n", i / 50);
+	out("Title: Song %d%.*s\n", i, (sim.title_len > 10) ? sim.title_len - 10 : 0,
+		" (Live at the Royal Albert Hall, Remastered Deluxe Edition with Bonus Tracks and Alternate Takes)");
+	out("Album: Album %d\n", i / 10);
+	out("Pos: %d\n", i);
+	out("Id: %d\n", i);
+};
+
+static void
+out_status(){
+	out("volume: %d\nrepeat: %d\nrandom: %d\nsingle: %d\nconsume: 0\n", volume, repeat, random_, single);
+	out("playlist: %d\nplaylistlength: %d\nxfade: 0\nstate: %s\n", version, queue_len, state);
+	if (queue_len > 0){
+		out("song: %d\nsongid: %d\n", song, song);
+		if (song + 1 < queue_len)
+			out("nextsong: %d\nnextsongid: %d\n", song + 1, song + 1);
+		out("time: %d:200\nbitrate: 192\naudio: 44100:16:2\n", elapsed);
+	};
+};
+
+/* Returns TRUE iff song i matches the search (type and what as in "search artist "what"") */
+static int
+song_matches(int i, char *type, char *what){
+	char field[40];
+	
+	if (0 == strcmp(type, "any"))
+		return song_matches(i, "artist", what) || song_matches(i, "album", what) || song_matches(i, "title", what);
+	if (0 == strcmp(type, "artist"))
+		sprintf(field, "Artist %d", i / 50);
+	else if (0 == strcmp(type, "album"))
+		sprintf(field, "Album %d", i / 10);
+	else
+		sprintf(field, "Song %d", i);
+	return (NULL != strcasestr(field, what));
+};
+
+/* Splits 'search type "what"' into type and what */
+static void
+search_args(char *arg, char *type, char *what){
+	char *q;
+	
+	sscanf(arg, "%19s", type);
+	what[0] = 0;
+	q = strchr(arg, '"');
+	if (q){
+		strncpy(what, q + 1, 99);
+		what[99] = 0;
+		if ((q = strchr(what, '"')))
+			*q = 0;
+	};
+};
+
+/* Executes one command (without the newline). Returns 0 if MPD answers with ACK. */
+static int
+exec(char *line){
+	char name[40], type[20], what[100];
+	char *arg;
+	int i, a = 0, b = 0;
+	
+	name[0] = 0;
+	sscanf(line, "%39s", name);
+	arg = line + strlen(name);
+	while (*arg == ' ')
+		arg++;
+	sscanf(arg, "%d %d", &a, &b);
+	
+	if ((0 == strcmp(name, "ping")) || (0 == name[0]))
+		;
+	else if (0 == strcmp(name, "status"))
+		out_status();
+	else if (0 == strcmp(name, "currentsong")){
+		if (queue_len > 0)
+			out_song(song);
+	} else if ( (0 == strcmp(name, "playlistinfo")) && (*arg == 0) ){
+		for (i=0; i<queue_len; i++)
+			out_song(i);
+	} else if (0 == strcmp(name, "playlistinfo")){
+		if ((a < 0) || (a >= queue_len)){
+			out("ACK [50@0] {playlistinfo} Bad song index\n");
+			return 0;
+		};
+		out_song(a);
+	} else if (0 == strcmp(name, "plchangesposid")){
+		if (a != version)
+			for (i=0; i<queue_len; i++)
+				out("cpos: %d\nId: %d\n", i, i);
+	} else if ((0 == strcmp(name, "listplaylists")) || (0 == strcmp(name, "lsinfo"))){
+		for (i=0; i<sim.playlists; i++)
+			out("playlist: %c Playlist %d\nLast-Modified: 2010-05-01T12:00:00Z\n", 'A' + i * 26 / sim.playlists, i);
+	} else if ( (0 == strcmp(name, "play")) || ((0 == strcmp(name, "pause")) && (0 == a)) ){
+		/* We do not play. Else Betty counts the seconds on the display and it never settles. */
+		out("ACK [50@0] {%s} no audio output\n", name);
+		return 0;
+	} else if (0 == strcmp(name, "pause"))
+		state = "pause";
+	else if (0 == strcmp(name, "stop"))
+		state = "stop";
+	else if (0 == strcmp(name, "next")){
+		if (song + 1 < queue_len)
+			song++;
+	} else if (0 == strcmp(name, "previous")){
+		if (song > 0)
+			song--;
+	} else if (0 == strcmp(name, "seek")){
+		song = a;
+		elapsed = b;
+	} else if (0 == strcmp(name, "setvol"))
+		volume = a;
+	else if (0 == strcmp(name, "random"))
+		random_ = a;
+	else if (0 == strcmp(name, "repeat"))
+		repeat = a;
+	else if (0 == strcmp(name, "single"))
+		single = a;
+	else if (0 == strcmp(name, "clear")){
+		queue_len = 0;
+		song = 0;
+		version++;
+	} else if (0 == strcmp(name, "load")){
+		queue_len += LOAD_TRACKS;
+		version++;
+	} else if (0 == strcmp(name, "search")){
+		search_args(arg, type, what);
+		for (i=0; i<sim.tracks; i++)
+			if (song_matches(i, type, what))
+				out_song(i);
+	} else if (0 == strcmp(name, "playlistsearch")){
+		search_args(arg, type, what);
+		for (i=0; i<queue_len; i++)
+			if (song_matches(i, type, what))
+				out_song(i);
+	} else if (0 == strcmp(name, "findadd")){
+		search_args(arg, type, what);
+		for (i=0; i<sim.tracks; i++)
+			if (song_matches(i, type, what))
+				queue_len++;
+		version++;
+	} else {
+		out("ACK [5@0] {%s} unknown command \"%s\"\n", name, name);
+		return 0;
+	};
+	return 1;
+};
+
+/* Returns the answer of MPD to the given command (or command list) */
+char *
+mpd_stub_cmd(char *cmd){
+	char line[LINE_LIM];
+	char *s = cmd, *nl;
+	int list = 0, list_ok = 0, n;
+	
+	answer_len = 0;
+	out("");
+	
+	while (*s){
+		nl = strchr(s, '\n');
+		n = nl ? (nl - s) : (int) strlen(s);
+		if (n >= LINE_LIM)
+			n = LINE_LIM - 1;
+		memcpy(line, s, n);
+		line[n] = 0;
+		s += nl ? (nl - s) + 1 : n;
+		
+		if (0 == strcmp(line, "command_list_begin"))
+			list = 1;
+		else if (0 == strcmp(line, "command_list_ok_begin"))
+			list = list_ok = 1;
+		else if (0 == strcmp(line, "command_list_end"))
+			break;
+		else {
+			if (! exec(line))
+				return answer;
+			if (list_ok)
+				out("list_OK\n");
+			if (! list)
+				break;
+		};
+	};
+	out("OK\n");
+	return answer;
+};
+
+void
+mpd_stub_init(){
+	queue_len = sim.tracks;
+	version = 1;
+	song = 0;
+	volume = 50;
+	repeat = random_ = single = 0;
+	state = "pause";
+	elapsed = 30;
+};
@@ -0,0 +1,251 @@
+/*
+    sim_mpdtool.c - mpdtool for the simulation
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+	We compile the real mpdtool.c here, so that the simulation uses its command translation,
+	its filters and its buffers. Only the main loop and the file descriptors are replaced:
+	- Bytes from the serial line come from the scart adapter model by mpdtool_serial_in().
+	- MPD is the stub in sim_mpd.c. It answers after sim.mpd_latency_us, then one line every sim.mpd_line_us.
+	- The answer goes to the scart adapter in pieces of MAX_TX bytes, each followed by ETX.
+		A piece also ends with the EOT of the answer.
+		The next piece is only sent after the scart adapter has answered with ACK.
+		Like send_to_serial() we do not wait for the end of MPD's answer to send the first bytes.
+	- An untagged command cancels the current answer, tagged commands are queued.
+	- A search is answered with SUPERSEDED_ACK as soon as a newer search is queued (see search_superseded()).
+	
+	The names that mpdtool.c shares with Betty's firmware are renamed.
+*/
+
+#define main		mpdtool_main
+#define min			mpdtool_min
+#define max			mpdtool_max
+#define strlcpy		mpdtool_strlcpy
+
+#include "../../mpdtool/mpdtool.c"
+
+#undef main
+#undef min
+#undef max
+#undef strlcpy
+
+#include "sim.h"
+
+/* mpdtool talks to MPD over this socket. Here it is never read or written. */
+#define SIM_MPD_SOCKET	1000
+
+#define MT_IDLE			0		// waiting for a command
+#define MT_WAIT_MPD		1		// waiting for the answer of MPD
+#define MT_SENDING		2		// sending the answer to the scart adapter
+static int state;
+
+/* Counts the commands, so that we know if an answer of MPD belongs to a cancelled command */
+static unsigned char cmd_gen;
+
+static char mpd_input_buf[BUFFER_SIZE+1];
+static char *mpd_answer;			// the rest of MPD's answer
+
+/* Bytes sent since the last ETX */
+static int tx_cnt;
+
+static unsigned int num_cmds, num_cancelled;
+
+static void next_command(void);
+
+/* Like send_to_serial() */
+static void
+pump(){
+	int n, eot = 0;
+	
+	if ((state == MT_IDLE) || wait_ack)
+		return;
+	
+	n = mpdtool_min(ser_out_wrt_idx - ser_out_rd_idx, MAX_TX - tx_cnt);
+	while ((n-- > 0) && !eot){
+		eot = (ser_out_buf[ser_out_rd_idx] == EOT);
+		link_serial_to_scart(ser_out_buf[ser_out_rd_idx++]);
+		tx_cnt++;
+	};
+	if ((tx_cnt >= MAX_TX) || eot){
+		link_serial_to_scart(ETX);
+		wait_ack = 1;
+		tx_cnt = 0;
+	};
+	
+	if (ser_out_rd_idx >= ser_out_wrt_idx){
+		reset_ser_out();
+		if (state == MT_SENDING){
+			state = MT_IDLE;
+			next_command();
+		};
+	};
+};
+
+/* The answer is complete, the rest goes to the scart adapter */
+static void
+answer_done(){
+	reset_mpd_buf();
+	state = MT_SENDING;
+	pump();
+};
+
+/* MPD answers. We give each line to translate_to_serial() like the main loop of mpdtool. 
+	With sim.mpd_line_us == 0 the whole answer comes at once.
+*/
+static void
+ev_mpd_answer(unsigned char *data, int len){
+	char *s = mpd_answer;
+	int n;
+	
+	if ((state != MT_WAIT_MPD) || (data[0] != cmd_gen))
+		return;
+	
+	while (*s){
+		for (n=0; s[n] && (s[n] != '\n'); n++)
+			;
+		if (s[n] == '\n')
+			n++;
+		mpd_resp_len = mpdtool_min(n, BUFFER_SIZE - 2);
+		memcpy(mpd_resp_buf, s, mpd_resp_len);
+		mpd_resp_buf[mpd_resp_len] = 0;
+		s += n;
+		
+		if (sim.verbose > 1)
+			sim_log("MPD", "%s", mpd_resp_buf);
+		if (translate_to_serial()){
+			ser_out_char(EOT);
+			answer_done();
+			return;
+		};
+		if (sim.mpd_line_us > 0){
+			mpd_answer = s;
+			reset_mpd_buf();
+			pump();
+			sim_at(sim_now + sim.mpd_line_us, ev_mpd_answer, &cmd_gen, 1);
+			return;
+		};
+	};
+	answer_done();
+};
+
+/* Like the main loop of mpdtool: the answer ends with SUPERSEDED_ACK, the rest of MPD's answer is dropped */
+static void
+search_cancel(){
+	num_cancelled++;
+	if (sim.verbose)
+		sim_log("mpdtool", "search superseded");
+	mpd_socket = -1;
+	serial_output(SUPERSEDED_ACK);
+	ser_out_char(EOT);
+	answer_done();
+};
+
+/* Takes the next command, translates it and gives it to MPD */
+static void
+next_command(){
+	char tag_line[TAG_LINE_LEN];
+	
+	if (state != MT_IDLE)
+		return;
+	
+	if (cmd_complete)
+		copy_serial_in(mpd_input_buf);
+	else if (cmd_queue_cnt > 0)
+		unqueue_cmd(mpd_input_buf);
+	else
+		return;
+	
+	num_cmds++;
+	split_tag(mpd_input_buf, tag_line);
+	reset_ser_out();
+	serial_output(tag_line);
+	if (search_superseded(mpd_input_buf)){
+		search_cancel();
+		return;
+	};
+	
+	translate_to_mpd(mpd_input_buf);
+	if (sim.verbose)
+		sim_log("mpdtool", "%s %s", tag_line, mpd_input_buf);
+	
+	mpd_socket = SIM_MPD_SOCKET;
+	mpd_answer = mpd_stub_cmd(mpd_input_buf);
+	state = MT_WAIT_MPD;
+	cmd_gen++;
+	sim_at(sim_now + sim.mpd_latency_us, ev_mpd_answer, &cmd_gen, 1);
+};
+
+/* Like read_from_serial() */
+void
+mpdtool_serial_in(unsigned char c){
+	switch (c){
+		case EOT:
+			ser_in_buf[ser_in_len] = '\0';
+			if ('#' == ser_in_buf[0]){
+				queue_serial_in();
+				if ((state == MT_WAIT_MPD) && search_superseded(mpd_input_buf)){
+					cmd_gen++;					// the rest of MPD's answer is not read any more
+					search_cancel();
+					return;
+				};
+			} else {
+				cmd_complete = 1;
+				if (state != MT_IDLE){
+					/* Betty has given up waiting */
+					num_cancelled++;
+					mpd_socket = -1;
+					reset_ser_out();
+					state = MT_IDLE;
+				};
+			};
+			next_command();
+			return;
+			
+		case CAN:
+			reset_ser_in();
+			return;
+			
+		case ACK:
+			wait_ack = 0;
+			pump();
+			return;
+		
+		default:
+			ser_in_buf[ser_in_len] = c;
+			if (ser_in_len < BUFFER_SIZE - 1) 
+				ser_in_len++;
+	};
+};
+
+void
+mpdtool_init(){
+	mpd_cmd_avail = LISTPLAYLISTS_CMD | FINDADD_CMD;
+	mpd_socket = -1;
+	reset_ser_in();
+	reset_ser_out();
+	reset_mpd_buf();
+	wait_ack = 0;
+	tx_cnt = 0;
+	cmd_queue_first = 0;
+	cmd_queue_cnt = 0;
+	state = MT_IDLE;
+};
+
+void
+mpdtool_stats(){
+	printf("  mpdtool:    %u commands, %u cancelled\n", num_cmds, num_cancelled);
+	num_cmds = num_cancelled = 0;
+};
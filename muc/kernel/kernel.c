@@ -83,6 +83,24 @@ void  defaultIRQ(void){
 /* Returns <> 0 iff the given signal is set */
 #define signal_is_set(sigid) ( signals & (1<<(sigid)) )
 
+/* Bit in PCON, stops the CPU clock until the next interrupt. The peripherals keep running. */
+#define PCON_IDL	(1<<0)
+
+/* Stops the CPU until the next interrupt, if no event is waiting to be handled.
+	Every interrupt wakes the CPU again, even while interrupts are locked here. 
+	So an IRQ that sets a signal after our check can not be lost.
+	The timer interrupt wakes us at least once per tick.
+*/
+void
+kernel_idle(){
+	ARM_INT_KEY_TYPE int_lock_key;
+	
+	ARM_INT_LOCK(int_lock_key);
+	if (0 == signals)
+		PCON = PCON_IDL;
+	ARM_INT_UNLOCK(int_lock_key);	
+};
+
 
 /* Short delay routine. Uses at least 1 "nop" per given n. 
 	We run at 30 MHz or 60 MHz, so I guess n/30 or n/60 gives us the minimum number of microsecondes
@@ -95,6 +95,7 @@ void task_del(task_id id);
 
 //void check_events();
 void schedule();
+void kernel_idle();
 
 //extern int check_rx();
 //extern void process_rx();
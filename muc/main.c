@@ -71,6 +71,25 @@ void setSpeed(unsigned char sp)
 	ARM_INT_UNLOCK(int_lock_key);
 }
 
+/* Called after each round of the scheduler.
+	While the user does not touch the remote, the radio only listens from time to time (wake on radio),
+	as long as we do not wait for an answer from MPD.
+	And the CPU sleeps until the next interrupt if there is nothing to do.
+	A key press wakes the radio within the next round of the scheduler.
+*/
+static void
+power_save(){
+	if (! user_inactive()){
+		rf_wake();
+		return;
+	};
+	
+	if (mpd_link_idle())
+		rf_sleep();
+	if (rx_buf_empty())
+		kernel_idle();
+};
+
 
 int 
 main(void){
@@ -104,7 +123,7 @@ main(void){
 	enableIRQ();
 	
 	/* Enable radio communication */
-	RF_init();								// Task 1 == produce_send_token)
+	RF_init();								// Task 1 == airtime_refill)
 
 	/* Initialize backlight task */
 	inactivity_cnt = 0;		// consider power on to be a user activity
@@ -133,6 +152,7 @@ main(void){
 	/* Start the kernel scheduler */
 	while(1){
 		schedule();
+		power_save();
 	};
 
 	return 0;
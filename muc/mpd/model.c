@@ -11,7 +11,8 @@
 	We need to indicate that we do not know some things in here.
 	For volume, song and song_id we use -1 to indicate UNKNOWN.
 	The state has its own UNKNOWN value.
-	cur_artist ard cur_title are NULL if UNKNOWN.
+	artist and title are NO_STR if UNKNOWN. The strings themselves live in the string pool (see global.h),
+	so the models are small. user_model never holds strings.
 	
 	We make sure that the information here is consistent, i.e. if for example songid is set,
 	the variables pos, time_total etc. reflect the information about that particular song and not
@@ -23,6 +24,11 @@
 	We reflect the necessary changes in the user_model variable.
 	We return very quickly from theses routines, because they are called from the GUI-Handlers.
 	Later we generate the necessary commands to communicate our wishes to MPD (see model_needs_action() ) 
+
+	The user should not have to wait for the radio round trip to see the effect of a key.
+	So for volume, playing state, random, repeat and single the mpd_get_xxx() functions return 
+	the wish of the user, as long as MPD has not confirmed or rejected it (see model_pending()).
+	If MPD answers with ACK, the wish is dropped and the view shows the state of MPD again.
 */
 
 
@@ -34,6 +40,7 @@
 #include "mpd.h"
 #include "screen.h"
 #include "model.h"
+#include "bfs.h"
 
 /* The currently known state of MPD. */
 static struct MODEL mpd_model;
@@ -43,13 +50,19 @@ static struct MODEL user_model;
 
 // Forward declarations
 static void mpd_set_state(enum PLAYSTATE newstate);
-static void mpd_set_title(char *s);
-static void mpd_set_artist(char *s);
+static void mpd_set_title(STR_REF r);
+static void mpd_set_artist(STR_REF r);
 static void mpd_set_pos(int newpos);
 static void user_song_unknown();
 static char *mpd_result_string(int pos);
 static int need_status();
+static int status_sync_due();
 static int need_cursong();
+static int need_nextsong();
+static int need_plchanges();
+static int need_jumpindex(int list);
+static void model_save();
+static int mpd_next_song_starts();
 
 /* ===================== Info about changes ====================================== */
 
@@ -71,6 +84,53 @@ model_reset_changed(){
 	model_changed_flags = 0;
 };
 
+/* ===================== Pending wishes ====================================== */
+
+static unsigned int wish_time;				// system time when the user last made a wish that is shown at once
+static int8_t pending_late;					// 1 if we told the view that MPD is late with its answer
+
+/* The user made a wish that the view shows before MPD has confirmed it */
+static void
+user_wish_made(uint32 change){
+	wish_time = system_time();
+	model_changed(change | PENDING_CHANGED);
+};
+
+/* Returns the X_CHANGED flags of all items where the view shows a wish that MPD has not yet confirmed */
+int
+model_pending(){
+	int pending = 0;
+	
+	if (user_model.volume != -1)
+		pending |= VOLUME_CHANGED;
+	if (user_model.state > UNKNOWN)
+		pending |= STATE_CHANGED;
+	if (user_model.random != -1)
+		pending |= RANDOM_CHANGED;
+	if (user_model.repeat != -1)
+		pending |= REPEAT_CHANGED;
+	if (user_model.single != -1)
+		pending |= SINGLE_CHANGED;
+	return pending;
+};
+
+/* Returns 1 if some wish waits for MPD longer than PENDING_TIMEOUT */
+int
+model_pending_late(){
+	return ( model_pending() && ((system_time() - wish_time) > PENDING_TIMEOUT) );
+};
+
+/* Called once per second. Tell the view when a pending wish becomes late. */
+static void
+check_pending(){
+	int late = model_pending_late();
+	
+	if (late != pending_late){
+		pending_late = late;
+		model_changed(PENDING_CHANGED);
+	};
+};
+
 
 /* ================ Playlist variables, keeping info about all known playlists ========================= */
 static STR_CACHE playlists;
@@ -83,9 +143,62 @@ static STR_CACHE playlists;
 */
 static STR_CACHE tracklist;
 
+/* Other clients can change the current playlist. MPD increments the playlist version with every change.
+	tracklist_version is the version that our tracklist cache reflects (-1 if unknown).
+	If MPD reports a newer version, we ask mpdtool which positions in our cache have changed
+	since then ("plchanged"). Only those entries are fetched again.
+*/
+static int tracklist_version;
+static int8_t plchanges_asked;				// 1 while a "plchanged" request is on its way
+static int plchanges_version;				// the playlist version that request brings our cache to
+
+/* Finding a song in the tracklist (see user_tracklist_find()) */
+static char *find_string;		// <> NULL iff we have to ask mpdtool, then it is find_text
+static char find_text[32];		// our copy of the string, the tracklist screen takes 24 characters
+static int find_from;			// mpdtool looks from here on, then from the start of the playlist
+static uint8_t find_gen;		// counts the wishes, so that we ignore the answer to an older one
+static int found_pos;			// the song we have found, -1 if none
+
+/* 1 while the playlist names come from the snapshot in flash (see model_restore()) and MPD has not confirmed them */
+static int8_t playlists_stale;
+
+/* Where each initial starts in the queue and in the playlists (see mpd_jump_pos()) */
+struct JUMP_INDEX {
+	int version;				// the tracklist version or number of playlists it was made for, -1 if none
+	int8_t asked;				// 1 while a "jumpindex" request is on its way
+	int pos[JUMP_GROUPS];		// the first position of each group, -1 if there is none
+};
+static struct JUMP_INDEX jump_index[2];
+
 /* ================ This cache holds results from searches ========================= */
 static STR_CACHE resultlist;
 
+/* The user searches while typing, so a search is often overtaken by the next one.
+	Each search gets a new generation, the answers to older ones are ignored.
+*/
+static uint8_t search_gen;		// generation of the last search that we have sent
+static int search_streamed;		// names that came with the answer to this search, -1 before its first line
+static char *search_text;		// the input of the user for this search, to send it again if it got lost
+
+/* ================ The song that MPD will play next ========================= 
+	MPD tells us in its status which song it plays next ("nextsong: ").
+	We fetch artist and title of that song in the background.
+	When the current song ends (see mpd_inc_time()), we show the next song at once
+	and confirm the change later with a status command.
+*/
+static struct {
+	int pos;					// position of the song in the playlist, SONG_UNKNOWN if none
+	int8_t valid;				// 1 iff artist and title below are known
+	STR_REF artist;
+	STR_REF title;
+} next_song;
+
+/* We give MPD some time after a predicted song change, before we ask for its status */
+#define PREDICT_SETTLE_TIME	(15 * TICKS_PER_TENTH_SEC)
+
+/* system time when we last predicted a song change */
+static unsigned int predicted_change;
+
 
 
 
@@ -137,7 +250,7 @@ model_needs_action(UserReq *req){
 					return PLAY_CMD;
 				} else
 					if (mpd_model.playlistlength == 0){
-						model_changed(PLAYLIST_EMPTY);
+						model_changed(PLAYLIST_EMPTY | STATE_CHANGED | PENDING_CHANGED);
 						user_model.state = -1;
 					};
 				break;
@@ -194,6 +307,14 @@ model_needs_action(UserReq *req){
 	if  (need_cursong())
 		return CUR_SONG_CMD;
 	
+	/* Get the next song in advance, so that we can show it as soon as the current song ends */
+	if (need_nextsong()) {
+		req->arg = mpd_model.nextpos;
+		next_song.pos = mpd_model.nextpos;
+		next_song.valid = 0;
+		return NEXTSONG_CMD;
+	};
+	
 	// Seeking only makes sense if we have a current song
 	if ( (user_model.time_elapsed > mpd_model.time_elapsed ) && (mpd_model.pos >= 0) ) {
 			req->arg = mpd_model.pos;
@@ -209,38 +330,82 @@ model_needs_action(UserReq *req){
 	};
 	
 
-	pos = cache_find_unknown(&tracklist);
-	if ( (pos >= 0) && (pos < mpd_model.playlistlength) ) {
-		req->arg = pos;
-		return PLINFO_CMD;
+	/* The user waits for this on the tracklist screen */
+	if (find_string != NULL){
+		req->arg = find_from;
+		req->arg2 = find_gen;
+		req->str = find_string;
+		return PLFIND_CMD;
 	};
-	
 
-	/* Something to search ? Due to popular request we do not search for the empty string */
+	/* The user waits for this on the search screen. Due to popular request we do not search for the empty string.
+		The wish is fulfilled when we send it, a later change of the input is a new search.
+	*/
 	if ( (user_model.search_string != NULL) && (*user_model.search_string != '\0') ){
 		req->str = mpd_get_search_string();
+		req->arg2 = ++search_gen;
+		search_streamed = -1;
+		search_text = user_model.search_string;
+		user_model.search_string = NULL;
 		return SEARCH_CMD;
 	};
+
+	/* First find out which entries of our tracklist cache are outdated */
+	if (need_plchanges()){
+		req->arg = tracklist_version;
+		req->arg2 = tracklist.first_pos;
+		req->arg3 = CACHE_LIM;				// mpdtool reports only the changes within our cache
+		plchanges_asked = 1;
+		plchanges_version = mpd_model.plversion;
+		return PLCHANGES_CMD;
+	};
+
+	/* The tracklist, playlist and result entries are fetched by several requests at once.
+		So we mark each entry as requested, the next call will give us the next unknown entry.
+	*/
+	pos = cache_find_unknown(&tracklist, mpd_model.playlistlength);
+	if (pos >= 0) {
+		req->arg = pos;
+		cache_requested(&tracklist, pos);
+		return PLINFO_CMD;
+	};
+	
+	/* The playlist names from the snapshot are shown already. Now check them with MPD. */
+	if (playlists_stale)
+		return PLAYLISTCOUNT_CMD;
+	
 	/* TODO the available playlists may change by an outside action (another client created/deleted one etc.)
 			So we should regularily (every 5 minutes or so) reread this information
 	*/ 
 
 	/* Find the first unknown playlist name */
-	pos = cache_find_unknown(&playlists);
-	if ( (pos >= 0) && (pos < mpd_model.num_playlists) ) {
+	pos = cache_find_unknown(&playlists, mpd_model.num_playlists);
+	if (pos >= 0) {
 		req->arg = pos;
+		cache_requested(&playlists, pos);
 		return PLAYLISTNAME_CMD;
 	};
 
 	/* Find the first unknown result */
 	if (mpd_model.num_results > 0){
-		pos = cache_find_unknown(&resultlist);
-		if ( (pos >= 0) && (pos < mpd_model.num_results) ) {
+		pos = cache_find_unknown(&resultlist, mpd_model.num_results);
+		if (pos >= 0) {
 			req->arg = pos;
+			req->arg2 = search_gen;
+			cache_requested(&resultlist, pos);
 			return RESULT_CMD;
 		};
 	};
 
+	/* The jump index is nice to have, so we ask for it last */
+	for (pos = JUMP_QUEUE; pos <= JUMP_PLAYLISTS; pos++)
+		if (need_jumpindex(pos)){
+			req->arg = pos;
+			req->arg2 = jump_index[pos].version = (pos == JUMP_QUEUE) ? mpd_model.plversion : mpd_model.num_playlists;
+			jump_index[pos].asked = 1;
+			return JUMPINDEX_CMD;
+		};
+
 	/* Maybe the user wants some script to be executed */
 	if (user_model.script != -1){
 		req->arg = user_model.script;
@@ -248,12 +413,48 @@ model_needs_action(UserReq *req){
 	};
 
 	/* Regular Synchronization */
-	if ( (system_time() - mpd_model.last_status) > STATUS_SYNC_TIME * TICKS_PER_SEC )
+	if ( status_sync_due() )
 		return STATUS_CMD; 
 	
 	return NO_CMD;
 };
 
+/* Some wishes of the user are independent of each other and of everything else.
+	The controller sends them to MPD together in one command list.
+	We store all of them in req[] (at most max) and return their number.
+	A status command is added at the end if we need one anyway.
+	NOTE The commands must have the CMD_BATCH flag in mpd.c
+*/
+int
+model_batch_actions(UserReq *req, int max){
+	int n = 0;
+
+	if ( (n < max) && (user_model.volume != -1) && (user_model.volume != mpd_model.volume) ){
+		req[n].cmd = VOLUME_NEW;
+		req[n++].arg = user_model.volume;
+	};
+	
+	if ( (n < max) && (user_model.random != -1) && (mpd_model.random != user_model.random) ){
+		req[n].cmd = RANDOM_CMD;
+		req[n++].arg = user_model.random;
+	};
+
+	if ( (n < max) && (user_model.repeat != -1) && (mpd_model.repeat != user_model.repeat) ){
+		req[n].cmd = REPEAT_CMD;
+		req[n++].arg = user_model.repeat;
+	};
+	
+	if ( (n < max) && (user_model.single != -1) && (mpd_model.single != user_model.single) ){
+		req[n].cmd = SINGLE_CMD;
+		req[n++].arg = user_model.single;
+	};
+	
+	if ( (n < max) && (need_status() || status_sync_due()) )
+		req[n++].cmd = STATUS_CMD;
+	
+	return n;
+};
+
 /* This function returns TRUE (<> 0) iff the model needs some interaction with mpd,
 	i.e. some commands have to be sent to mpd and the response has to be interpreted.
 	In effect, this routine checks if user model and mpd model disagree.
@@ -267,6 +468,52 @@ action_needed(UserReq *request){
 	return (request->cmd != NO_CMD);
 }
 
+/* A request has been finished.
+	Entries that we marked as requested, but which are still unknown 
+	(no answer at all or the answer did not contain them) have to be asked for again.
+*/
+void
+model_request_lost(UserReq *request){
+	switch (request->cmd){
+		case PLINFO_CMD:
+			cache_lost(&tracklist, request->arg);
+			break;
+			
+		case PLAYLISTNAME_CMD:
+			cache_lost(&playlists, request->arg);
+			break;
+			
+		case RESULT_CMD:
+			cache_lost(&resultlist, request->arg);
+			break;
+			
+		case SEARCH_CMD:
+			/* Not a single line came back. We search again, unless the user has typed on. */
+			if ( (request->arg2 == search_gen) && (search_streamed < 0) && (NULL == user_model.search_string) )
+				user_model.search_string = search_text;
+			break;
+			
+		case NEXTSONG_CMD:
+			if (! next_song.valid)
+				next_song.pos = SONG_UNKNOWN;
+			break;
+			
+		case PLCHANGES_CMD:
+			plchanges_asked = 0;		// if there was no answer, we ask again
+			break;
+			
+		case JUMPINDEX_CMD:
+			if (jump_index[request->arg].asked){
+				jump_index[request->arg].asked = 0;
+				jump_index[request->arg].version = -1;
+			};
+			break;
+			
+		default:
+			break;
+	};
+};
+
 /* ------------------------------------ Scripts --------------------------------------- */
 void
 user_wants_script(int script_no){
@@ -306,7 +553,7 @@ track_info(int track_pos){
 */
 static void
 model_store_track(char *title, char *artist, char *name, int track_pos){
-	char tmp[64];
+	char tmp[CACHE_ENTRY_SIZE];
 	
 	if (name != NULL){
 		cache_store(&tracklist, track_pos, name);
@@ -319,10 +566,16 @@ model_store_track(char *title, char *artist, char *name, int track_pos){
 	model_changed(TRACKLIST_CHANGED);
 };
 
+/* Returns the string r or "" if there is none */
+static char *
+pool_text(STR_REF r){
+	return (NO_STR == r) ? "" : pool_str(r);
+};
+
 void
 mpd_playlistinfo_ok(struct MODEL *a){
 	if (a->pos == a->request.arg)
-		model_store_track(a->title_buf, a->artist_buf, a->name, a->pos);
+		model_store_track(pool_text(a->title), pool_text(a->artist), pool_str(a->name), a->pos);
 }
 
 /*
@@ -341,14 +594,11 @@ mpd_playlistinfo_ack(struct MODEL *a){
 	Here we store that information and give it to the tracklist cache
 */
 static void
-mpd_set_name(char *name){
-	if (NULL == name){
-		mpd_model.name_buf[0]='\0';
-		mpd_model.name = NULL;
-	} else {
-		strlcpy(mpd_model.name_buf, name, sizeof(mpd_model.name_buf));
-		mpd_model.name = mpd_model.name_buf;
-		cache_store(&tracklist, mpd_model.pos, name);
+mpd_set_name(STR_REF name){
+	pool_put(mpd_model.name);
+	mpd_model.name = pool_ref(name);
+	if (NO_STR != name){
+		cache_store(&tracklist, mpd_model.pos, pool_str(name));
 		model_changed(TRACKLIST_CHANGED);
 	};
 };
@@ -392,6 +642,7 @@ set_playlistlength(int n){
 	mpd_model.playlistlength = n;	
 	cache_set_limit(&tracklist, n);				// new limit for the cache
 	model_changed(PL_LENGTH_CHANGED);
+	next_song.pos = SONG_UNKNOWN;				// the song at that position may be another one now
 	
 	
 	//	tracklist_range_set(0, CACHE_MAX);	
@@ -401,10 +652,60 @@ set_playlistlength(int n){
 
 	/* NOTE We do NOT set TRACKLIST_CHANGED flag here, because only our information about the
 		total number of tracks has changed, but not the tracks itself.
-		The tracks itself can currently only be changed after a LOAD, CLEAR or FINDADD command.
+		The tracks itself are changed after a LOAD, CLEAR or FINDADD command 
+		or by other clients (see mpd_set_plversion()).
 	*/
 };
 
+/* MPD told us the version of the current playlist in a status answer */
+static void
+mpd_set_plversion(int v){
+	if (v < 0)
+		return;								// not in this answer
+	if (v != mpd_model.plversion)
+		next_song.pos = SONG_UNKNOWN;		// the song at that position may be another one now
+	mpd_model.plversion = v;
+	if (tracklist_version > v){				// MPD has been restarted since the snapshot was taken
+		cache_unknown(&tracklist, 0);
+		tracklist_version = -1;
+		model_changed(TRACKLIST_CHANGED);
+	};
+	if (tracklist_version < 0)
+		tracklist_version = v;				// our cache was filled with this version of the playlist
+};
+
+/* Returns TRUE iff our tracklist cache may contain outdated entries */
+static int
+need_plchanges(){
+	return ( (! plchanges_asked) && (tracklist_version >= 0) && (mpd_model.plversion >= 0) 
+				&& (tracklist_version != mpd_model.plversion) );
+};
+
+/* The entry at pos has changed since tracklist_version. Fetch it again. */
+void
+mpd_plchanged_pos(int pos){
+	cache_store(&tracklist, pos, NULL);
+	if (pos == next_song.pos)
+		next_song.pos = SONG_UNKNOWN;
+	model_changed(TRACKLIST_CHANGED);
+};
+
+/* All changed positions in our cache are marked as unknown now.
+	A newer version MPD has reported meanwhile is not covered yet, need_plchanges() will ask again.
+*/
+void
+mpd_plchanges_ok(struct MODEL *a){
+	tracklist_version = plchanges_version;
+};
+
+/* mpdtool does not know "plchanged". We have to fetch all entries again. */
+void
+mpd_plchanges_ack(struct MODEL *a){
+	cache_unknown(&tracklist, 0);
+	tracklist_version = plchanges_version;
+	model_changed(TRACKLIST_CHANGED);
+};
+
 /* Called after a successful LOAD command. 
 	Currently we interpret the LOAD as a CLEAR_AND_LOAD, i.e. the old playlist is cleared and the new one loaded.
 	We assume the user wish has been fulfilled 
@@ -419,6 +720,7 @@ mpd_load_ok(struct MODEL *a){
 	user_model.playlistlength = -1;	
 
 	set_playlistlength(0);					// old playlist was cleared
+	tracklist_version = -1;					// the cache is empty, so it is up to date with any version
 	model_changed(TRACKLIST_CHANGED);
 	mpd_status_ok(a);						// here we set the new real playlistlength
 	
@@ -444,6 +746,7 @@ mpd_clear_ok(struct MODEL *a){
 	user_model.playlistlength = -1;	
 	user_model.cur_playlist = -1;			// wish fulfilled
 	set_playlistlength(0);					// clears the cache
+	tracklist_version = -1;
 	model_changed(TRACKLIST_CHANGED);
 	mpd_set_state(STOP);				// mpd changes its state to STOP after a CLEAR command!
 	mpd_set_pos(NO_SONG);				// there is no current song
@@ -462,6 +765,56 @@ user_wants_song(int pos){
 };
 
 
+/* ------------------------------------- Finding a song in the tracklist -------------------------------------- 
+	The user types a part of a title or an artist on the tracklist screen and we jump to the next song that matches.
+	The known entries of our tracklist cache are looked at first. Only if none of them matches,
+	mpdtool looks through the whole playlist of MPD ("plfind") and sends us just the position it has found.
+*/
+
+static void
+tracklist_found(int pos){
+	find_string = NULL;
+	found_pos = pos;
+	model_changed(FOUND_CHANGED);
+};
+
+/* The user wants the first song from pos from on that contains s. s == NULL cancels the wish.
+	We copy the string, because the view reuses its buffer and a request may be sent again after a lost answer.
+*/
+void
+user_tracklist_find(char *s, int from){
+	find_gen++;
+	find_string = NULL;
+	if ( (NULL == s) || ('\0' == *s) )
+		return;
+	if (cache_match(&tracklist, &from, s))
+		tracklist_found(from);
+	else {
+		strlcpy(find_text, s, sizeof(find_text));
+		find_string = find_text;
+		find_from = from;			// the first one that we could not check
+	};
+};
+
+int
+mpd_get_found_pos(){
+	return found_pos;
+};
+
+/* mpdtool sends "Pos: " if it has found a song */
+void
+mpd_plfind_ok(struct MODEL *a){
+	if (a->request.arg2 == find_gen)
+		tracklist_found( (a->pos >= 0) ? a->pos : -1 );
+};
+
+void
+mpd_plfind_ack(struct MODEL *a){
+	if (a->request.arg2 == find_gen)
+		tracklist_found(-1);
+};
+
+
 /* ------------------------------------- Playlists -------------------------------------- */
 
 /* Given an index starting from 0, we return the corresponding playlist name entry.
@@ -485,6 +838,14 @@ playlists_range_set(int start_pos, int end_pos){
 
 void
 mpd_set_playlistcount(int n){
+	/* If the number of playlists from the snapshot is still right, we keep their names.
+		We do not notice a playlist that was renamed, though.
+	*/
+	if (playlists_stale && (n != mpd_model.num_playlists)){
+		cache_unknown(&playlists, 0);
+		model_changed(PL_NAMES_CHANGED);
+	};
+	playlists_stale = 0;
 	mpd_model.num_playlists = n;
 	model_changed(NUM_PL_CHANGED);
 };
@@ -525,6 +886,74 @@ user_wants_playlist(int idx){
 	user_model.state = UNKNOWN;			// user accepts that state changes while doing this command
 };
 
+/* ------------------------------------- Jump index -------------------------------------- 
+	For long lists mpdtool tells us where each initial letter starts ("jumpindex").
+	The queue is indexed by title, the playlists by name. We ask once per tracklist version
+	or number of playlists. So the user can jump to a letter without waiting for MPD.
+*/
+
+/* Lists up to this length can be paged through quickly enough */
+#define JUMP_MIN_LEN	CACHE_LIM
+
+static int
+jump_group(char c){
+	if ( (c >= 'a') && (c <= 'z') )
+		c -= 'a' - 'A';
+	return ( (c >= 'A') && (c <= 'Z') ) ? c - 'A' + 1 : 0;
+};
+
+static int
+need_jumpindex(int list){
+	if (jump_index[list].asked)
+		return 0;
+	if (list == JUMP_QUEUE)
+		return ( (mpd_model.plversion >= 0) && (mpd_model.playlistlength > JUMP_MIN_LEN) 
+				&& (jump_index[list].version != mpd_model.plversion) );
+	return ( (! playlists_stale) && (mpd_model.num_playlists > JUMP_MIN_LEN)
+			&& (jump_index[list].version != mpd_model.num_playlists) );
+};
+
+/* Returns the first position in list whose name starts with c (any character that is not a letter, if c is none).
+	Returns -1 if there is no such position or if the index is not up to date.
+*/
+int
+mpd_jump_pos(int list, char c){
+	struct JUMP_INDEX *j = &jump_index[list];
+	
+	if (j->asked || (j->version != ( (list == JUMP_QUEUE) ? mpd_model.plversion : mpd_model.num_playlists )) )
+		return -1;
+	return j->pos[jump_group(c)];
+};
+
+/* s holds the first position of each group, "-" if there is none */
+void
+mpd_store_jumpindex(int list, char *s){
+	int g;
+	
+	for (g = 0; g < JUMP_GROUPS; g++){
+		while (*s == ' ')
+			s++;
+		jump_index[list].pos[g] = ( (*s >= '0') && (*s <= '9') ) ? atoi(s) : -1;
+		while ( (*s != ' ') && (*s != '\0') )
+			s++;
+	};
+};
+
+void
+mpd_jumpindex_ok(struct MODEL *a){
+	jump_index[a->request.arg].asked = 0;
+};
+
+/* An older mpdtool does not know "jumpindex". We do not ask again for this version. */
+void
+mpd_jumpindex_ack(struct MODEL *a){
+	int g;
+	
+	jump_index[a->request.arg].asked = 0;
+	for (g = 0; g < JUMP_GROUPS; g++)
+		jump_index[a->request.arg].pos[g] = -1;
+};
+
 /* --------------------------------------- Search results ------------------------------- */
 
 /* Given a result position starting from 0, we return the corresponding resultlist name entry.
@@ -566,9 +995,12 @@ resultlist_range_set(int start_pos, int end_pos){
 };
 
 
+/* We asked for a single result with "result n" */
 void
-mpd_store_resultname(char *name, int result_pos){
-	cache_store(&resultlist, result_pos, name);
+mpd_store_resultname(char *name, struct MODEL *a){
+	if (a->request.arg2 != search_gen)
+		return;						// the results of an older search
+	cache_store(&resultlist, a->request.arg, name);
 	model_changed(RESULT_NAMES_CHANGED);
 };
 
@@ -584,20 +1016,49 @@ mpd_resultlist_last(){
 
 void
 mpd_result_ack(struct MODEL *a){
-		mpd_store_resultname("", a->request.arg);	
+		mpd_store_resultname("", a);	
 };
 
 
 /* -------------------------------------- Searching ----------------------------------------------------------- */
 
-/* Our search command returned the number of results */
+/* The answer to the current search begins, the results of the last one are gone */
+static void
+search_begins(){
+	search_streamed = 0;
+	mpd_model.num_results = 0;
+	cache_init(&resultlist);
+	cache_set_limit(&resultlist, 0);
+	model_changed(SEARCH_STARTED | RESULTS_CHANGED | RESULT_NAMES_CHANGED);
+};
+
+/* mpdtool sends each name as soon as it has found it ("name: "), so the user sees the first results
+	while MPD is still searching. 
+*/
 void
-mpd_store_num_results(int n){
+mpd_stream_resultname(char *name, struct MODEL *a){
+	if (a->request.arg2 != search_gen)
+		return;
+	if (search_streamed < 0)
+		search_begins();
+	mpd_model.num_results = ++search_streamed;
+	cache_set_limit(&resultlist, search_streamed);
+	cache_store(&resultlist, search_streamed - 1, name);
+	model_changed(RESULTS_CHANGED | RESULT_NAMES_CHANGED);
+};
+
+/* Our search command returned the number of results.
+	The names that did not come with the answer (an older mpdtool sends none) are fetched with "result n".
+*/
+void
+mpd_store_num_results(int n, struct MODEL *a){
+	if (a->request.arg2 != search_gen)
+		return;
+	if (search_streamed < 0)
+		search_begins();
 	mpd_model.num_results = n;
 	cache_set_limit(&resultlist, n);	
-	cache_unknown(&resultlist, 0);			// all results in cache are unknown	
 	model_changed(RESULTS_CHANGED);
-	model_changed(RESULT_NAMES_CHANGED);
 };
 
 int
@@ -622,14 +1083,17 @@ mpd_get_search_string(){
 /* A search command has been successfully executed. */
 void
 mpd_search_ok(struct MODEL *a){
-	user_model.search_string = NULL;	// wish fulfilled
+	if ( (a->request.arg2 == search_gen) && (search_streamed < 0) )
+		search_begins();				// an answer without any line has no results
 };
 
-/* A search command returned an error. */
+/* A search command returned an error. 
+	mpdtool also answers with ACK if a newer search has overtaken this one, but then this is not the current one.
+*/
 void
 mpd_search_ack(struct MODEL *a){
-	user_model.search_string = NULL;	// abort this search
-	mpd_store_num_results(0);
+	if (a->request.arg2 == search_gen)
+		search_begins();				// abort this search
 };
 
 /* Maybe the user has changed his search string 
@@ -744,8 +1208,10 @@ mpd_inc_time(){
 			*/
 			if ( (0 != mpd_model.time_total) && (mpd_model.time_elapsed >= mpd_model.time_total)) {
 				/* We assume the current song has ended playing.
-					We then don't know very much, because playlist might have ended. */
-				mpd_set_pos(SONG_UNKNOWN);
+					If we know the next song, we show it at once.
+					Else we don't know very much, because playlist might have ended. */
+				if (! mpd_next_song_starts())
+					mpd_set_pos(SONG_UNKNOWN);
 			} else {
 				/* Time is not up. We can increment elapsed time */
 				mpd_model.time_elapsed++;
@@ -772,18 +1238,38 @@ PT_THREAD (update_playtime(struct pt *pt)){
 		PT_WAIT_UNTIL(pt, timer_expired(&sec_tmr));
 		sec_tmr.expired = 0;
 		mpd_inc_time();
+		check_pending();
+		model_save();
 	};
 	PT_END(pt);
 };
 
 
 /* ------------------------------ Playing state (play, pause, stop) -------------------------- */
-/* Used by view_state_changed to show the current playing state */
+/* Used by view_state_changed to show the current playing state (or the state the user wants) */
 int
 mpd_get_state(){
+	if (user_model.state > UNKNOWN)
+		return user_model.state;
 	return mpd_model.state;
 };
 
+/* The playing state that a successful state changing command leaves MPD in */
+static enum PLAYSTATE
+cmd_state(enum USER_CMD cmd){
+	switch (cmd){
+		case PAUSE_ON:
+			return PAUSE;
+		case STOP_CMD:
+			return STOP;
+		case PAUSE_OFF:
+		case PLAY_CMD:
+			return PLAY;
+		default:
+			return UNKNOWN;
+	};
+};
+
 /* Sets mpd to a certain playing state (i.e. UNKNOWN,PLAY,PAUSE,STOP) 
 	MPD handles the STOP state somewhat strangely.
 	The STOP state automatically resets the playing time of the current song to 0!
@@ -820,22 +1306,28 @@ mpd_set_state(enum PLAYSTATE newstate){
 		model_changed(STATE_CHANGED);
 };
 
-/* We got an OK answer after a state changing command */
+/* We got an OK answer after a state changing command 
+	The user may have changed his mind in the meantime, so we take the state from the command.
+*/
 void
 mpd_state_ok(struct MODEL *a){
-	mpd_set_state(user_model.state);
+	mpd_set_state(cmd_state(a->request.cmd));
 };
 
 /* We got an ACK answer after a state changing command */
 void
 mpd_state_ack(struct MODEL *a){
-		user_wants_state(-1);	// don't try to issue the same command again and again
+		user_model.state = -1;	// don't try to issue the same command again and again
+		model_changed(STATE_CHANGED | PENDING_CHANGED);		// show the state of MPD again
 		// TODO here some error handling, maybe message to the user
 };
 
+/* If MPD is already in state s, the wish is fulfilled at once, because MPD will not report a change */
 void
 user_wants_state(enum PLAYSTATE s){
-	user_model.state = s;
+	user_model.state = (s == mpd_model.state) ? -1 : s;
+	if (s > UNKNOWN)
+		user_wish_made(STATE_CHANGED);
 };
 
 /* The user has hit the pause toggle key.
@@ -846,16 +1338,24 @@ user_wants_state(enum PLAYSTATE s){
 */
 void
 user_toggle_pause(){
-	if ( (mpd_model.state == PAUSE) || (mpd_model.state == STOP) )
-		user_model.state = PLAY;
-	else if (mpd_model.state == PLAY)
-		user_model.state = PAUSE;
+	enum PLAYSTATE s = mpd_get_state();			// toggle what the user sees
+	
+	if ( (s == PAUSE) || (s == STOP) )
+		s = PLAY;
+	else if (s == PLAY)
+		s = PAUSE;
+	else
+		return;
+	user_model.state = (s == mpd_model.state) ? -1 : s;		// toggled back before MPD got the first wish
+	user_wish_made(STATE_CHANGED);
 };
 
 
 /* ---------------------------- Random mode ------------------------------- */
 int
 mpd_get_random(){
+	if (user_model.random != -1)
+		return user_model.random;
 	return mpd_model.random;
 };
 
@@ -874,22 +1374,28 @@ mpd_set_random(int rnd){
 */
 void
 mpd_random_ok(struct MODEL *a){
-	mpd_set_random(user_model.random);
-	user_model.random = -1;
+	mpd_set_random(a->request.arg);
+	if (user_model.random == a->request.arg)
+		user_model.random = -1;
 };
 
 void
 user_toggle_random(){
-	if (mpd_model.random == 0)
-		user_model.random = 1;
-	else if (mpd_model.random == 1)
-		user_model.random = 0;
+	int rnd = mpd_get_random();
+	
+	if ((rnd == 0) || (rnd == 1)){
+		rnd = ! rnd;
+		user_model.random = (rnd == mpd_model.random) ? -1 : rnd;
+		user_wish_made(RANDOM_CHANGED);
+	};
 };
 
 
 /* ---------------------------- Repeat mode ------------------------------------------ */
 int
 mpd_get_repeat(){
+	if (user_model.repeat != -1)
+		return user_model.repeat;
 	return mpd_model.repeat;
 };
 
@@ -903,16 +1409,20 @@ mpd_set_repeat(int rpt){
 
 void
 mpd_repeat_ok(struct MODEL *a){
-	mpd_set_repeat (user_model.repeat);
-	user_model.repeat = -1;
+	mpd_set_repeat (a->request.arg);
+	if (user_model.repeat == a->request.arg)
+		user_model.repeat = -1;
 };
 
 void
 user_toggle_repeat(){
-	if (mpd_model.repeat == 0)
-		user_model.repeat = 1;
-	else if (mpd_model.repeat == 1)
-		user_model.repeat = 0;
+	int rpt = mpd_get_repeat();
+	
+	if ((rpt == 0) || (rpt == 1)){
+		rpt = ! rpt;
+		user_model.repeat = (rpt == mpd_model.repeat) ? -1 : rpt;
+		user_wish_made(REPEAT_CHANGED);
+	};
 };
 
 
@@ -920,6 +1430,8 @@ user_toggle_repeat(){
 
 int
 mpd_get_single(){
+	if (user_model.single != -1)
+		return user_model.single;
 	return mpd_model.single;
 };
 
@@ -933,18 +1445,55 @@ mpd_set_single(int sgl){
 
 void
 mpd_single_ok(struct MODEL *a){
-	mpd_set_single (user_model.single);
-	user_model.single = -1;
+	mpd_set_single (a->request.arg);
+	if (user_model.single == a->request.arg)
+		user_model.single = -1;
 };
 
 // NOTE this routine does nothing, if mpd_model.single is == -1
 //		this happens when MPD does not support the single command
 void
 user_toggle_single(){
-	if (mpd_model.single == 0)
-		user_model.single = 1;
-	else if (mpd_model.single == 1)
-		user_model.single = 0;
+	int sgl = mpd_get_single();
+	
+	if ((sgl == 0) || (sgl == 1)){
+		sgl = ! sgl;
+		user_model.single = (sgl == mpd_model.single) ? -1 : sgl;
+		user_wish_made(SINGLE_CHANGED);
+	};
+};
+
+/* MPD rejected a "setvol", "random", "repeat" or "single" command.
+	Drop the wish, so that the view shows the value known from MPD again.
+	If the user already wants something else, we keep that.
+*/
+void
+mpd_option_ack(struct MODEL *a){
+	switch (a->request.cmd){
+		case VOLUME_NEW:
+			if (user_model.volume == a->request.arg)
+				user_model.volume = -1;
+			model_changed(VOLUME_CHANGED);
+			break;
+		case RANDOM_CMD:
+			if (user_model.random == a->request.arg)
+				user_model.random = -1;
+			model_changed(RANDOM_CHANGED);
+			break;
+		case REPEAT_CMD:
+			if (user_model.repeat == a->request.arg)
+				user_model.repeat = -1;
+			model_changed(REPEAT_CHANGED);
+			break;
+		case SINGLE_CMD:
+			if (user_model.single == a->request.arg)
+				user_model.single = -1;
+			model_changed(SINGLE_CHANGED);
+			break;
+		default:
+			return;
+	};
+	model_changed(PENDING_CHANGED);
 };
 
 
@@ -985,6 +1534,8 @@ is_stream(){
 /* We have got (maybe new) information about the current song pos */ 
 static void
 mpd_set_pos(int newpos){
+	STR_REF empty;
+	
 	if (mpd_model.pos == user_model.pos)		// wish fulfilled
 		user_model.pos = -1;
 	if (mpd_model.pos == newpos) return;		// nothing new
@@ -992,8 +1543,10 @@ mpd_set_pos(int newpos){
 	mpd_model.pos = newpos;
 
 	if (newpos == NO_SONG){ 
-		mpd_set_artist("");
-		mpd_set_title("");
+		empty = pool_new("", 0);
+		mpd_set_artist(empty);
+		mpd_set_title(empty);
+		pool_put(empty);
 		mpd_model.songid = NO_SONG;
 		mpd_set_state(STOP);						// can set time, but not always correct
 		mpd_set_time(-1, -1);	
@@ -1002,11 +1555,17 @@ mpd_set_pos(int newpos){
 			user_model.state = STOP;				// not possible, change his wish
 		};
 	} else { 
-		mpd_set_title(NULL);
+		mpd_set_title(NO_STR);
 		mpd_model.songid = UNKNOWN;				// NOTE songid is currently not used
 		
-		mpd_set_artist(NULL);						// We do not yet know which artist and title we have		
+		mpd_set_artist(NO_STR);						// We do not yet know which artist and title we have		
 		mpd_set_time(0, -1);						// The 0 is just a guess. But we have to get total time anyway
+		
+		/* The tracklist screen opens at the current song. Until it has been shown once, 
+			we fill the tracklist cache around that song (the snapshot may hold another part of the list).
+		*/
+		if (tracklist.shown_first < 0)
+			cache_range_set(&tracklist, newpos, newpos);
 	};
 	model_changed(POS_CHANGED);	
 };
@@ -1054,63 +1613,49 @@ mpd_set_id(int newid){
 /* Returns a string with the current title or "" if unknown. */
 char *
 mpd_get_title(){
-	if (NULL == mpd_model.title)
-		return "";
-	return mpd_model.title;
+	return pool_text(mpd_model.title);
 };
 
-/* We are given either NULL or a string with the title tag, NULL meaning title unknown */
+/* We are given either NO_STR or the title tag in the string pool, NO_STR meaning title unknown.
+	mpd_model shares the string.
+*/
 static void
-mpd_set_title(char *s){
-	int length;
-	
-	if (s == NULL){		
-		if (mpd_model.title != NULL){
-			mpd_model.title = NULL;
-			model_changed(TITLE_CHANGED);
-		};
-	} else {
-		if (strn_cpy_cmp(mpd_model.title_buf, s, TITLE_LEN, &length) == 0)	
-			model_changed(TITLE_CHANGED);
-		if (mpd_model.title == NULL)
-			model_changed(TITLE_CHANGED);
-		mpd_model.title = mpd_model.title_buf;
-	}; 
+mpd_set_title(STR_REF r){
+	if (! pool_equal(mpd_model.title, r))
+		model_changed(TITLE_CHANGED);
+	pool_put(mpd_model.title);
+	mpd_model.title = pool_ref(r);
 };
 
 /* Returns a string with the current artist or "" if unknown. */
 char *
 mpd_get_artist(){
-	if (NULL == mpd_model.artist)
-		return "";
-	return mpd_model.artist;
+	return pool_text(mpd_model.artist);
 };
 
-/* We are given either NULL or a string with the artist tag, NULL meaning artist unknown 
-	Copies artist information to mpd_model
+/* We are given either NO_STR or the artist tag in the string pool, NO_STR meaning artist unknown 
+	mpd_model shares the string.
 */
 static void
-mpd_set_artist(char *s){
-	int length;
+mpd_set_artist(STR_REF r){
+	if (! pool_equal(mpd_model.artist, r))
+		model_changed(ARTIST_CHANGED);
+	pool_put(mpd_model.artist);
+	mpd_model.artist = pool_ref(r);
+};
+
+/* Like mpd_set_title() or mpd_set_artist() for a string that is not in the pool */
+static void
+mpd_set_text(void (*set)(STR_REF r), char *s){
+	STR_REF r = pool_new(s, TITLE_LEN);
 	
-	if ( (s == NULL) ){
-		if (mpd_model.artist != NULL){
-			mpd_model.artist = NULL;		
-			model_changed(ARTIST_CHANGED);
-		};
-	} else {
-		if (strn_cpy_cmp(mpd_model.artist_buf, s, TITLE_LEN, &length) == 0)
-			model_changed(ARTIST_CHANGED);
-		if (NULL == mpd_model.artist){
-			model_changed(ARTIST_CHANGED);
-		};
-		mpd_model.artist = mpd_model.artist_buf;
-	}; 
+	set(r);
+	pool_put(r);
 };
 
 static int
 need_cursong(){
-	if  ( (mpd_model.playlistlength > 0) && ((mpd_model.artist == NULL) || (mpd_model.title == NULL)) )
+	if  ( (mpd_model.playlistlength > 0) && ((mpd_model.artist == NO_STR) || (mpd_model.title == NO_STR)) )
 		return 1;
 	// If we have a shoutcast, we request the current song information every 5 seconds
 	if ( (1 == is_stream()) && ( (system_time() - mpd_model.last_cursong) > 5 * TICKS_PER_SEC ) )
@@ -1136,16 +1681,16 @@ mpd_currentsong_ok(struct MODEL *a){
 	mpd_set_pos(a->pos);
 	mpd_set_id(a->songid);
 	
-	if (a->title == NULL)
-		mpd_set_title("?");		// should not occur, we always get a title due to mpdtool
+	if (a->title == NO_STR)
+		mpd_set_text(mpd_set_title, "?");		// should not occur, we always get a title due to mpdtool
 	else
 		mpd_set_title(a->title);
 	
-	if (NULL == a->artist){
-		if (a->name != NULL)		// a stream with a name 
+	if (NO_STR == a->artist){
+		if (a->name != NO_STR)		// a stream with a name 
 			mpd_set_artist(a->name);
 		else 
-			mpd_set_artist("?");
+			mpd_set_text(mpd_set_artist, "?");
 	} else
 		mpd_set_artist(a->artist);
 	
@@ -1157,12 +1702,59 @@ mpd_currentsong_ok(struct MODEL *a){
 }
 
 
+/* ------------------------------------------ Next song ------------------------------- */
+
+static int
+need_nextsong(){
+	return ( (mpd_model.state == PLAY) && (mpd_model.nextpos >= 0) && (next_song.pos != mpd_model.nextpos) );
+};
+
+/* We got an "OK" for the "playlistinfo" command that fetches the next song */
+void
+mpd_nextsong_ok(struct MODEL *a){
+	if (a->pos != next_song.pos)
+		return;
+
+	pool_put(next_song.title);
+	pool_put(next_song.artist);
+	next_song.title = (NO_STR == a->title) ? pool_new("?", 1) : pool_ref(a->title);
+	if (NO_STR != a->artist)
+		next_song.artist = pool_ref(a->artist);
+	else
+		next_song.artist = (NO_STR == a->name) ? pool_new("?", 1) : pool_ref(a->name);
+	next_song.valid = 1;
+};
+
+/* The current song has ended. If we know the next song, it is now the current song.
+	We do not know when the song after it starts, so the next status command is due
+	as soon as MPD has surely changed the song, too.
+	Returns 0 iff we do not know the next song.
+*/
+static int
+mpd_next_song_starts(){
+	if ( (mpd_model.nextpos < 0) || (! next_song.valid) || (next_song.pos != mpd_model.nextpos) )
+		return 0;
+	
+	if (mpd_model.nextpos == mpd_model.pos)
+		mpd_set_time(0, mpd_model.time_total);			// The same song again (repeat and single mode)
+	else {
+		mpd_set_pos(next_song.pos);
+		mpd_set_title(next_song.title);
+		mpd_set_artist(next_song.artist);
+		mpd_set_name(NO_STR);
+	};
+	mpd_model.nextpos = SONG_UNKNOWN;
+	
+	predicted_change = system_time();
+	mpd_model.last_status = predicted_change - STATUS_SYNC_TIME * TICKS_PER_SEC + PREDICT_SETTLE_TIME;
+	return 1;
+};
+
+
 static void
 user_song_unknown(){
 	user_model.pos = SONG_UNKNOWN;
 	user_model.state = UNKNOWN;
-	user_model.artist=NULL;
-	user_model.title=NULL;
 	user_model.songid = -1;
 	user_model.time_elapsed = -1;
 	user_model.time_total = -1;
@@ -1172,6 +1764,8 @@ user_song_unknown(){
 /* -------------------------------------- Volume and Mute ---------------------------------------- */
 int	
 mpd_get_volume(){
+	if (user_model.volume != -1)
+		return user_model.volume;
 	return mpd_model.volume;
 };
 
@@ -1192,15 +1786,26 @@ mpd_set_volume(int vol){
 void 
 mpd_volume_ok(struct MODEL *a){
 	mpd_set_volume(a->request.arg);	
+	if (user_model.volume == a->request.arg)
+		user_model.volume = -1;					// wish fulfilled, even if MPD already had that volume
+};
+
+/* Sets the volume the user wants and shows it at once */
+static void
+user_wants_volume(int vol){
+	user_model.volume = (vol == mpd_model.volume) ? -1 : vol;
+	user_wish_made(VOLUME_CHANGED);
 };
 
-/* Changes the internal user volume by adding a value to mpd_model.volume 
-	If mpd_model.volume is unknown at this point, wished volume will not be set.
+/* Changes the internal user volume by adding a value to the volume the user sees 
+	If the volume is unknown at this point, wished volume will not be set.
 */
 void
 user_wants_volume_add(int chg){
-	if (mpd_model.volume == -1) return;
-	user_model.volume = max(0, min(100, mpd_model.volume + chg));
+	int vol = mpd_get_volume();
+	
+	if (vol == -1) return;
+	user_wants_volume(max(0, min(100, vol + chg)));
 };
 
 /* User wants to toggle the mute status, i.e. if volume was 0, reset it to old value, else set it to 0. 
@@ -1208,14 +1813,17 @@ user_wants_volume_add(int chg){
 */
 void
 user_toggle_mute(){
-	if ( mpd_model.volume != 0 ){
-		mpd_model.old_volume = mpd_model.volume;		// remember the current volume
-		user_model.volume = 0;
+	int vol = mpd_get_volume();
+	
+	if ( vol != 0 ){
+		if (vol > 0)
+			mpd_model.old_volume = vol;		// remember the current volume
+		user_wants_volume(0);
 	} else
 		if (mpd_model.old_volume > 0)
-			user_model.volume = mpd_model.old_volume;
+			user_wants_volume(mpd_model.old_volume);
 		else
-			user_model.volume = 15;			// we use a default here in case we have no idea of old volume
+			user_wants_volume(15);			// we use a default here in case we have no idea of old volume
 };
 
 
@@ -1227,28 +1835,10 @@ model_set_last_response(unsigned int t){
 	mpd_model.last_response = t;
 };
 
-/* TODO
-	If we let the SCART software and mpdtool each send regular radio packets to us, we can detect much better
-	what kind of communication problem we have.
-	But that does not fit the current communication protocol. Every communication is initiated by Betty.
-	Possible solution:
-	Betty sends status commands in regular intervals (already implemented).
-	If they go through to MPD and we get an answer back, everything is ok.
-	If MPD is not responding, mpdtool does detect that.
-	In this case mpdtool sends an "ACK" answer with an appropriate error number.
-	If mpdtool does not respond anymore, the scart adapter has to send something back.
-	(Question: Can the scart adapter even recognize a dead mpdtool ?)
-	And if we get nothing back after some time, either our own radio link is dead or
-	the scart adapter is hung up.
-*/
-
+/* Betty gets no answers from MPD. mpd.c has found out why and backs off. */
 void
-model_check_mpd_dead(){
-	if ((system_time() - mpd_model.last_response) > MAX_MPD_TIMEOUT * TICKS_PER_SEC){
-		model_changed(MPD_DEAD);
-		// will time-out again after 10 seconds
-		mpd_model.last_response = system_time() - (MAX_MPD_TIMEOUT - MPD_RETRY_TIMEOUT) * TICKS_PER_SEC;
-	};
+model_mpd_dead(){
+	model_changed(MPD_DEAD);
 }
 
 
@@ -1294,6 +1884,11 @@ need_status(){
 	/* MPD gives us no time information, if the state is stopped. Stupid, but true. */
 	if (mpd_model.state == STOP) return 0;
 	
+	/* After a predicted song change we do not know the total time. But MPD may not have changed the song yet.
+		We wait for the regular status command (see mpd_next_song_starts()).
+	*/
+	if ( (system_time() - predicted_change) < PREDICT_SETTLE_TIME ) return 0;
+
 
 	return ( (mpd_model.time_elapsed == -1)
 			|| (mpd_model.time_total == -1)
@@ -1301,6 +1896,12 @@ need_status(){
 };
 
 
+/* Returns TRUE iff it is time for the regular status command */
+static int
+status_sync_due(){
+	return ( (system_time() - mpd_model.last_status) > STATUS_SYNC_TIME * TICKS_PER_SEC );
+};
+
 /* We got a valid response to a "status" command. */
 void
 mpd_status_ok(struct MODEL *a){
@@ -1309,6 +1910,7 @@ mpd_status_ok(struct MODEL *a){
 	mpd_set_random (a->random);
 	mpd_set_single (a->single);
 	set_playlistlength(a->playlistlength);
+	mpd_set_plversion(a->plversion);
 	mpd_set_state(a->state);
 	
 	// We got "OK" but no pos info. So there definately is no current song.
@@ -1317,6 +1919,7 @@ mpd_status_ok(struct MODEL *a){
 	else 
 		mpd_set_pos (a->pos);
 	mpd_set_id (a->songid);
+	mpd_model.nextpos = a->nextpos;
 
 	/* If the state is stopped and there is a current song, MPD does not give us any timing information.
 		But the internal elapsed time of MPD is reset to 00:00 
@@ -1331,6 +1934,169 @@ mpd_status_ok(struct MODEL *a){
 };
 
 
+/* ------------------------------------- Snapshot in flash -------------------------------------- 
+	After a battery swap we would have to fetch the playlist names and the tracklist again, one by one.
+	So we keep a snapshot of both in the flash file system (see flash/bfs.c) and show it at once at the next start.
+	MPD may have changed in the meantime. The tracklist carries the playlist version that it reflects,
+	so the usual "plchanges" fetches only what is different. The playlist names are checked 
+	with a "playlistcount" in the background (see playlists_stale).
+	
+	Snapshot layout: SNAPSHOT_MAGIC, length (2 bytes each), tracklist_version, num_playlists (4 bytes each),
+	then the tracklist and the playlists cache (see cache_save()).
+	
+	model_save() is called once per second. At most every SNAPSHOT_INTERVAL seconds it writes the snapshot, 
+	if it differs from the one in flash. The snapshot is not staged in RAM: snapshot_build() hands it 
+	piece by piece to snapshot_put(), which counts it, compares it with flash or writes it to flash.
+	When BFS has to erase a sector to make room, that takes about 1 s. So we only start the erase
+	and poll it in the next calls, the user interface keeps running in the meantime.
+	BFS has 3 sectors of 64 KByte, so at one snapshot per minute each sector is erased about once per hour of use. This is far below the life time of the flash.
+	The first snapshot is written SNAPSHOT_FIRST seconds after reset, so that a short session is kept as well.
+*/
+#define SNAPSHOT_MAGIC		0x4D42
+#define SNAPSHOT_HEAD		12
+#define SNAPSHOT_INTERVAL	60
+#define SNAPSHOT_FIRST		10
+
+static int snapshot_wait;		// seconds since the last check
+static int8_t snapshot_erasing;	// 1 while BFS erases a sector to make room for the snapshot
+
+enum SNAP_MODE {SNAP_COUNT, SNAP_COMPARE, SNAP_WRITE};
+static enum SNAP_MODE snap_mode;
+static const char *snap_flash;	// the snapshot in flash for SNAP_COMPARE and SNAP_WRITE
+static int snap_len;			// bytes handed to snapshot_put() so far
+static int8_t snap_differs;		// SNAP_COMPARE has found a difference
+
+/* Returns TRUE iff our caches reflect what MPD has now */
+static int
+snapshot_valid(){
+	return ( (tracklist_version >= 0) && (tracklist_version == mpd_model.plversion) && (! plchanges_asked)
+			&& (mpd_model.num_playlists >= 0) && (! playlists_stale) );
+};
+
+static void
+snapshot_put(const char *p, int n){
+	if (n <= 0)
+		return;
+	if (SNAP_COMPARE == snap_mode){
+		if (memcmp(snap_flash + snap_len, p, n) != 0)
+			snap_differs = 1;
+	} else if (SNAP_WRITE == snap_mode)
+		writeBuffer((unsigned long) snap_flash + snap_len, (unsigned char *) p, n);
+	snap_len += n;
+};
+
+/* Hands the snapshot of length len to snapshot_put() and returns its length.
+	len may be 0 with SNAP_COUNT, which finds it out.
+	SNAP_WRITE writes the magic last, so a snapshot that was cut off by a battery swap is not valid.
+*/
+static int
+snapshot_build(int len){
+	char head[SNAPSHOT_HEAD];
+	int skip = (SNAP_WRITE == snap_mode) ? 2 : 0;
+	
+	head[0] = SNAPSHOT_MAGIC & 0xFF;
+	head[1] = SNAPSHOT_MAGIC >> 8;
+	head[2] = len & 0xFF;
+	head[3] = len >> 8;
+	put_int(head + 4, tracklist_version);
+	put_int(head + 8, mpd_model.num_playlists);
+	
+	snap_len = skip;
+	snapshot_put(head + skip, SNAPSHOT_HEAD - skip);
+	cache_save(&tracklist, snapshot_put, CACHE_SAVE_SIZE);
+	cache_save(&playlists, snapshot_put, CACHE_SAVE_SIZE);
+	if (skip)
+		writeBuffer((unsigned long) snap_flash, (unsigned char *) head, skip);
+	return snap_len;
+};
+
+/* Returns TRUE iff the snapshot in flash is the same as ours of length len */
+static int
+snapshot_unchanged(int len){
+	const char *s = BFS_LoadFileAddr(BFS_ID_snapshot);
+	
+	/* The length is part of the snapshot, so a shorter or longer one in flash differs as well */
+	if ( (s == NULL) || (((s[2] & 0xFF) | ((s[3] & 0xFF) << 8)) != len) )
+		return 0;
+	snap_mode = SNAP_COMPARE;
+	snap_flash = s;
+	snap_differs = 0;
+	snapshot_build(len);
+	return ! snap_differs;
+};
+
+static void
+model_save(){
+	int len;
+	unsigned long addr;
+	
+	if (snapshot_erasing){
+		if (! BFS_EraseDone())
+			return;							// the chip can not even be read now
+		snapshot_erasing = 0;
+	};
+	if (++snapshot_wait < SNAPSHOT_INTERVAL)
+		return;
+	if (! snapshot_valid())
+		return;								// try again in a second
+	
+	snap_mode = SNAP_COUNT;
+	len = snapshot_build(0);
+	if (snapshot_unchanged(len)){
+		snapshot_wait = 0;
+		return;
+	};
+	switch (BFS_MakeSpaceStart(len)){
+		case BFS_SPACE_ERASING:
+			snapshot_erasing = 1;			// snapshot_wait stays, so we try again when the erase is done
+			return;
+		case BFS_SPACE_NONE:
+			debug_out("Snapshot not saved ", len);
+			snapshot_wait = 0;
+			return;
+	};
+	snapshot_wait = 0;
+	
+	addr = BFS_CreateFile(BFS_ID_snapshot, len);
+	if (0 == addr){
+		debug_out("Snapshot not saved ", len);
+		return;
+	};
+	snap_mode = SNAP_WRITE;
+	snap_flash = (const char *) addr;
+	snapshot_build(len);
+};
+
+/* Shows the snapshot from flash, if there is one. Called once at start. */
+static void
+model_restore(){
+	const char *s;
+	int len, used, n;
+	
+	if (! BFS_Mount())
+		return;
+	s = BFS_LoadFileAddr(BFS_ID_snapshot);
+	if ( (s == NULL) || (((s[0] & 0xFF) | ((s[1] & 0xFF) << 8)) != SNAPSHOT_MAGIC) )
+		return;
+	len = (s[2] & 0xFF) | ((s[3] & 0xFF) << 8);
+	
+	used = SNAPSHOT_HEAD;
+	n = cache_load(&tracklist, s + used, len - used);
+	if (n > 0){
+		used += n;
+		n = cache_load(&playlists, s + used, len - used);
+	};
+	if (n <= 0){							// broken, forget it
+		cache_init(&tracklist);
+		cache_init(&playlists);
+		return;
+	};
+	tracklist_version = get_int(s + 4);
+	mpd_model.num_playlists = get_int(s + 8);
+	playlists_stale = 1;
+	model_changed(TRACKLIST_CHANGED | NUM_PL_CHANGED | PL_NAMES_CHANGED);
+};
+
 /* ----------------------------------------------- Initialization -------------------------------------------------- */
 /* sets all values in st to UNKNOWN */
 void
@@ -1347,13 +2113,15 @@ model_reset(struct MODEL *m){
 	m->last_status = 0;
 	m->last_cursong = 0;
 	m->pos = SONG_UNKNOWN;
+	m->nextpos = SONG_UNKNOWN;
+	m->plversion = -1;
 	m->songid = -1;
-	m->title = NULL;
-	m->artist = NULL;
-	m->name = NULL;
-	m->artist_buf[0] = '\0';
-	m->title_buf[0] = '\0';
-	m->name_buf[0] = '\0';
+	pool_put(m->title);
+	pool_put(m->artist);
+	pool_put(m->name);
+	m->title = NO_STR;
+	m->artist = NO_STR;
+	m->name = NO_STR;
 	m->random = -1;
 	m->repeat = -1;
 	m->single = -1;
@@ -1363,8 +2131,9 @@ model_reset(struct MODEL *m){
 	m->num_results = -1;
 	m->script = -1;
 	m->pl_added = 0;
-	m->errmsg = NULL;
-	m->errmsg_buf[0] = '\0';
+	pool_put(m->errmsg);
+	m->errmsg = NO_STR;
+	m->str_lost = 0;
 };
 
 /* Initialize our model
@@ -1375,6 +2144,10 @@ void
 model_init(){
 	model_reset(&mpd_model);
 	model_reset(&user_model);
+	next_song.pos = SONG_UNKNOWN;
+	tracklist_version = -1;
+	plchanges_asked = 0;
+	jump_index[JUMP_QUEUE].version = jump_index[JUMP_PLAYLISTS].version = -1;
 	user_song_unknown();
 		
 	/* We assume that the user wants to play immideately */
@@ -1387,6 +2160,9 @@ model_init(){
 	cache_init(&tracklist);
 	cache_init(&playlists);
 	cache_init(&resultlist);
+	playlists_stale = 0;
+	snapshot_wait = SNAPSHOT_INTERVAL - SNAPSHOT_FIRST;
+	model_restore();
 
 	/* 
 		This task updates the models notion of playtime once per second.
@@ -25,25 +25,33 @@ enum PLAYSTATE {UNKNOWN, STOP, PAUSE, PLAY};
 #define NUM_PL_CHANGED		(1<<14)
 #define MPD_DEAD			(1<<15)
 #define PLAYLIST_EMPTY		(1<<16)
+#define PENDING_CHANGED		(1<<17)
+#define FOUND_CHANGED		(1<<18)
+#define SEARCH_STARTED		(1<<19)
+
+/* The jump index has one group for names that do not start with a letter and one for each letter A-Z.
+	NOTE This must be the same as JUMP_GROUPS in mpdtool.c
+*/
+#define JUMP_GROUPS		27
+
+/* The lists that have a jump index */
+#define JUMP_QUEUE		0
+#define JUMP_PLAYLISTS	1
 
 // Length of artist and title and name strings each, some songs and some albums really have long titles
 #define TITLE_LEN 149
-// Size of the character array needed to store artist and title strings each
-#define TITLE_SIZE	(TITLE_LEN + 1)
 
-// Maximum number of seconds that we wait for MPD to send anything to us before raising an error
-// Currently we rely on the fact that we send a "status" command regularily,
-// so we should get our regular responses from MPD
-#define MAX_MPD_TIMEOUT 34
+// Maximum number of seconds that we wait before we try again when the communication with MPD is broken
 #define MPD_RETRY_TIMEOUT 10
 
-// status command interval, must be smaller than MAX_MPD_TIMEOUT
+// Time in ticks after which we tell the user that a wish is still not confirmed by MPD
+#define PENDING_TIMEOUT	(2 * TICKS_PER_SEC)
+
+// status command interval, the status command is also our heartbeat to detect communication problems
 #define STATUS_SYNC_TIME 25
 
 // Maximum length of MPD error message that we store
 #define ERRMSG_LEN 	63
-// Size of the character array needed to store MPD error message
-#define ERRMSG_SIZE	(ERRMSG_LEN + 1)
 
 /* MPD gives a 0-based answer on song pos. 
  * We need 4 extra values here:
@@ -74,12 +82,11 @@ struct MODEL {
 	int8_t repeat;				// 1 if repeat mode is on
 	int8_t single;				// 1 if single mode is on
 	int songid;					// MPD's internal id of the current song
-	char artist_buf[TITLE_SIZE];	// If cur_artist points here, this is the artist tag, else irrelevant 
-	char title_buf[TITLE_SIZE];	// If cur_title points here, this is the title tag, else irrelevant 
-	char name_buf[TITLE_SIZE];	// If name points here, this is the name tag, else irrelevant 
-	char *artist;				// NULL if not known, else points to info in artist_buf;
-	char *title;				// NULL if not known, else points to info in title_buf;
-	char *name;					// NULL if no name, else points to name_buf (name is shown in tracklist) 
+	int nextpos;				// position of the song that MPD plays next, SONG_UNKNOWN if none
+	int plversion;				// version of the current playlist, changes with every change of the playlist (-1 if unknown)
+	STR_REF artist;				// the artist tag in the string pool, NO_STR if not known
+	STR_REF title;				// the title tag, NO_STR if not known
+	STR_REF name;				// the name tag, NO_STR if none (name is shown in tracklist)
 	int time_elapsed;			// in seconds
 	int time_total;				// in seconds
 	unsigned int last_response;	// system time when we last saw a response line from mpd (for error detection)
@@ -91,8 +98,8 @@ struct MODEL {
 	int num_results;			// number of results after a search command
 	unsigned int script;		// if the user wants a script to be executed this is >= 0
 	int pl_added;				// no. of songs added to the paylist (either + or -), 0 means no change or unknown
-	char errmsg_buf[ERRMSG_SIZE];
-	char *errmsg;				// error message from MPD, NULL if no error
+	STR_REF errmsg;				// error message from MPD, NO_STR if no error
+	int8_t str_lost;			// only used by ans_model, 1 if a string of the answer did not fit into the string pool
 	UserReq request;			// only used by ans_model, request that this answer is for
 };
 
@@ -101,6 +108,11 @@ int model_get_changed(void);
 void model_reset_changed();
 
 int action_needed(UserReq *request);
+void model_request_lost(UserReq *request);
+int model_batch_actions(UserReq *req, int max);
+int model_pending();
+int model_pending_late();
+void mpd_option_ack(struct MODEL *a);
 
 /* ------------------------------------ Scripts --------------------------------------- */
 void user_wants_script(int script_no);
@@ -117,6 +129,17 @@ void mpd_clear_ok(struct MODEL *a);
 void mpd_load_ok(struct MODEL *a);
 int mpd_get_pl_length();
 int mpd_get_pl_added();
+void mpd_plchanged_pos(int pos);
+void mpd_plchanges_ok(struct MODEL *a);
+void mpd_plchanges_ack(struct MODEL *a);
+void user_tracklist_find(char *s, int from);
+int mpd_get_found_pos();
+void mpd_plfind_ok(struct MODEL *a);
+void mpd_plfind_ack(struct MODEL *a);
+int mpd_jump_pos(int list, char c);
+void mpd_store_jumpindex(int list, char *s);
+void mpd_jumpindex_ok(struct MODEL *a);
+void mpd_jumpindex_ack(struct MODEL *a);
 /* ------------------------------------- Playlists -------------------------------------- */
 void mpd_set_playlistname(char *s);
 char *mpd_playlistname_info(int idx);
@@ -131,12 +154,13 @@ char *mpd_result_info(int i);
 void resultlist_range_set(int start_pos, int end_pos);
 int  mpd_resultlist_last();
 void mpd_result_ack(struct MODEL *a);
-void mpd_store_resultname(char *name, int result_pos);
+void mpd_store_resultname(char *name, struct MODEL *a);
 int mpd_find_type();
 void mpd_set_find_type(int t);
 
 /* -------------------------------------- Searching ----------------------------------------------------------- */
-void mpd_store_num_results(int n);
+void mpd_store_num_results(int n, struct MODEL *a);
+void mpd_stream_resultname(char *name, struct MODEL *a);
 int mpd_get_num_results();
 char *mpd_get_search_string();
 void mpd_search_ok(struct MODEL *a);
@@ -185,6 +209,7 @@ char *mpd_get_title();
 char *mpd_get_artist();
 void user_wants_song(int pos);
 void mpd_currentsong_ok(struct MODEL *a);
+void mpd_nextsong_ok(struct MODEL *a);
 
 /* -------------------------------------- Volume and Mute ---------------------------------------- */
 int	mpd_get_volume();
@@ -195,7 +220,7 @@ void mpd_volume_ok(struct MODEL *a);
 void mpd_status_ok(struct MODEL *a);
 
 /* -------------------------------------- Other information -------------------------------------------------- */
-void model_check_mpd_dead();
+void model_mpd_dead();
 void model_set_last_response(unsigned int time);
 void model_reset(struct MODEL *m);
 
@@ -55,6 +55,16 @@
 static char response[RESPLEN];
 
 
+/* The argument for the n-th %d of a format string */
+static int
+req_arg(UserReq *f, int n){
+	if (n == 1)
+		return f->arg;
+	if (n == 2)
+		return f->arg2;
+	return f->arg3;
+};
+
 /* Somewhat similar to the C function. 
 	We don't want to include the whole snprintf function,
 	so we include a very reduced version.
@@ -81,12 +91,7 @@ slprintf(char *dst, const char *src, UserReq *f, int size){
 		
 		if ( (*src == '%') && ( *(src + 1) == 'd') ){
 			dst[cur_len] = 0;
-			if (cur_arg == 1){
-				cur_len = strlcat(dst, get_digits(f->arg, num_string, 0), size);
-				cur_arg++;
-			} else{
-				cur_len = strlcat(dst, get_digits(f->arg2, num_string, 0), size);
-			};
+			cur_len = strlcat(dst, get_digits(req_arg(f, cur_arg++), num_string, 0), size);
 			src += 2;
 		} else if ( (*src == '%') && ( *(src + 1) == 's') ){
 			dst[cur_len] = 0;
@@ -99,13 +104,167 @@ slprintf(char *dst, const char *src, UserReq *f, int size){
 	return 0;				// too big
 }
 
+/* Stores the non-negative number val as a varint in dst.
+	6 bits per byte, least significant bits first. 
+	All bytes except the last one are 0xC0 | bits, the last one is 0x80 | bits.
+	Returns the number of bytes or 0 iff it did not fit into size bytes (or val is negative).
+*/
+static int
+put_varint(char *dst, int val, int size){
+	int n = 0;
+	
+	if (val < 0)	return 0;
+	
+	while (val >= 0x40){
+		if (n >= size) return 0;
+		dst[n++] = 0xC0 | (val & 0x3F);
+		val >>= 6;
+	};
+	if (n >= size) return 0;
+	dst[n++] = 0x80 | val;
+	return n;
+};
+
+/* Compact version of slprintf() for mpdtool.
+	Stores the opcode and then for each %d in src the argument as a varint.
+	Returns the length of the created string or 0 iff it did not fit completely into given size.
+*/
+static int
+compact_printf(char *dst, uint8_t opcode, const char *src, UserReq *f, int size){
+	int cur_len = 0, n;
+	int cur_arg = 1;
+	
+	if (size < 2)	return 0;
+	dst[cur_len++] = opcode;
+	
+	for (; *src; src++){
+		if ( (*src == '%') && ( *(src + 1) == 'd') ){
+			n = put_varint(dst + cur_len, req_arg(f, cur_arg++), size - 1 - cur_len);
+			if (0 == n)
+				return 0;
+			cur_len += n;
+		};
+	};
+	dst[cur_len] = 0;
+	return cur_len;
+};
+
 
 /* ------------------------------ The Communicator ----------------------------------------- */
 
 
+/* ---------------------------- Keys of the answer lines ------------------------------------- */
+/* Each answer line from MPD (or mpdtool) is "key: value". We find out the key once per line
+	and hand the key and the value to the handler of the request.
+	Instead of "key: " mpdtool may send a single byte token: ANS_TOKEN + key, the value follows directly.
+	NOTE The numbers of the keys are part of the link protocol. Do not change their order, only append.
+*/
+enum ANS_KEY {
+	K_NONE, K_TAG, K_OK, K_LIST_OK, K_ACK, K_SCART,
+	K_VOLUME, K_REPEAT, K_RANDOM, K_SINGLE, K_PLAYLISTLENGTH, K_PLAYLIST, K_STATE,
+	K_SONG, K_NEXTSONG, K_SONGID, K_TIME,
+	K_ARTIST, K_TITLE, K_NAME, K_POS, K_ID,
+	K_PLAYLISTCOUNT, K_CPOS, K_JUMPINDEX, K_RESULTS, K_RESULTNAME, K_COMPACT,
+	K_WAIT,
+	NUM_KEYS
+};
+
+#define ANS_TOKEN 0x80
+
+struct ans_keyword {
+	char *s;
+	uint8_t len;
+};
+
+#define KEYWORD(s) {s, sizeof(s) - 1}
+
+static const struct ans_keyword keywords[NUM_KEYS] = {
+	KEYWORD(""), KEYWORD("#"), KEYWORD("OK"), KEYWORD("list_OK"), KEYWORD("ACK"), KEYWORD("scart: "),
+	KEYWORD("volume: "), KEYWORD("repeat: "), KEYWORD("random: "), KEYWORD("single: "),
+	KEYWORD("playlistlength: "), KEYWORD("playlist: "), KEYWORD("state: "),
+	KEYWORD("song: "), KEYWORD("nextsong: "), KEYWORD("songid: "), KEYWORD("time: "),
+	KEYWORD("Artist: "), KEYWORD("Title: "), KEYWORD("Name: "), KEYWORD("Pos: "), KEYWORD("Id: "),
+	KEYWORD("playlistcount: "), KEYWORD("cpos: "), KEYWORD("jumpindex: "), KEYWORD("results: "),
+	KEYWORD("name: "), KEYWORD("compact: "), KEYWORD("wait: ")
+};
+
+/* Returns the key of line and sets *val to the value behind it.
+	The first characters tell us which key it can be, then we compare with this one only.
+	Returns K_NONE if we do not know the key. *val is then the whole line.
+	NOTE line must be in a buffer of at least 9 characters, because we look at line[8] for the "playlist..." keys.
+*/
+static int
+ans_key(char *line, char **val){
+	int k;
+	
+	*val = line;
+	if ( (uint8_t) line[0] >= ANS_TOKEN ){
+		k = (uint8_t) line[0] - ANS_TOKEN;
+		if (k >= NUM_KEYS)
+			return K_NONE;
+		*val = line + 1;
+		return k;
+	};
+	
+	switch (line[0]){
+		case '#':	k = K_TAG;		break;
+		case 'A':	k = ('C' == line[1]) ? K_ACK : K_ARTIST;	break;
+		case 'I':	k = K_ID;		break;
+		case 'N':	k = K_NAME;		break;
+		case 'O':	k = K_OK;		break;
+		case 'P':	k = K_POS;		break;
+		case 'T':	k = K_TITLE;	break;
+		case 'c':	k = ('o' == line[1]) ? K_COMPACT : K_CPOS;	break;
+		case 'j':	k = K_JUMPINDEX;	break;
+		case 'l':	k = K_LIST_OK;	break;
+		case 'n':	k = ('a' == line[1]) ? K_RESULTNAME : K_NEXTSONG;	break;
+		case 't':	k = K_TIME;		break;
+		case 'v':	k = K_VOLUME;	break;
+		case 'w':	k = K_WAIT;		break;
+		
+		case 'p':
+			switch (line[8]){
+				case ':':	k = K_PLAYLIST;			break;
+				case 'l':	k = K_PLAYLISTLENGTH;	break;
+				case 'c':	k = K_PLAYLISTCOUNT;	break;
+				default:	return K_NONE;
+			};
+			break;
+			
+		case 'r':
+			switch (line[2]){
+				case 'p':	k = K_REPEAT;	break;
+				case 'n':	k = K_RANDOM;	break;
+				case 's':	k = K_RESULTS;	break;
+				default:	return K_NONE;
+			};
+			break;
+			
+		case 's':
+			switch (line[1]){
+				case 'c':	k = K_SCART;	break;
+				case 'i':	k = K_SINGLE;	break;
+				case 't':	k = K_STATE;	break;
+				case 'o':	k = (':' == line[4]) ? K_SONG : K_SONGID;	break;
+				default:	return K_NONE;
+			};
+			break;
+			
+		default:
+			return K_NONE;
+	};
+	
+	if (! strstart(line, keywords[k].s))
+		return K_NONE;
+	*val = line + keywords[k].len;
+	return k;
+};
+
+
 /* ---------------------------- Response collecting handlers ------------------------------------- */
 /* Each request from Betty choses one of the following handlers.
 	The handler then reads the response line(s) from mpd and tells the model about the results.
+	It gets the key of the line (see ans_key()) and the value behind it.
 */
  
 
@@ -118,108 +277,99 @@ slprintf(char *dst, const char *src, UserReq *f, int size){
 	TODO get more information, namely if some info is not given
 */ 
 void 
-ans_status_line(char *s, struct MODEL *a){
-	int tmp;
+ans_status_line(int key, char *val, struct MODEL *a){
 	char *s2;
 	
-	if (strstart(response, "volume: ")){
-		a->volume = atoi(response+8);
-		return;
-	};	
-	
-	if (strstart(response, "repeat: ")){
-		a->repeat = atoi (response+8);
-		return;
-	};	
+	switch (key){
+		case K_VOLUME:
+			a->volume = atoi(val);
+			break;
 			
-	if (strstart(response, "random: ")){
-		a->random = atoi (response+8);
-		return;
-	};
-	
-	if (strstart(response, "single: ")){
-		a->single = atoi (response+8);
-		return;
-	};
-
-	if (strstart(response, "playlistlength: ")){ 
-		a->playlistlength = atoi(response+16);
-		return;
-	};
-	
-	if (strstart(response, "state: ")){
-		tmp = UNKNOWN;
-		if (strstart(response+7, "play")) 
-			tmp = PLAY;
-		else 
-			if (strstart(response+7, "pause"))
-				tmp = PAUSE;
-			else
-				if (strstart(response+7, "stop"))
-					tmp = STOP;
-		a->state = tmp;
-		return;
-	};
-	
-	/* Compare with "song: " */
-	if (strstart(response, "song: ")){ 
-		a->pos = atoi(response+6);
-		return;
-	};
-	
-	/* Compare with "Id: " */
-	if (strstart(response, "songid: ")){
-		a->songid = atoi(response+4);
-		return;
-	};
-	
-	if (strstart(response, "time: ")) {
-		s2 = strchr(response+6, ':');
-		if (s2) {
-			a->time_elapsed = atoi(response+6);
-			a->time_total = atoi(s2+1);
-		};
-		return;
+		case K_REPEAT:
+			a->repeat = atoi(val);
+			break;
+			
+		case K_RANDOM:
+			a->random = atoi(val);
+			break;
+			
+		case K_SINGLE:
+			a->single = atoi(val);
+			break;
+			
+		case K_PLAYLISTLENGTH:
+			a->playlistlength = atoi(val);
+			break;
+			
+		case K_PLAYLIST:
+			a->plversion = atoi(val);
+			break;
+			
+		case K_STATE:
+			a->state = UNKNOWN;
+			if (strstart(val, "play")) 
+				a->state = PLAY;
+			else if (strstart(val, "pause"))
+				a->state = PAUSE;
+			else if (strstart(val, "stop"))
+				a->state = STOP;
+			break;
+			
+		case K_SONG:
+			a->pos = atoi(val);
+			break;
+			
+		case K_NEXTSONG:
+			a->nextpos = atoi(val);
+			break;
+			
+		case K_SONGID:
+			a->songid = atoi(val);
+			break;
+			
+		case K_TIME:
+			s2 = strchr(val, ':');
+			if (s2) {
+				a->time_elapsed = atoi(val);
+				a->time_total = atoi(s2+1);
+			};
+			break;
 	};
 };
 
 
+/* Stores the tag val of an answer in *pr. If the string pool has no room for it, the answer is incomplete. */
+static void
+ans_string(struct MODEL *a, STR_REF *pr, char *val){
+	if (! pool_set(pr, val, TITLE_LEN))
+		a->str_lost = 1;
+};
+
 /* We got a line from mpd after a "current_song" command.
 	Gather the information in the variable mpd_status.
 */ 
 static void 
-ans_currentsong_line(char *s, struct MODEL *a){
-
-	/* Compare with "Artist: " */
-	if (strstart(response, "Artist: ")){
-		strlcpy(a->artist_buf, response+8, sizeof(a->artist_buf) );
-		a->artist = a->artist_buf;
-		return;
-	};
-	
-	/* Compare with "Title: " */
-	if (strstart(response, "Title: ")){
-		strlcpy(a->title_buf, response+7, sizeof(a->title_buf) );
-		a->title = a->title_buf;
-		return;
-	};
-	
-	/* Compare with "Name: " */
-	if (strstart(response, "Name: ")){
-		strlcpy(a->name_buf, response+6, sizeof(a->name_buf) );
-		a->name = a->name_buf;
-		return;
-	};
-	
-	/* Compare with "Pos: " */
-	if (strstart(response, "Pos: ")){
-		a->pos = atoi (response+5);
-		return;
-	};
-	
-	/* Compare with "Id: " */
-	if (strstart(response, "Id: ")){
-		a->songid = atoi (response+4);
+ans_currentsong_line(int key, char *val, struct MODEL *a){
+	switch (key){
+		case K_ARTIST:
+			ans_string(a, &(a->artist), val);
+			break;
+			
+		case K_TITLE:
+			ans_string(a, &(a->title), val);
+			break;
+			
+		case K_NAME:
+			ans_string(a, &(a->name), val);
+			break;
+			
+		case K_POS:
+			a->pos = atoi(val);
+			break;
+			
+		case K_ID:
+			a->songid = atoi(val);
+			break;
 	};
 };
 
@@ -228,63 +378,90 @@ ans_currentsong_line(char *s, struct MODEL *a){
 	It must have been reset to the correct values beforehand.
 */
 void 
-ans_playlistinfo_line(char *s, struct MODEL *a){
-
-	/* Compare with "Artist: " */
-	if (strstart(response, "Artist: ")){
-		strlcpy(a->artist_buf, response+8, TITLE_LEN);
-		return;
-	};
+ans_playlistinfo_line(int key, char *val, struct MODEL *a){
+	switch (key){
+		case K_ARTIST:
+			ans_string(a, &(a->artist), val);
+			break;
 			
-	/* Compare with "Title: " */
-	if (strstart(response, "Title: ")){
-		strlcpy(a->title_buf, response+7, TITLE_LEN);
-		return;
-	};
-	
-	/* Compare with "Name: " */
-	if (strstart(response, "Name: ")){
-		strlcpy(a->name_buf, response+6, sizeof(a->name_buf) );
-		a->name = a->name_buf;
-		return;
-	};
-	
-	/* Compare with "Pos: " */
-	if (strstart(response, "Pos: ")) {
-		a->pos = atoi(response+5);
-		return;
+		case K_TITLE:
+			ans_string(a, &(a->title), val);
+			break;
+			
+		case K_NAME:
+			ans_string(a, &(a->name), val);
+			break;
+			
+		case K_POS:
+			a->pos = atoi(val);
+			break;
 	};
 };
 
 static void 
-ans_plcount_line(char *s, struct MODEL *a){
-	/* Compare with "playlistcount: " */
-	if (strstart(response, "playlistcount: "))
-		mpd_set_playlistcount(atoi(response+15));
+ans_plcount_line(int key, char *val, struct MODEL *a){
+	if (K_PLAYLISTCOUNT == key)
+		mpd_set_playlistcount(atoi(val));
+};
+
+
+/* We sent a "plchanged x y z" command. Each line tells us one position in our tracklist cache that has changed. */
+static void
+ans_plchanges_line(int key, char *val, struct MODEL *a){
+	if (K_CPOS == key)
+		mpd_plchanged_pos(atoi(val));
+};
+
+/* We sent a "jumpindex x" command. One line tells us where each initial starts in list x. */
+static void
+ans_jumpindex_line(int key, char *val, struct MODEL *a){
+	if (K_JUMPINDEX == key)
+		mpd_store_jumpindex(a->request.arg, val);
+};
+
+static void
+ans_plname_line(int key, char *val, struct MODEL *a){
+	if (K_PLAYLIST == key)
+		mpd_store_playlistname(val, a->request.arg);
+};
+
+/* We sent a "SEARCH xxx xxx" command. mpdtool sends each name as soon as it has found it, then the number of results. */
+static void
+ans_search_line(int key, char *val, struct MODEL *a){
+	if (K_RESULTNAME == key)
+		mpd_stream_resultname(val, a);
+	if (K_RESULTS == key)
+		mpd_store_num_results(atoi(val), a);
 };
 
 
 static void
-ans_plname_line(char *s, struct MODEL *a){
-	/* Compare with "playlist: " */
-	if (strstart(response, "playlist: "))
-		mpd_store_playlistname(response+10, a->request.arg);
+ans_result_line(int key, char *val, struct MODEL *a){
+	if (K_RESULTNAME == key)
+		mpd_store_resultname(val, a);	
 };
 
-/* We sent a "SEARCH xxx xxx" command */
+/* Does mpdtool understand compact commands ? -1 if we do not know yet */
+static int8_t compact_link = -1;
+
+/* We sent a "compact" command.
+	mpdtool answers "compact: 1", an older mpdtool passes the command to MPD, which answers with an ACK.
+*/
 static void
-ans_search_line(char *s, struct MODEL *a){
-	/* Compare with "results: " */
-	if (strstart(response, "results: "))
-		mpd_store_num_results(atoi(response+9));
+ans_compact_line(int key, char *val, struct MODEL *a){
+	if ( (K_COMPACT == key) && ('1' == *val) )
+		compact_link = 1;
 };
 
+static void
+mpd_compact_ok(struct MODEL *a){
+	if (compact_link != 1)
+		compact_link = 0;
+};
 
 static void
-ans_result_line(char *s, struct MODEL *a){
-	/* Compare with "name: " */
-	if (strstart(response, "name: "))
-		mpd_store_resultname(response+6, a->request.arg);	
+mpd_compact_ack(struct MODEL *a){
+	compact_link = 0;
 };
 
  /* ----------------------------------------- End of response gathering functions ------------------------- */ 
@@ -316,7 +493,7 @@ static struct pt_sem line_ready;
 	
 	TODO this could be made more efficient. We do not need an extra response buffer.
 	The rf module increments a semaphore each time it puts a complete line in its buffer.
-	The consuming function(s) (collect_lines) decrement that semaphore.
+	The consuming function(s) (dispatch_lines) decrement that semaphore.
 	The buffer contents need not be copied if the rf module substitutes each "\n" with a '\0' to make C strings.
 	But we have to make sure that lines are consumed or discarded within a relatively short time frame, so that the buffer
 	is not overflowing.
@@ -371,82 +548,7 @@ PT_THREAD (assemble_line(struct pt *pt)) {
 };
 
 
-/* We wait for an answer from MPD.
-	Process all lines received via radio.
-	Detects end of transmission by checking for "OK" and "ACK" lines.
-	"OK" lines are processed with function process_ok().
-	"ACK" lines are processed with function process_ack().
-	All other lines are processed with the function process_line().
-	
-	Ends with response_finished set to 1 iff we finally received an OK or ACK.
-	If ACK or no answer within some time delay exit with response_finished set to 0.
-	
-	First parameter is the pt structure.
-	Second parameter is a function which processes one line of the answer at a time.
-		This function interprets the answer and changes the model if appropriate.
-	Third parameter is a function which is called when MPD sends an "OK" answer.
-		Command succeeded. The function can also update the model.
-	Fourth parameter is a function which is called when MPD sends an "ACK" answer.
-		Some error happened. Interpret the error, inform the user or ignore it.
-	Any of these function parameters can be NULL.
-
-*/
-PT_THREAD (collect_lines(struct pt *pt,
-			void (*process_line) (char *s, struct MODEL *a),
-			void (*process_ok) (struct MODEL *a),
-			void (*process_ack) (struct MODEL *a),
-			struct MODEL *ans_model,
-			int *response_finished
-			)) {
-	static struct timer tmr;
-			
-	PT_BEGIN(pt);
-	*response_finished = 0;
-	
-	/* We should receive all the answers in a relatively short time frame, else something went wrong anyway 
-		Searching takes somewhat longer, so we are waiting around 2 seconds.
-	*/
-	timer_add(&tmr, 22 * TICKS_PER_TENTH_SEC, 0);
-	
-	while (1){
-
-		PT_WAIT_UNTIL(pt, (PT_SEM_CHECK(&line_ready) || timer_expired(&tmr)) );
-		
-		if (PT_SEM_CHECK(&line_ready) ){
-			if (strstart(response, "OK")) {
-				if (process_ok) 
-					process_ok(ans_model);
-				*response_finished = 1;
-				break;
-			};
-		
-			if (strstart(response, "ACK")){
-				strlcpy(ans_model->errmsg_buf, response + 3, ERRMSG_SIZE);
-				ans_model->errmsg=ans_model->errmsg_buf;
-				if (process_ack) 
-					process_ack(ans_model);
-				*response_finished = 1;
-				break;
-			};
-		
-			/* gather information from response line by the given function */
-			if (process_line) 
-				process_line(response, ans_model);
-			
-			PT_SEM_INIT(&line_ready, 0);	// Tell producer that we consumed the line
-		
-		} else {							// Time Out	
-			dbg("collect_lines() timed out");
-			break;
-		};	
-	};
-	
-	PT_SEM_INIT(&line_ready, 0);	// Tell producer that we consumed the line if there is one
-	
-	timer_del(&tmr);
-		
-	PT_END(pt);
-};
+static char *link_failure_text();
 
 /* ---------------------------- End of functions which handle communication with mpd ------------------- */
  	
@@ -482,6 +584,9 @@ inform_view(int model_changed){
 	if (model_changed & SINGLE_CHANGED)
 		view_single_changed(mpd_get_single());
 	
+	if (model_changed & (PENDING_CHANGED | VOLUME_CHANGED | STATE_CHANGED | RANDOM_CHANGED | REPEAT_CHANGED | SINGLE_CHANGED))
+		view_pending_changed(model_pending(), model_pending_late());
+	
 	
 	// This should come before TRACKLIST_CHANGED
 	if (model_changed & PL_LENGTH_CHANGED)
@@ -490,6 +595,9 @@ inform_view(int model_changed){
 	if (model_changed & TRACKLIST_CHANGED)
 		view_tracklist_changed();
 	
+	if (model_changed & FOUND_CHANGED)
+		view_tracklist_found(mpd_get_found_pos());
+	
 	if ( (model_changed & PL_LENGTH_CHANGED) || (model_changed & POS_CHANGED) )
 		view_pos_changed();
 	
@@ -502,6 +610,10 @@ inform_view(int model_changed){
 	};
 
 	
+	// This should come before RESULTS_CHANGED
+	if (model_changed & SEARCH_STARTED)
+		view_search_started();
+	
 	if (model_changed & RESULTS_CHANGED){
 		view_results_changed(mpd_get_num_results());
 	};
@@ -515,12 +627,9 @@ inform_view(int model_changed){
 		radio reception to a sane state.
 		*/
 		rx_reset();
-		// We show the message for 1 seconds less than the time_out, so if the
+		// We show the message for 1 seconds less than the maximum backoff, so if the
 		// communication is still broken, the message will soon reappear.
-		view_message("     Error\n\n"
-				"Communication with MPD is broken.\n\n"
-				"Check if MPD is still running and reachable via LAN.",
-	 		(MPD_RETRY_TIMEOUT - 1) * TICKS_PER_SEC);
+		view_message(link_failure_text(), (MPD_RETRY_TIMEOUT - 1) * TICKS_PER_SEC);
 	};
 	
 	if (model_changed & PLAYLIST_EMPTY){
@@ -533,123 +642,627 @@ inform_view(int model_changed){
 
 /* ------------------------------ The Controller ----------------------------------------- */
 
+/* Values for cmd_proc_info.flags */
+
+/* The command only fetches information into one of the caches.
+	Several of these can be on their way to MPD at the same time. 
+*/
+#define CMD_PIPELINED	(1<<0)
+
+/* The command only sets an independent option of MPD.
+	Several of these are sent together in one command list (see model_batch_actions()).
+*/
+#define CMD_BATCH		(1<<1)
+
+/* The user waits for the answer, so the command is sent with high priority even if it is pipelined. */
+#define CMD_URGENT		(1<<2)
+
 /* This structure has info about how to process a command */
 struct cmd_proc_info {
 	char *format_string;								// string sent to mpd with %d and %s parameters substituted
- 	void (*process_line) (char *s, struct MODEL *a);	// function to be called for each answer line from MPD
+ 	void (*process_line) (int key, char *val, struct MODEL *a);	// function to be called for each answer line from MPD (see ans_key())
 	void (*process_ok) (struct MODEL *a);				// function to be called when MPD has answered with "OK"
 	void (*process_ack) (struct MODEL *a);				// function to be called when MPD has answered with "ACK"
+	int flags;											// CMD_PIPELINED etc.
+	uint8_t opcode;										// compact form for mpdtool (0 if there is none)
 };
 
 /* For each possible CMD the necessary cmd_proc_info
 	NOTE The order has to be the same as in enum USER_CMD
+	
+	When mpdtool tells us that it understands compact commands, we send the opcode and the numbers
+	instead of the format string (see compact_printf()). This saves a lot of airtime.
+	NOTE The opcodes have to be the same as in opcodes[] of mpdtool.c
 */
 static const struct cmd_proc_info cmd_info[] = {
-	{"", NULL, NULL, NULL},										// NO_CMD,
-	{"play %d\n", NULL, mpd_select_ok, mpd_select_ack},			// SEL_SONG,
-	{"", NULL, NULL, NULL},										// VOLUME_UP, done by setvol
-	{"", NULL, NULL, NULL},										// VOLUME_DOWN, done by setvol
-	{"", NULL, NULL, NULL},										// MUTE_CMD, done by setvol
-	{"setvol %d\n", NULL, mpd_volume_ok, NULL},					// VOLUME_NEW,
-	{"currentsong\n", ans_currentsong_line, mpd_currentsong_ok, NULL},		// CUR_SONG_CMD,
-	{"previous\n", NULL, mpd_newpos_ok, NULL}, 				// PREV_CMD,
-	{"next\n", NULL, mpd_newpos_ok, NULL},					// NEXT_CMD,
-	{"pause 1\n", NULL, mpd_state_ok, mpd_state_ack},		// PAUSE_ON,
-	{"pause 0\n", NULL, mpd_state_ok, mpd_state_ack},			// PAUSE_OFF,
-	{"play\n", NULL, mpd_state_ok, mpd_state_ack},					// PLAY_CMD,
-	{"stop\n", NULL, mpd_state_ok, mpd_state_ack},					// STOP_CMD,
-	{"seek %d %d\n", ans_status_line, mpd_status_ok, NULL}, 	//FORWARD_CMD,
-	{"seek %d %d\n", ans_status_line, mpd_status_ok, NULL},		//REWIND_CMD,
-	{"status\n", ans_status_line, mpd_status_ok, NULL},					// STATUS_CMD,
-	{"playlistinfo %d\n",ans_playlistinfo_line, mpd_playlistinfo_ok, mpd_playlistinfo_ack},		//PLINFO_CMD,
-	{"loadnew \"%s\"\n", ans_status_line, mpd_load_ok, NULL},			// LOAD_CMD,
-	{"random %d\n", NULL, mpd_random_ok, NULL},				// RANDOM_CMD,
-	{"repeat %d\n", NULL, mpd_repeat_ok, NULL},				// REPEAT_CMD,
-	{"single %d\n", NULL, mpd_single_ok, NULL},				// SINGLE_CMD,
-	{"playlistcount\n",	 ans_plcount_line, NULL, NULL},		// PLAYLISTCOUNT_CMD,
-	{"playlistname %d\n", ans_plname_line, NULL, NULL},		// PLAYLISTNAME_CMD,
-	{"clear\n", NULL, mpd_clear_ok, NULL},					// CLEAR_CMD,
-	{"search %s\n", ans_search_line, mpd_search_ok, mpd_search_ack},		// SEARCH_CMD,
-	{"result %d\n", ans_result_line, NULL, mpd_result_ack}, 				// RESULT_CMD,
-	{"findadd %s\n", ans_status_line, mpd_findadd_ok, NULL},	// FINDADD_CMD,
-	{"script %d\n", NULL, mpd_script_ok, NULL}				// SCRIPT_CMD
+	{"", NULL, NULL, NULL, 0, 0},										// NO_CMD,
+	{"play %d\n", NULL, mpd_select_ok, mpd_select_ack, 0, 0x80},			// SEL_SONG,
+	{"", NULL, NULL, NULL, 0, 0},										// VOLUME_UP, done by setvol
+	{"", NULL, NULL, NULL, 0, 0},										// VOLUME_DOWN, done by setvol
+	{"", NULL, NULL, NULL, 0, 0},										// MUTE_CMD, done by setvol
+	{"setvol %d\n", NULL, mpd_volume_ok, mpd_option_ack, CMD_BATCH, 0x81},					// VOLUME_NEW,
+	{"currentsong\n", ans_currentsong_line, mpd_currentsong_ok, NULL, 0, 0x82},		// CUR_SONG_CMD,
+	{"previous\n", NULL, mpd_newpos_ok, NULL, 0, 0x83}, 				// PREV_CMD,
+	{"next\n", NULL, mpd_newpos_ok, NULL, 0, 0x84},					// NEXT_CMD,
+	{"pause 1\n", NULL, mpd_state_ok, mpd_state_ack, 0, 0x85},		// PAUSE_ON,
+	{"pause 0\n", NULL, mpd_state_ok, mpd_state_ack, 0, 0x86},			// PAUSE_OFF,
+	{"play\n", NULL, mpd_state_ok, mpd_state_ack, 0, 0x87},					// PLAY_CMD,
+	{"stop\n", NULL, mpd_state_ok, mpd_state_ack, 0, 0x88},					// STOP_CMD,
+	{"seek %d %d\n", ans_status_line, mpd_status_ok, NULL, 0, 0x89}, 	//FORWARD_CMD,
+	{"seek %d %d\n", ans_status_line, mpd_status_ok, NULL, 0, 0x89},		//REWIND_CMD,
+	{"status\n", ans_status_line, mpd_status_ok, NULL, CMD_BATCH, 0x8A},					// STATUS_CMD,
+	{"playlistinfo %d\n",ans_playlistinfo_line, mpd_playlistinfo_ok, mpd_playlistinfo_ack, CMD_PIPELINED, 0x8B},		//PLINFO_CMD,
+	{"loadnew \"%s\"\n", ans_status_line, mpd_load_ok, NULL, 0, 0},			// LOAD_CMD,
+	{"random %d\n", NULL, mpd_random_ok, mpd_option_ack, CMD_BATCH, 0x8C},				// RANDOM_CMD,
+	{"repeat %d\n", NULL, mpd_repeat_ok, mpd_option_ack, CMD_BATCH, 0x8D},				// REPEAT_CMD,
+	{"single %d\n", NULL, mpd_single_ok, mpd_option_ack, CMD_BATCH, 0x8E},				// SINGLE_CMD,
+	{"playlistcount\n",	 ans_plcount_line, NULL, NULL, 0, 0x8F},		// PLAYLISTCOUNT_CMD,
+	{"playlistname %d\n", ans_plname_line, NULL, NULL, CMD_PIPELINED, 0x90},		// PLAYLISTNAME_CMD,
+	{"clear\n", NULL, mpd_clear_ok, NULL, 0, 0x91},					// CLEAR_CMD,
+	{"search %s\n", ans_search_line, mpd_search_ok, mpd_search_ack, CMD_PIPELINED | CMD_URGENT, 0},		// SEARCH_CMD,
+	{"result %d\n", ans_result_line, NULL, mpd_result_ack, CMD_PIPELINED, 0x92}, 				// RESULT_CMD,
+	{"findadd %s\n", ans_status_line, mpd_findadd_ok, NULL, 0, 0},	// FINDADD_CMD,
+	{"script %d\n", NULL, mpd_script_ok, NULL, 0, 0x93},				// SCRIPT_CMD
+	{"compact\n", ans_compact_line, mpd_compact_ok, mpd_compact_ack, 0, 0},	// COMPACT_CMD
+	{"playlistinfo %d\n", ans_currentsong_line, mpd_nextsong_ok, NULL, CMD_PIPELINED, 0x8B},	// NEXTSONG_CMD
+	{"plchanged %d %d %d\n", ans_plchanges_line, mpd_plchanges_ok, mpd_plchanges_ack, CMD_PIPELINED, 0x94},	// PLCHANGES_CMD
+	{"plfind %d %s\n", ans_playlistinfo_line, mpd_plfind_ok, mpd_plfind_ack, 0, 0},		// PLFIND_CMD
+	{"jumpindex %d\n", ans_jumpindex_line, mpd_jumpindex_ok, mpd_jumpindex_ack, CMD_PIPELINED, 0x95}	// JUMPINDEX_CMD
 };	
 
 
-/* Some action (Communication with MPD) is needed. Start this action.
-	Here we construct the string which must be sent to MPD and then
-	we spawn a new protothread (handle_cmd()) which sends this string to MPD
-	and processes the received answer. 
-*/
-static
-PT_THREAD (exec_action(struct pt *pt, struct MODEL *ans_model) ){
-	static struct pt child_pt;
-	static char cmd_str[255];			// maximum that rf.c can handle
-	static int tries;
-	const int max_tries = 2;		// NOTE is this value good, should we retry at all?
-	static int response_finished;	// is set by collect_lines if MPD response terminated correctly (OK or ACK)
+/* ------------------------------ Outstanding requests ----------------------------------------- */
+
+/* We do not wait for the answer of one request before sending the next one.
+	Up to MAX_PENDING requests can be on their way to MPD.
+	Each request gets a tag (a small number), which is sent in front of the command: "#12 playlistinfo 5\n"
+	mpdtool handles the commands one after the other and sends a line "#12" in front of the answer.
+	So we know which request the following lines up to "OK" or "ACK" belong to.
+	Answers with an unknown tag are belated answers to requests that we have already given up. They are ignored.
 	
-	PT_BEGIN(pt);
+	Only commands with the CMD_PIPELINED flag are sent while other requests are outstanding.
+	All other commands change the state of MPD and the model can only decide about the next command 
+	when it knows the outcome. They are sent alone.
+	A search is pipelined, because the user types on while it runs. mpdtool drops a search
+	when a newer one waits behind it, and the model ignores the answers to older ones.
+	
+	Commands with the CMD_BATCH flag are independent of each other. All of them that the model
+	wants at the moment are sent as one request in a command list:
+		"command_list_ok_begin\nrandom 1\nrepeat 0\nstatus\ncommand_list_end\n"
+	MPD answers each command with "list_OK", the whole list ends with "OK".
+	With "ACK" MPD stops executing the list. The remaining commands are not done,
+	so the model will ask for them again.
+*/
+#define MAX_PENDING 3
+
+/* Tags run from 0 to MAX_TAG - 1 */
+#define MAX_TAG 100
+
+/* Maximum number of commands sent together in one command list */
+#define MAX_BATCH 5
+
+/* How often do we send a request before we give up? */
+#define MAX_TRIES 2
+
+/* We should receive all the answers in a relatively short time frame, else something went wrong anyway 
+	Searching takes somewhat longer, so we are waiting around 2 seconds.
+	The time is counted from the last line that we received, so requests queued behind a slow one
+	do not time out too early. The same holds for requests that waited in rf.c for airtime.
+*/
+#define REQUEST_TIMEOUT (22 * TICKS_PER_TENTH_SEC)
+
+struct request_slot {
+	uint8_t busy;				// 1 iff we are waiting for the answer to this request
+	uint8_t tag;				// tag of the request, mpdtool echoes it in front of the answer
+	uint8_t tries;				// how often we have sent this request
+	unsigned int sent;			// system time when the request was sent
+	uint8_t num_req;			// number of commands in req[], more than 1 means a command list
+	uint8_t cur_req;			// index of the command which the current answer lines belong to
+	UserReq req[MAX_BATCH];		// the commands sent with this request
+	struct MODEL ans;			// the current command and the information gathered from its answer
+};
+
+static struct request_slot pending[MAX_PENDING];
+
+/* number of busy entries in pending[] */
+static int num_pending;
+
+/* The tag for the next request */
+static uint8_t next_tag;
+
+/* system time when we last received a line from MPD */
+static unsigned int last_line_time;
 
-	slprintf(cmd_str, cmd_info[ans_model->request.cmd].format_string, &(ans_model->request), sizeof(cmd_str));
+/* The request the current answer lines belong to (NULL if we do not know) */
+static struct request_slot *cur_slot;
 
-	for (tries = 0; tries < max_tries; tries++){	
+
+/* Stores the commands of the request r in their compact form in dst.
+	mpdtool knows that several commands in one request are a command list.
+	Returns 0 iff this is not possible, dst must then be filled with the plain text commands.
+*/
+static int
+compact_request(struct request_slot *r, char *dst, int size){
+	const struct cmd_proc_info *ci;
+	int i, n, len = 0;
+	
+	if (1 != compact_link)
+		return 0;
 		
-		/* NOTE after acquiring exclusive access to mpd we should initialize line_ready, 
-				because we don't want old answers to fool this routine 
-			This is not so easy. We need a kind of flush_rx_buffer() routine.
-			And even then there could come some belated answers from MPD after the flushing.
-			This problem rarely happens, because we always wait some time after sending commands to 
-			MPD. So we simply ignore it here.
-		*/
-		model_reset(ans_model);
-		send_cmd(cmd_str);
-		dbg(cmd_str);
+	for (i=0; i < r->num_req; i++){
+		ci = &cmd_info[r->req[i].cmd];
+		n = 0;
+		if (ci->opcode)
+			n = compact_printf(dst + len, ci->opcode, ci->format_string, &(r->req[i]), size - len);
+		if (0 == n){
+			dst[0] = 0;
+			return 0;
+		};
+		len += n;
+	};
+	return 1;
+};
 
-		/* This thread collects all information from mpd and sets response_finished. 
-			It will time out after a short period.
-		*/
-		PT_SPAWN(pt, &child_pt, collect_lines(&child_pt, 
-				cmd_info[ans_model->request.cmd].process_line,
-				cmd_info[ans_model->request.cmd].process_ok,
-				cmd_info[ans_model->request.cmd].process_ack,
-				ans_model,
-				&response_finished));
-	
-		if (response_finished){							// Our cmd got an OK or ACK
-			model_set_last_response (system_time());
-			break;
+/* The request in r is finished, either by an answer or because we gave up.
+	If the answer did not contain what we asked for, the model will ask again.
+*/
+static void
+end_request(struct request_slot *r){
+	int i;
 	
-		} else {
-			// MPD did not give a valid response, try sending again
-				debug_out("Retry ",tries);
+	for (i=0; i < r->num_req; i++)
+		model_request_lost(&(r->req[i]));
+	model_reset(&(r->ans));					// gives the strings of the answer back to the pool
+	r->busy = 0;
+	num_pending--;
+	if (cur_slot == r)
+		cur_slot = NULL;
+};
+
+/* Sends the request in r (again) with a new tag */
+static void
+send_request(struct request_slot *r){
+	static char cmd_str[255];			// maximum that rf.c can handle
+	char num_string[12];
+	int i, len;
+
+	r->tag = next_tag;
+	next_tag = (next_tag + 1) % MAX_TAG;
+	
+	strlcpy(cmd_str, "#", sizeof(cmd_str));
+	strlcat(cmd_str, get_digits(r->tag, num_string, 0), sizeof(cmd_str));
+	len = strlcat(cmd_str, " ", sizeof(cmd_str));
+	if (! compact_request(r, cmd_str + len, sizeof(cmd_str) - len)){
+		if (r->num_req > 1)
+			len = strlcat(cmd_str, "command_list_ok_begin\n", sizeof(cmd_str));
+		for (i=0; i < r->num_req; i++){
+			slprintf(cmd_str + len, cmd_info[r->req[i].cmd].format_string, &(r->req[i]), sizeof(cmd_str) - len);
+			len = strlen(cmd_str);
 		};
+		if (r->num_req > 1)
+			strlcat(cmd_str, "command_list_end\n", sizeof(cmd_str));
+	};
+
+	if (cur_slot == r)
+		cur_slot = NULL;				// forget a partial answer
+	r->cur_req = 0;
+	model_reset(&(r->ans));
+	r->ans.request = r->req[0];
+	r->tries++;
+	r->sent = system_time();
+	/* Filling the caches can wait, the user should not */
+	if (! send_cmd(cmd_str, ((cmd_info[r->req[0].cmd].flags & (CMD_PIPELINED | CMD_URGENT)) == CMD_PIPELINED) ? RF_PRIO_LOW : RF_PRIO_HIGH)){
+		/* rf.c has no room for it. The model asks again when the queue is empty (see request_ready()). */
+		debug_out("Not sent ", r->tag);
+		end_request(r);
+		return;
 	};
+	dbg(cmd_str);
+};
+
+/* Takes a free slot for the num commands in req[] and sends them */
+static void
+start_request(UserReq *req, int num){
+	int i, n;
+	
+	for (i=0; i < MAX_PENDING; i++)
+		if (! pending[i].busy){
+			pending[i].busy = 1;
+			pending[i].tries = 0;
+			for (n=0; n < num; n++)
+				pending[i].req[n] = req[n];
+			pending[i].num_req = num;
+			num_pending++;
+			send_request(&pending[i]);
+			return;
+		};
+};
+
+/* Returns the outstanding request with the given tag or NULL */
+static struct request_slot *
+find_request(int tag){
+	int i;
+	
+	for (i=0; i < MAX_PENDING; i++)
+		if ( pending[i].busy && (pending[i].tag == tag) )
+			return &pending[i];
+	return NULL;
+};
+
+/* Returns TRUE iff a command is outstanding that must be sent alone */
+static int
+exclusive_pending(){
+	int i;
+	
+	for (i=0; i < MAX_PENDING; i++)
+		if ( pending[i].busy && !(cmd_info[pending[i].req[0].cmd].flags & CMD_PIPELINED) )
+			return 1;
+	return 0;
+};
+
+/* ------------------------------ Link health ----------------------------------------- */
+
+/* Our requests travel over 3 hops: radio to the scart adapter, serial line to mpdtool and LAN to MPD.
+	When something is broken, we want to tell the user which hop it is, and we want to know it fast.
+	- mpdtool answers "ACK [mpd-unreachable]" or "ACK [mpd-timeout]" when it gets no answer from MPD.
+	- The scart adapter answers a single ENQ itself with "scart: V<version>", mpdtool does not see it.
+	- While MPD is busy, mpdtool sends "wait: <seconds>" every second, so a request is only late
+	  if mpdtool does not work on it or its answer got lost.
+	  When a request is late, we send this probe. If the scart adapter does not answer,
+	  the radio link or the scart adapter is broken. Else we retry the request.
+	  If the retry is late again and we have not heard from mpdtool since we sent it, mpdtool is not running.
+	  If we have heard from mpdtool, the answer was lost on a lossy radio link. Then only this request is 
+	  given up, the model asks again later.
 	
-	if (tries >= max_tries) {
-		debug_out("No answer ", 1);
-		model_check_mpd_dead();
-		// TODO If MPD is not dead, we should tell the model that we did not get
-		// an answer.
-		// We really have 2 kind of commands.
-		// - Single shot: Issue the command. If it was OK, change something in the model.
-		// 				If it was ACK or no answer, do not try it again (set the user wish to
-		//				be fulfilled anyway). It is the responsibility of the user to re-issue
-		//				that command if he really wants to.
-		//				Example: "play" command when there is no current song. Will get an ACK.
-		//						No need to try again, because it will get the same answer repeatedly.
-		//						Could inform the user "currently not possible"
-		//	- Indispensable: We absolutely need this request to be executed, else we can not proceed.
-		//				Example: "playlistname" command. We can not show all available playlists when 
-		//						we can not get their names. The "All playlists" screen does not work.
-		//						Retry this command until it works or MPD is dead.
-		//  Currently we can distinguish these 2 kind of commands in model.c
-		//  Commands of the first kind are reset to "wish fulfilled" as soon as they are issued.
-		//  The other kind of commands are reset only after an "OK" answer.
-		//  This works quite well, and maybe need not be changed. But it should be applied consistently!
+	The scart adapter and mpdtool can not send heartbeats on their own, because the radio link is half duplex
+	and only Betty knows when it listens. So our regular status command is the heartbeat,
+	and the probe is only sent when a request fails.
+
+	After a failure we give up all outstanding requests and send nothing for some time (backoff).
+	The backoff doubles with each failure up to MPD_RETRY_TIMEOUT seconds. Any answer from MPD ends it.
+*/
+enum LINK_STATE {LINK_OK, LINK_RADIO, LINK_MPDTOOL, LINK_MPD};
+
+/* How long do we wait for the answer of the scart adapter to our probe? */
+#define PROBE_TIMEOUT	(8 * TICKS_PER_TENTH_SEC)
+
+#define MIN_BACKOFF		(2 * TICKS_PER_SEC)
+#define MAX_BACKOFF		(MPD_RETRY_TIMEOUT * TICKS_PER_SEC)
+
+static enum LINK_STATE link_state;		// the hop that failed last, LINK_OK if none
+static uint8_t probing;					// 1 iff we wait for the answer of the scart adapter
+static unsigned int probe_sent;			// system time when we sent the probe
+static unsigned int scart_seen;			// system time when the scart adapter last answered a probe
+static unsigned int backoff;			// current backoff in ticks, 0 if we do not back off
+static unsigned int mpdtool_seen;		// system time when we last got a line from mpdtool
+static unsigned int backoff_start;		// system time when the current backoff started
+
+static char *
+link_failure_text(){
+	switch (link_state){
+		case LINK_RADIO:
+			return "     Error\n\n"
+				"No answer from the scart adapter.\n\n"
+				"Check if it is powered and within range.";
+		case LINK_MPDTOOL:
+			return "     Error\n\n"
+				"The scart adapter answers, but mpdtool does not.\n\n"
+				"Check if mpdtool is running.";
+		default:
+			return "     Error\n\n"
+				"mpdtool can not reach MPD.\n\n"
+				"Check if MPD is still running and reachable via LAN.";
+	};
+};
+
+/* Sends a single ENQ which the scart adapter answers itself */
+static void
+send_probe(){
+	static char probe[] = {ENQ, 0};
+	
+	if (! send_cmd(probe, RF_PRIO_HIGH))
+		return;							// no room in rf.c, check_timeouts() tries again
+	probing = 1;
+	probe_sent = system_time();
+};
+
+/* The hop s is broken. Give up all outstanding requests and back off. */
+static void
+link_failed(enum LINK_STATE s){
+	int i;
+	
+	debug_out("Link failed ", s);
+	link_state = s;
+	probing = 0;
+	for (i=0; i < MAX_PENDING; i++)
+		if (pending[i].busy)
+			end_request(&pending[i]);
+	// TODO We really have 2 kind of commands.
+	// - Single shot: Issue the command. If it was OK, change something in the model.
+	// 				If it was ACK or no answer, do not try it again (set the user wish to
+	//				be fulfilled anyway). It is the responsibility of the user to re-issue
+	//				that command if he really wants to.
+	//				Example: "play" command when there is no current song. Will get an ACK.
+	//						No need to try again, because it will get the same answer repeatedly.
+	//						Could inform the user "currently not possible"
+	//	- Indispensable: We absolutely need this request to be executed, else we can not proceed.
+	//				Example: "playlistname" command. We can not show all available playlists when 
+	//						we can not get their names. The "All playlists" screen does not work.
+	//						Retry this command until it works or MPD is dead.
+	//  Currently we can distinguish these 2 kind of commands in model.c
+	//  Commands of the first kind are reset to "wish fulfilled" as soon as they are issued.
+	//  The other kind of commands are reset only after an "OK" answer.
+	//  This works quite well, and maybe need not be changed. But it should be applied consistently!
+
+	if (0 == backoff)
+		backoff = MIN_BACKOFF;
+	else
+		backoff = min(2 * backoff, MAX_BACKOFF);
+	backoff_start = system_time();
+	model_mpd_dead();
+};
+
+/* We got an answer from MPD, so all hops are working */
+static void
+link_ok(){
+	link_state = LINK_OK;
+	backoff = 0;
+};
+
+/* Returns TRUE iff we must not send requests now */
+static int
+link_blocked(){
+	if (probing)
+		return 1;
+	if ( backoff && ((system_time() - backoff_start) < backoff) )
+		return 1;
+	return 0;
+};
+
+/* Returns TRUE iff the scart adapter has answered our last probe */
+static int
+scart_answered(){
+	return (scart_seen - probe_sent < PROBE_TIMEOUT);
+};
+
+/* Returns TRUE iff we know the outcome of our probe */
+static int
+probe_finished(){
+	return probing && ( scart_answered() || (system_time() - probe_sent > PROBE_TIMEOUT) );
+};
+
+/* Returns TRUE iff we do not wait for any answer, so the radio may sleep */
+int
+mpd_link_idle(){
+	return ( (0 == num_pending) && (! probing) );
+};
+
+/* Returns the number of commands that we should send now as one request. The commands are then stored in req[].
+	Else it returns 0 and req[0].cmd is NO_CMD. 
+*/
+static int
+request_ready(UserReq *req){
+	req->cmd = NO_CMD;
+	
+	if (link_blocked())
+		return 0;
+	
+	/* rf.c is waiting for airtime. We keep our wishes until it is available. */
+	if (rf_tx_queued())
+		return 0;
+	
+	/* First of all we want to know if mpdtool understands compact commands */
+	if (compact_link < 0){
+		if (num_pending > 0)
+			return 0;
+		req->cmd = COMPACT_CMD;
+		return 1;
+	};
+	
+	if (num_pending > 0) {
+		/* We do not disturb a packet that is coming in. There is an answer for us anyway. */
+		if ( (num_pending >= MAX_PENDING) || exclusive_pending() || rf_rx_active() )
+			return 0;
+	};
+	
+	/* Ask the model only now, because it marks pipelined requests as requested */
+	if (! action_needed(req))
+		return 0;
+	
+	if (cmd_info[req->cmd].flags & CMD_PIPELINED)
+		return 1;
+	
+	if (num_pending > 0) {
+		req->cmd = NO_CMD;				// wait until the outstanding requests are finished
+		return 0;
+	};
+
+	/* Collect all the other independent wishes of the user */
+	if (cmd_info[req->cmd].flags & CMD_BATCH)
+		return max(1, model_batch_actions(req, MAX_BATCH));
+
+	return 1;
+};
+
+/* Returns TRUE iff the request in r has not been answered in time */
+static int
+request_late(struct request_slot *r){
+	unsigned int t;
+
+	t = r->sent;
+	if (last_line_time > t)
+		t = last_line_time;
+	if (rf_last_tx() > t)
+		t = rf_last_tx();			// the request may have waited in rf.c for airtime
+	return ( (system_time() - t) > REQUEST_TIMEOUT );
+};
+
+static int
+request_timed_out(){
+	int i;
+	
+	if (probing)
+		return probe_finished();
+	
+	for (i=0; i < MAX_PENDING; i++)
+		if ( pending[i].busy && request_late(&pending[i]) )
+			return 1;
+	return 0;
+};
+
+/* Retry or give up requests which got no answer in time */
+static void
+check_timeouts(){
+	int i;
+	struct request_slot *r;
+	
+	if (probing){
+		if (! probe_finished())
+			return;
+		probing = 0;
+		if (! scart_answered()){
+			link_failed(LINK_RADIO);
+			return;
+		};
 		
+		/* The radio link works, so we try again.
+			Nothing was sent while probing, and the probe and its answer count as traffic in request_late(),
+			so all requests which are still outstanding are the late ones.
+		*/
+		for (i=0; i < MAX_PENDING; i++){
+			r = &pending[i];
+			if (! r->busy)
+				continue;
+				
+			if (r->tries >= MAX_TRIES) {
+				if (mpdtool_seen < r->sent){
+					link_failed(LINK_MPDTOOL);		// not a word from mpdtool since the retry
+					return;
+				};
+				/* Only this request is given up, the model asks again for what it still needs */
+				debug_out("Lost ", r->tag);
+				end_request(r);
+				continue;
+			};
+			debug_out("Retry ", r->tries);
+			send_request(r);
+		};
+		return;
+	};
+	
+	for (i=0; i < MAX_PENDING; i++){
+		r = &pending[i];
+		if ( !(r->busy && request_late(r)) )
+			continue;
+
+		/* MPD did not give a valid response, first find out if the radio link works */
+		debug_out("No answer ", r->tries);
+		send_probe();
+		return;
 	};
+};
+
+
+/* MPD has answered the request r completely */
+static void
+request_answered(struct request_slot *r){
+	model_set_last_response(system_time());
+	link_ok();
+	end_request(r);
+};
+
+/* ### Answer dispatching task ###
+	Started once. Never returns.
+	
+	Processes all lines received via radio.
+	A line "#<tag>" tells us which request the following lines belong to.
+	"OK" lines are processed with the function process_ok() of that request.
+	"ACK" lines are processed with the function process_ack() of that request.
+	Both finish the request.
+	In a command list "list_OK" lines are processed with the function process_ok() of the current command,
+	the following lines belong to the next command of the list.
+	All other lines are processed with the function process_line() of the current command.
+	The functions interpret the answer and change the model if appropriate.
+	Any of these functions can be NULL.
+	
+	A line "ACK [mpd-..." comes from mpdtool, which could not get an answer from MPD.
+	A line "wait: ..." comes from mpdtool, which still waits for MPD.
+	A line "scart: ..." is the answer of the scart adapter to our probe (see Link health).
 	
+	Lines which we can not attribute to a request are ignored.
+*/
+PT_THREAD (dispatch_lines(struct pt *pt)){
+	const struct cmd_proc_info *ci;
+	struct request_slot *r;
+	int key;
+	char *val;
+	
+	PT_BEGIN(pt);
+	while (1){
+		PT_WAIT_UNTIL(pt, PT_SEM_CHECK(&line_ready));
+		last_line_time = system_time();
+		r = cur_slot;
+		key = ans_key(response, &val);
+		if (K_SCART != key)
+			mpdtool_seen = last_line_time;		// all other lines come through mpdtool
+		
+		if (K_TAG == key){
+			if (NULL != r)
+				model_reset(&(r->ans));		// mpdtool has cut off this answer, its strings go back to the pool
+			cur_slot = find_request(atoi(val));
+			if (NULL == cur_slot)
+				dbg("belated answer ignored");
+		
+		} else if (K_SCART == key){
+			/* The scart adapter answered our probe */
+			scart_seen = system_time();
+		
+		} else if (K_WAIT == key){
+			/* mpdtool still waits for MPD. The line has put off the deadline of our requests. */
+		
+		} else if ( (NULL != r) && (K_ACK == key) && strstart(val, " [mpd-") ){
+			/* mpdtool could not get an answer from MPD */
+			link_failed(LINK_MPD);
+		
+		} else if ( (NULL != r) && (r->cur_req >= r->num_req) ){
+			/* All commands of the list are done, only the final "OK" is missing */
+			if ( (K_OK == key) || (K_ACK == key) )
+				request_answered(r);
+			
+		} else if (NULL != r){
+			ci = &cmd_info[r->ans.request.cmd];
+			
+			if ( r->ans.str_lost && ((K_LIST_OK == key) || (K_OK == key)) ){
+				/* A string is missing. The model does not get the answer and asks again for what it still needs. */
+				debug_out("String lost ", r->tag);
+				request_answered(r);
+			
+			} else if (K_LIST_OK == key) {
+				if (ci->process_ok) 
+					ci->process_ok(&(r->ans));
+				r->cur_req++;
+				model_reset(&(r->ans));
+				if (r->cur_req < r->num_req)
+					r->ans.request = r->req[r->cur_req];
+			
+			} else if (K_OK == key) {
+				if (ci->process_ok) 
+					ci->process_ok(&(r->ans));
+				request_answered(r);
+			
+			} else if (K_ACK == key){
+				pool_set(&(r->ans.errmsg), val, ERRMSG_LEN);
+				if (ci->process_ack) 
+					ci->process_ack(&(r->ans));
+				request_answered(r);
+			
+			} else if (ci->process_line)
+				/* gather information from response line by the given function */
+				ci->process_line(key, val, &(r->ans));
+		};
+		
+		PT_SEM_INIT(&line_ready, 0);	// Tell producer that we consumed the line
+	};
 	PT_END(pt);
 };
 
@@ -699,52 +1312,51 @@ PT_THREAD (exec_action(struct pt *pt, struct MODEL *ans_model) ){
 	- Start actions if they are needed
 	- Show current status on screen
 	
-	Starts a thread to handle sending commands to mpd (handle_cmd).
 	Starts a thread to assemble a complete line from mpd rf ring buffer (assemble_line).
+	Starts a thread to hand the answer lines to the requests they belong to (dispatch_lines).
 	
 	Main loop:
 	Waits for a necessary action or a change in the model
-	and executes the action and informs the view accordingly.
+	and sends the request and informs the view accordingly.
 	
 */
 PT_THREAD (controller(struct pt *pt)){
-	static struct pt child_pt;
 
-	/* We gather the request and some information from the responses in this variable: */
-	static struct MODEL ans_model;
+	/* The next request that we want to send to MPD */
+	static UserReq request[MAX_BATCH];
+	static int num_req;
 	
 	PT_BEGIN(pt);
 
 	/* At start of program we should have no response line from mpd */
 	PT_SEM_INIT(&line_ready, 0);
 	task_add(&assemble_line);
-	
+	task_add(&dispatch_lines);
 
 	/* The main loop of the controller.
 		- Simply wait if nothing to do.
-		- If there is some action to do, spawn a new protothread which starts the action (function exec_action() ).
-			Then wait until that protothread finished.
+		- If there is some action to do and we may send another request, send it.
+			The answer is handled by dispatch_lines(), we do not wait for it here.
+		- If a request was not answered in time, send it again or give up.
 		- If there is some change in the model, call the function inform_view().
 	*/
 	while (1) {
 		/* This is a bit tricky. 
-			We have two different conditions on which we must react. We must send a command to mpd when action_needed() is TRUE.
+			We have different conditions on which we must react. We must send a command to mpd when request_ready() is TRUE.
 			And we must change the view when model_get_changed() is TRUE.
-			We want to call action_needed() only once for reasons of efficiency, so we have to know the value of action_needed() 
+			We want to call action_needed() only once for reasons of efficiency, so we have to know the value of request_ready() 
 			after the WAIT is finished.
-		 	Therefore action_needed() sets its parameter request to a valid command when it is TRUE or to NO_CMD when it is FALSE.	
-			We have to call action_needed first here so that request is set correctly in any case.
-			TODO maybe it's more logical to have two threads, one for communication and the other to change the view
-				Maybe that could lead to race conditions ?
+		 	Therefore request_ready() sets its parameter request to valid commands when it is TRUE or to NO_CMD when it is FALSE.	
+			We have to call request_ready() first here so that request is set correctly in any case.
 		*/
-		PT_WAIT_UNTIL(pt, ( action_needed(&ans_model.request) || model_get_changed()) );
-
+		PT_WAIT_UNTIL(pt, ( (num_req = request_ready(request)) || model_get_changed() || request_timed_out() ) );
 	
-		if ( ans_model.request.cmd != NO_CMD ){
-			PT_SPAWN( pt, &child_pt, exec_action(&child_pt, &ans_model) );
+		if ( num_req > 0 ){
+			start_request(request, num_req);
 			PT_YIELD(pt);
 		};
 		
+		check_timeouts();
 
 		if ( model_get_changed() ) {
 			inform_view(model_get_changed());
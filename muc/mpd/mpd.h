@@ -56,7 +56,12 @@ enum USER_CMD {
 	SEARCH_CMD,
  	RESULT_CMD,
   	FINDADD_CMD,
- 	SCRIPT_CMD
+ 	SCRIPT_CMD,
+	COMPACT_CMD,
+	NEXTSONG_CMD,
+	PLCHANGES_CMD,
+	PLFIND_CMD,
+	JUMPINDEX_CMD
 };
 
 
@@ -69,6 +74,7 @@ typedef struct {
 	enum USER_CMD cmd;
 	int arg;
 	int arg2;
+	int arg3;
 	char *str;
 } UserReq;
 
@@ -77,6 +83,7 @@ PT_THREAD (controller(struct pt *pt));
 
 
 int mpd_get_song();
+int mpd_link_idle();
 void model_init();
 int slprintf(char *dst, const char *src, UserReq *f, int size);
 
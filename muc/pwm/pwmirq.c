@@ -167,6 +167,12 @@ pwmM2IRQ (void){
 #define BL_NORM_BRIGHT	48
 
 
+/* Returns TRUE iff the user has not touched the remote for some time (the backlight is dimming) */
+int
+user_inactive(){
+	return (inactivity_cnt >= max_inactivity);
+};
+
 PT_THREAD (backl_proc(struct pt *pt)) {
 	static struct timer tmr;
 	
@@ -22,6 +22,7 @@
 extern unsigned int inactivity_cnt;
 
 void startPWMIRQ(void);
+int user_inactive(void);
 PT_THREAD (backl_proc(struct pt *pt));
  
 #endif
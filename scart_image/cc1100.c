@@ -124,7 +124,29 @@ spi_rw(unsigned char write) {
 	return(write);  
 }
 
-static unsigned char 
+/* Write 1 byte to spi interface without reading.
+	The loop of spi_rw() is unrolled, this is about twice as fast.
+	Used for the data bytes of burst writes.
+*/
+#define SPI_W_BIT(mask) \
+	SCK = 0; \
+	MOSI1 = (write & (mask)) ? 1 : 0; \
+	SCK = 1;
+
+void
+cc1100_burst_byte(unsigned char write) {
+	SPI_W_BIT(0x80)
+	SPI_W_BIT(0x40)
+	SPI_W_BIT(0x20)
+	SPI_W_BIT(0x10)
+	SPI_W_BIT(0x08)
+	SPI_W_BIT(0x04)
+	SPI_W_BIT(0x02)
+	SPI_W_BIT(0x01)
+	SCK = 0;
+}
+
+unsigned char 
 cc1100_write(unsigned char addr, unsigned char* dat, unsigned char length) {
  
 	unsigned char i;
@@ -134,12 +156,29 @@ cc1100_write(unsigned char addr, unsigned char* dat, unsigned char length) {
 	while (MISO1);
 	status = spi_rw(addr | WRITE | BURST);
 	for (i=0; i < length; i++) 
-		spi_rw(dat[i]); 
+		cc1100_burst_byte(dat[i]); 
 	CS = 1;
  
 	return(status);
 } 
 
+/* Start a burst access to addr of cc1100.
+	Write the data bytes with cc1100_burst_byte() and finish with cc1100_burst_end().
+	For a burst read, give addr | READ and read the bytes with cc1100_burst_read().
+*/
+unsigned char 
+cc1100_burst_start(unsigned char addr) {
+	CS = 0;
+	while (MISO1);
+	return spi_rw(addr | WRITE | BURST);
+} 
+
+/* Read the next byte of a burst read */
+unsigned char 
+cc1100_burst_read(void) {
+	return spi_rw(0x00);
+}
+
 /* Write one data byte to addr of cc1100 */
 unsigned char 
 cc1100_write1(unsigned char addr, unsigned char dat) {
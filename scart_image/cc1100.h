@@ -116,6 +116,9 @@
 void cc1100_init(void);
 unsigned char cc1100_write(unsigned char addr, unsigned char* dat, unsigned char length);
 unsigned char cc1100_write1(unsigned char addr, unsigned char dat);
+unsigned char cc1100_burst_start(unsigned char addr);
+void cc1100_burst_byte(unsigned char write);
+unsigned char cc1100_burst_read(void);
 unsigned char cc1100_read1(unsigned char addr);
 unsigned char cc1100_strobe(unsigned char cmd);
 void switch_to_idle();
@@ -128,6 +131,9 @@ unsigned char cc1100_read_rxstatus();
 /* Write a single byte to the CC1100 TX_FIFO */
 #define cc1100_write_fifo(x) cc1100_write1(TX_fifo, (x))
 
+/* Finish a burst write */
+#define cc1100_burst_end() (CS = 1)
+
 /* read a single byte from the CC1100 RX_FIFO */
 #define cc1100_read_fifo() cc1100_read1(RX_fifo | READ)
 
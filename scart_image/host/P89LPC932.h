@@ -0,0 +1,88 @@
+/*
+    P89LPC932.h - special function registers for the host build of the scart adapter
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* The host include path puts this directory first, so this file replaces the header of SDCC.
+	Each SFR and each SFR bit that the firmware uses is a byte in host_sfr_regs[].
+	Every access goes through host_sfr(), which is called before the access is done.
+	So host_sfr() sees all previous writes. It counts the cycles of the access,
+	lets the CC1100 look at its pins and raises the serial interrupt (see scart_host.c).
+*/
+
+#ifndef P89LPC932_H
+#define P89LPC932_H
+
+/* The keywords of SDCC */
+#define __idata
+#define __data
+#define __xdata
+#define __code			const
+#define __bit			unsigned char
+#define __interrupt(n)
+
+enum HOST_SFR {
+	SFR_AUXR1, SFR_BRGCON, SFR_BRGR0, SFR_BRGR1, SFR_EA, SFR_ESR, SFR_EST,
+	SFR_P0, SFR_P0M1, SFR_P0M2, SFR_P1, SFR_P1M1, SFR_P1M2, SFR_P3, SFR_P3M1, SFR_P3M2,
+	SFR_RI, SFR_TI, SFR_SBUF, SFR_SCON, SFR_SSTAT,
+	SFR_RTCCON, SFR_RTCH, SFR_RTCL,
+	SFR_WDCON, SFR_WDL, SFR_WFEED1, SFR_WFEED2,
+	SFR_KB1, SFR_KB6, SFR_OCB, SFR_OCC, SFR_RST, SFR_P0_4,
+	NUM_SFR
+};
+
+extern volatile unsigned char host_sfr_regs[NUM_SFR];
+volatile unsigned char *host_sfr(enum HOST_SFR r);
+
+#define SFR(name)		(*host_sfr(SFR_##name))
+
+#define AUXR1			SFR(AUXR1)
+#define BRGCON			SFR(BRGCON)
+#define BRGR0			SFR(BRGR0)
+#define BRGR1			SFR(BRGR1)
+#define EA				SFR(EA)
+#define ESR				SFR(ESR)
+#define EST				SFR(EST)
+#define P0				SFR(P0)
+#define P0M1			SFR(P0M1)
+#define P0M2			SFR(P0M2)
+#define P1				SFR(P1)
+#define P1M1			SFR(P1M1)
+#define P1M2			SFR(P1M2)
+#define P3				SFR(P3)
+#define P3M1			SFR(P3M1)
+#define P3M2			SFR(P3M2)
+#define RI				SFR(RI)
+#define TI				SFR(TI)
+#define SBUF			SFR(SBUF)
+#define SCON			SFR(SCON)
+#define SSTAT			SFR(SSTAT)
+#define RTCCON			SFR(RTCCON)
+#define RTCH			SFR(RTCH)
+#define RTCL			SFR(RTCL)
+#define WDCON			SFR(WDCON)
+#define WDL				SFR(WDL)
+#define WFEED1			SFR(WFEED1)
+#define WFEED2			SFR(WFEED2)
+
+/* Port pins, see the table in main.c */
+#define KB1				SFR(KB1)		// CC1100 CSn
+#define KB6				SFR(KB6)		// CC1100 GDO0
+#define OCB				SFR(OCB)		// CC1100 MOSI
+#define OCC				SFR(OCC)		// CC1100 SCLK
+#define RST				SFR(RST)		// CC1100 MISO
+#define P0_4			SFR(P0_4)
+
+#endif
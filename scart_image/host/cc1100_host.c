@@ -0,0 +1,388 @@
+/*
+    cc1100_host.c - the CC1100 behind the bit banged SPI, for the host build of the scart adapter
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+	cc1100_pins() is called before each SFR access of the firmware. It looks at CSn, SCLK and MOSI
+	as the previous accesses have left them and decodes the SPI protocol bit by bit:
+	MOSI is sampled at the rising edge of SCLK, MISO changes at the falling edge.
+	Each recognized bit, byte and transfer is charged with the cycle costs of spi_rw() and its callers.
+
+	The radio part knows what the firmware uses: command strobes, the status byte, status registers,
+	both FIFOs, calibration and settling times, sending and receiving with the settings of cc1100.c
+	(variable length, address byte, 2 appended status bytes, IDLE after RX and TX).
+*/
+
+#include "P89LPC932.h"
+#include "cc1100.h"
+#include "host.h"
+
+#include <string.h>
+
+#define FIFO_SIZE		64
+
+/* Preamble and sync word, sent before the length byte */
+#define SYNC_BYTES		8
+/* CRC, sent after the payload */
+#define CRC_BYTES		2
+
+/* From the data sheet */
+#define CAL_US			720
+#define SETTLE_US		90
+
+/* Chip states in the status byte, bits 6:4 */
+enum {ST_IDLE, ST_RX, ST_TX, ST_FSTXON, ST_CAL, ST_SETTLE, ST_RX_OVFL, ST_TX_UNFL};
+
+struct cc1100_stats cc1100_stats;
+
+static cycles_t byte_time;
+
+static unsigned char regs[0x2F];
+static unsigned char tx_fifo[FIFO_SIZE], rx_fifo[FIFO_SIZE];
+static int tx_cnt, rx_cnt;
+
+static int state;
+static int next_state;				// ST_RX or ST_TX after calibration and settling, else ST_IDLE
+static cycles_t state_until;		// end of calibration or settling
+static cycles_t tx_start;			// the preamble of the packet in TX starts then
+
+/* The packet from Betty that is in the air */
+static unsigned char air[MAX_PKTLEN];
+static int air_len;					// 0 if none
+static int air_pos;					// bytes already in the RX FIFO
+static int air_synced;
+static cycles_t air_start;
+
+/* SPI */
+static unsigned char prev_cs = 1, prev_sck;
+static int bitcnt;
+static unsigned char in_shift, out_shift;
+static int xfer_pos;				// 0: next byte is a header
+static unsigned char addr, burst, reading;
+
+static unsigned char
+status_byte(int rd){
+	int n = rd ? rx_cnt : FIFO_SIZE - 1 - tx_cnt;
+
+	if (n > 15)
+		n = 15;
+	return (state << 4) | n;
+};
+
+static unsigned char
+marcstate(){
+	static const unsigned char m[] = {0x01, 0x0D, 0x13, 0x12, 0x08, 0x0C, 0x11, 0x16};
+	return m[state];
+};
+
+/* ------------------------------------ radio --------------------------------------------- */
+
+/* Enters state s after calibration (if running) and settling */
+static void
+go(int s){
+	if (state == ST_CAL){
+		next_state = s;
+		return;
+	};
+	state = ST_SETTLE;
+	next_state = s;
+	state_until = host_now + us_to_cycles(SETTLE_US);
+};
+
+static void
+sent(){
+	int len = tx_fifo[0] + 1;
+
+	cc1100_stats.tx_packets++;
+	cc1100_stats.air_time += host_now - tx_start;
+	cc1100_stats.tx_bytes += len - 2;
+	host_radio_out(tx_fifo + 2, len - 2);
+	memmove(tx_fifo, tx_fifo + len, tx_cnt - len);
+	tx_cnt -= len;
+	state = ST_IDLE;
+};
+
+static void
+strobe(unsigned char cmd){
+	switch (cmd){
+		case SRES:
+			memset(regs, 0, sizeof(regs));
+			tx_cnt = rx_cnt = 0;
+			state = ST_IDLE;
+			break;
+		case SCAL:
+			if (state == ST_IDLE){
+				state = ST_CAL;
+				next_state = ST_IDLE;
+				state_until = host_now + us_to_cycles(CAL_US);
+			};
+			break;
+		case SRX:
+			if ( (state == ST_IDLE) || (state == ST_CAL) )
+				go(ST_RX);
+			break;
+		case STX:
+			if ( (state == ST_IDLE) || (state == ST_CAL) || (state == ST_RX) )
+				go(ST_TX);
+			break;
+		case SIDLE:
+			if (state == ST_TX)
+				cc1100_stats.tx_packets++;			// the packet is broken, count it anyway
+			state = ST_IDLE;
+			break;
+		case SFRX:
+			if ( (state == ST_IDLE) || (state == ST_RX_OVFL) ){
+				rx_cnt = 0;
+				state = ST_IDLE;
+			};
+			break;
+		case SFTX:
+			if ( (state == ST_IDLE) || (state == ST_TX_UNFL) ){
+				tx_cnt = 0;
+				state = ST_IDLE;
+			};
+			break;
+	};
+};
+
+static void
+rx_push(unsigned char x){
+	if (rx_cnt >= FIFO_SIZE){
+		cc1100_stats.rx_overflows++;
+		state = ST_RX_OVFL;
+		air_len = 0;
+		return;
+	};
+	rx_fifo[rx_cnt++] = x;
+};
+
+/* Betty starts to send a packet now. Returns 0 if a packet is still in the air. */
+int
+cc1100_air_in(unsigned char *payload, int len){
+	if (air_len)
+		return 0;
+	air[0] = len + 1;
+	air[1] = DEV_ADDR;
+	memcpy(air + 2, payload, len);
+	air_len = len + 2;
+	air_pos = 0;
+	air_synced = 0;
+	air_start = host_now;
+	return 1;
+};
+
+/* Returns TRUE iff a packet from Betty is in the air */
+int
+cc1100_receiving(){
+	return air_len;
+};
+
+static void
+receive(){
+	cycles_t sync = air_start + SYNC_BYTES * byte_time;
+	int n;
+
+	if (host_now < sync)
+		return;
+	if (! air_synced){
+		if (state != ST_RX){
+			cc1100_stats.rx_missed++;
+			air_len = 0;
+			return;
+		};
+		air_synced = 1;
+	};
+	if (state != ST_RX){					// reception was stopped
+		air_len = 0;
+		return;
+	};
+
+	n = (host_now - sync) / byte_time;
+	while ( (air_pos < n) && (air_pos < air_len) && air_len)
+		rx_push(air[air_pos++]);
+
+	if (air_len && (n >= air_len + CRC_BYTES)){
+		rx_push(0x40);						// RSSI
+		rx_push(0x80 | 0x20);				// CRC OK and LQI
+		if (state == ST_RX){
+			cc1100_stats.rx_packets++;
+			cc1100_stats.rx_bytes += air_len - 2;
+			state = ST_IDLE;
+		};
+		air_len = 0;
+	};
+};
+
+/* The chip takes the bytes out of the TX FIFO as they go on air.
+	The firmware may still fill it after STX, but each byte must be there in time.
+*/
+static void
+send(){
+	long need = (host_now - tx_start) / byte_time - SYNC_BYTES;	// bytes that have left the FIFO by now
+	int len;
+
+	if (need <= 0)
+		return;
+	if (tx_cnt == 0){
+		state = ST_TX_UNFL;
+		return;
+	};
+	len = tx_fifo[0] + 1;
+	if (((need < len) ? need : len) > tx_cnt){
+		state = ST_TX_UNFL;
+		return;
+	};
+	if (need >= len + CRC_BYTES)
+		sent();
+};
+
+/* Brings the radio up to host_now */
+void
+cc1100_update(){
+	if (state == ST_TX)
+		send();
+	if ( ((state == ST_CAL) || (state == ST_SETTLE)) && (host_now >= state_until) ){
+		switch (state){
+			case ST_CAL:
+				state = ST_IDLE;
+				if (next_state != ST_IDLE)
+					go(next_state);
+				break;
+			case ST_SETTLE:
+				state = next_state;
+				tx_start = host_now;
+				break;
+		};
+	};
+	if (air_len)
+		receive();
+};
+
+/* ------------------------------------ SPI --------------------------------------------- */
+
+/* A byte has been clocked in. Returns the byte to clock out next. */
+static unsigned char
+spi_byte(unsigned char in){
+	unsigned char a;
+
+	if (xfer_pos == 0){
+		reading = in & READ;
+		burst = in & BURST;
+		addr = in & 0x3F;
+		if ( (addr >= 0x30) && (addr <= 0x3D) && !burst ){
+			strobe(addr);
+			return status_byte(reading);
+		};
+		xfer_pos = 1;
+		if (! reading)
+			return status_byte(0);
+		if (addr == 0x3F)
+			return rx_cnt ? rx_fifo[0] : 0;
+		if (addr >= 0x30)
+			switch (addr | 0xC0){
+				case MARCSTATE:	return marcstate();
+				case TXBYTES:	return tx_cnt;
+				case RXBYTES:	return rx_cnt;
+				case PKTSTATUS:	return 0;
+				default:		return (addr == 0x31) ? CC1100_VERSION : 0;
+			};
+		return (addr < sizeof(regs)) ? regs[addr] : 0;
+	};
+
+	/* A data byte */
+	a = addr;
+	if (burst && (addr < 0x3E))
+		addr++;
+	if (! burst)
+		xfer_pos = 0;
+
+	if (reading){
+		if (a == 0x3F){
+			cc1100_stats.fifo_reads++;
+			if (rx_cnt > 0)
+				memmove(rx_fifo, rx_fifo + 1, --rx_cnt);
+			return rx_cnt ? rx_fifo[0] : 0;
+		};
+		return (addr < sizeof(regs)) ? regs[addr] : 0;
+	};
+
+	if (a == 0x3F){
+		cc1100_stats.fifo_writes++;
+		if (tx_cnt < FIFO_SIZE)
+			tx_fifo[tx_cnt++] = in;
+	} else if (a < sizeof(regs))
+		regs[a] = in;
+	return status_byte(0);
+};
+
+/* Looks at the pins as the firmware has left them. r is the SFR that the firmware accesses next.
+	spi_rw() reads MISO right after the rising edge of SCLK, the unrolled spi_w() goes on
+	with the next bit. So we know which one clocks the bit.
+*/
+void
+cc1100_pins(enum HOST_SFR r){
+	unsigned char cs = host_sfr_regs[SFR_KB1] & 1;
+	unsigned char sck = host_sfr_regs[SFR_OCC] & 1;
+	unsigned char mosi = host_sfr_regs[SFR_OCB] & 1;
+
+	if (cs){
+		prev_cs = 1;
+		prev_sck = sck;
+		host_sfr_regs[SFR_RST] = 1;
+		return;
+	};
+
+	if (prev_cs){									// start of a transfer
+		prev_cs = 0;
+		xfer_pos = 0;
+		bitcnt = 0;
+		out_shift = 0;								// CHIP_RDYn, the rest follows when we know R/W
+		host_sfr_regs[SFR_RST] = 0;
+		host_charge(cost.spi_xfer, CAT_SPI);
+	};
+
+	if (sck && !prev_sck){							// rising edge
+		in_shift = (in_shift << 1) | mosi;
+		bitcnt++;
+		host_charge((r == SFR_RST) ? cost.spi_bit : cost.spi_bit_w, CAT_SPI);
+		if ( (bitcnt == 1) && (xfer_pos == 0) )
+			out_shift = status_byte(mosi);			// the first bit of a header is R/W
+	};
+
+	if (!sck && prev_sck){							// falling edge
+		if (bitcnt == 8){
+			out_shift = spi_byte(in_shift);
+			bitcnt = 0;
+			host_charge(cost.spi_byte, CAT_SPI);
+		};
+		host_sfr_regs[SFR_RST] = (out_shift >> (7 - bitcnt)) & 1;
+	};
+	prev_sck = sck;
+};
+
+/* ------------------------------------ setup --------------------------------------------- */
+
+cycles_t
+cc1100_byte_time(){
+	return byte_time;
+};
+
+void
+cc1100_host_init(unsigned long radio_bps){
+	byte_time = us_to_cycles(1000000UL) * 8 / radio_bps;
+	state = ST_IDLE;
+	host_sfr_regs[SFR_RST] = 1;
+};
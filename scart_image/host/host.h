@@ -0,0 +1,72 @@
+/*
+    host.h - interfaces of the host build of the scart adapter
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HOST_H
+#define HOST_H
+
+/* The time is counted in machine cycles of the P89LPC932 since reset */
+typedef unsigned long long cycles_t;
+
+extern cycles_t host_now;
+
+/* Where the cycles go */
+enum COST_CAT {CAT_SPI, CAT_SERIAL, CAT_ISR, CAT_OTHER, NUM_CAT};
+
+/* The cycle cost model.
+	The host build only sees the accesses to SFRs. Each one costs sfr cycles.
+	The code between the accesses is charged to the events that the host can recognize.
+*/
+struct cost_model {
+	unsigned long clock_hz;			// oscillator
+	int clocks_per_cycle;			// 2 for the 80C51 core of the LPC900 family
+	int sfr;						// one access of an SFR or a port pin (setb, clr, jb, mov)
+	int spi_bit;					// rest of one loop of spi_rw(): shift, test, djnz
+	int spi_bit_w;					// rest of one bit of the unrolled spi_w(): test
+	int spi_byte;					// call and return of spi_rw()
+	int spi_xfer;					// call and return of cc1100_write1() and friends, CS handling
+	int isr;						// entry and exit of serial_isr(), buffer handling
+	int loop;						// one round of the main loop: calls and tests of all tasks
+};
+
+extern struct cost_model cost;
+
+void host_charge(int cycles, enum COST_CAT cat);
+cycles_t us_to_cycles(unsigned long us);
+
+/* scart_host.c: a packet was sent by the CC1100 */
+void host_radio_out(unsigned char *payload, int len);
+
+/* cc1100_host.c */
+void cc1100_host_init(unsigned long radio_bps);
+void cc1100_pins(enum HOST_SFR r);
+void cc1100_update(void);
+int cc1100_air_in(unsigned char *payload, int len);
+int cc1100_receiving(void);
+cycles_t cc1100_byte_time(void);
+
+struct cc1100_stats {
+	unsigned long tx_packets, tx_bytes;			// sent packets and their payload
+	unsigned long rx_packets, rx_bytes;			// received packets and their payload
+	unsigned long rx_missed;					// packets that started while we did not listen
+	unsigned long rx_overflows;
+	unsigned long fifo_writes, fifo_reads;		// bytes via SPI
+	cycles_t air_time;							// cycles we were sending
+};
+
+extern struct cc1100_stats cc1100_stats;
+
+#endif
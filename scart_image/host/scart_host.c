@@ -0,0 +1,498 @@
+/*
+    scart_host.c - runs the scart adapter firmware on the host and measures its throughput
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+	The unchanged main.c, serial.c and cc1100.c run against simulated SFRs (see P89LPC932.h).
+	The clock is the number of machine cycles that the firmware has used, according to the cost model.
+	Each SFR access advances it. Then the CC1100 (cc1100_host.c), the serial line and mpdtool
+	on the other end of it, and Betty on the other end of the radio catch up with that time.
+	The serial interrupt is raised between two SFR accesses when a byte has arrived.
+
+	Scenarios (each one starts from reset):
+		down	mpdtool sends a long answer, 16 bytes and ETX at a time, then EOT.
+				Betty only listens.
+		up		Betty sends packets of a given size with EOT. She sends the next one
+				when mpdtool has seen the EOT. mpdtool only reads.
+
+	For each scenario we report the throughput, how busy the serial line and the radio were,
+	where the cycles went and what one round of the main loop costs.
+	The rounds that move bytes (to the TX FIFO or from the RX FIFO) give the number of bytes
+	per second that the adapter can move at most, the busy rounds give what it sustains with its idle rounds.
+	The lowest of the limits of serial line, radio and adapter is what we could get at best.
+	How far below it we stay shows how much the three get in the way of each other
+	(waiting for ACK, radio deaf while the adapter drains the RX FIFO).
+*/
+
+#include "P89LPC932.h"
+#include "cc1100.h"
+#include "host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/* The firmware, main() is renamed by the Makefile */
+void scart_main(void);
+void serial_isr(void);
+void serial_tx_isr(void);
+
+#define ETX	0x03
+#define EOT	0x04
+#define ACK	0x06
+
+/* mpdtool sends so many bytes before it waits for an ACK, see send_to_serial() in mpdtool.c */
+#define MPDTOOL_PKTSIZE	16
+
+/* Betty needs this time between 2 packets: calibration, settling and filling her TX FIFO */
+#define BETTY_GAP_US	1000
+/* Betty gives up waiting for a packet to arrive after this time */
+#define BETTY_TIMEOUT_US	100000
+
+/* We give up after so much simulated time */
+#define TIME_LIM_SEC	120
+
+volatile unsigned char host_sfr_regs[NUM_SFR];
+cycles_t host_now;
+
+/* Estimated from the 80C51 instruction timing of the code that SDCC generates for cc1100.c and main.c */
+struct cost_model cost = {
+	7372800,		// clock_hz, internal RC oscillator
+	2,				// clocks_per_cycle
+	1,				// sfr
+	9,				// spi_bit
+	4,				// spi_bit_w
+	8,				// spi_byte
+	12,				// spi_xfer
+	70,				// isr
+	30				// loop
+};
+
+static unsigned long serial_baud = 115200;		// what mpdtool negotiates by default
+static unsigned long radio_bps = 38400;
+static unsigned long total_bytes = 20000;	// payload of a scenario
+static int pkt_size = 60;					// payload of Betty's packets, incl. EOT
+static unsigned long mpdtool_latency_us = 0;	// until mpdtool reacts to an ACK
+
+static jmp_buf finished;
+static int done;
+static cycles_t time_lim;
+static cycles_t start;				// the scenario starts then, after the adapter is up
+
+/* --------------------------------- cycle accounting ------------------------------------ */
+
+/* The interrupt routine that is running */
+enum {ISR_NONE, ISR_RX, ISR_TX};
+static int in_isr;
+static cycles_t cat_cycles[NUM_CAT];
+
+cycles_t
+us_to_cycles(unsigned long us){
+	return (cycles_t) us * (cost.clock_hz / cost.clocks_per_cycle) / 1000000UL;
+};
+
+static double
+cycles_to_sec(cycles_t c){
+	return (double) c * cost.clocks_per_cycle / cost.clock_hz;
+};
+
+void
+host_charge(int cycles, enum COST_CAT cat){
+	if (in_isr)
+		cat = CAT_ISR;
+	host_now += cycles;
+	cat_cycles[cat] += cycles;
+};
+
+/* Rounds of the main loop: where did they go? */
+enum {ROUND_TX, ROUND_RX, ROUND_IDLE, NUM_ROUND};
+static const char *round_names[NUM_ROUND] = {"copy to TX FIFO", "RX FIFO to serial", "idle"};
+static unsigned long rounds[NUM_ROUND];
+static cycles_t round_cycles[NUM_ROUND];
+static cycles_t round_start;
+static unsigned long round_writes, round_reads;
+
+/* feed_wd() is called once per round */
+static void
+round_done(){
+	int r;
+
+	if (cc1100_stats.fifo_writes != round_writes)
+		r = ROUND_TX;
+	else if (cc1100_stats.fifo_reads != round_reads)
+		r = ROUND_RX;
+	else
+		r = ROUND_IDLE;
+	rounds[r]++;
+	round_cycles[r] += host_now - round_start;
+	round_start = host_now;
+	round_writes = cc1100_stats.fifo_writes;
+	round_reads = cc1100_stats.fifo_reads;
+};
+
+/* ------------------------------------ serial line ------------------------------------ */
+
+static cycles_t ser_byte_time;
+
+/* mpdtool -> adapter */
+static unsigned char *down_data;
+static unsigned long down_len, down_pos;
+static int down_cnt;					// bytes since the last ETX
+static int wait_ack;
+static int etx_pending;
+static cycles_t down_next;				// the next byte is complete then, 0 if nothing on the line
+static cycles_t down_busy, ack_wait_start, ack_wait;
+static int rx_pending;					// a byte waits for the interrupt
+static unsigned char rx_sbuf;
+static unsigned long overruns;
+
+/* Betty waits for the EOT at mpdtool until then, see betty_update() */
+static cycles_t betty_next;
+
+/* adapter -> mpdtool
+	The UART is double buffered (DBMOD in SSTAT): a byte written to SBUF goes to the shift register
+	if it is free, else it waits in the transmit buffer. TI is set when the transmit buffer is free.
+*/
+static int tx_busy;						// the shift register sends tx_sbuf
+static int tx_full;						// tx_next waits in the transmit buffer
+static unsigned char tx_sbuf, tx_next;	// SBUF is shared with the receiver
+static cycles_t tx_done;
+static unsigned long up_serial_bytes, up_eots;
+static cycles_t up_busy;
+
+/* mpdtool puts the next byte on the line */
+static void
+down_start(cycles_t t){
+	if (wait_ack || ((down_pos >= down_len) && !etx_pending)){
+		down_next = 0;
+		return;
+	};
+	down_next = t + ser_byte_time;
+	down_busy += ser_byte_time;
+};
+
+static unsigned char
+down_byte(){
+	unsigned char x;
+
+	if (etx_pending){
+		etx_pending = 0;
+		wait_ack = 1;
+		ack_wait_start = host_now;
+		return ETX;
+	};
+	x = down_data[down_pos++];
+	if (++down_cnt >= MPDTOOL_PKTSIZE){
+		down_cnt = 0;
+		etx_pending = 1;
+	};
+	return x;
+};
+
+/* The adapter has sent x to mpdtool */
+static void
+up_byte(unsigned char x){
+	if (x == ACK){
+		if (wait_ack){
+			wait_ack = 0;
+			ack_wait += host_now - ack_wait_start;
+			down_start(host_now + us_to_cycles(mpdtool_latency_us));
+		};
+		return;
+	};
+	up_serial_bytes++;
+	if (x == EOT){
+		up_eots++;
+		betty_next = host_now + us_to_cycles(BETTY_GAP_US);
+	};
+};
+
+static void
+serial_update(){
+	if (tx_busy && (host_now >= tx_done)){
+		up_byte(tx_sbuf);
+		if (tx_full){
+			tx_full = 0;
+			tx_sbuf = tx_next;
+			tx_done += ser_byte_time;
+			host_sfr_regs[SFR_TI] = 1;
+		} else
+			tx_busy = 0;
+	};
+
+	if (down_next && (host_now >= down_next)){
+		if (rx_pending)
+			overruns++;
+		rx_sbuf = down_byte();
+		rx_pending = 1;
+		host_sfr_regs[SFR_RI] = 1;
+		down_start(down_next);
+	};
+
+	if (rx_pending && host_sfr_regs[SFR_EA] && host_sfr_regs[SFR_ESR]){
+		rx_pending = 0;
+		host_sfr_regs[SFR_SBUF] = rx_sbuf;
+		in_isr = ISR_RX;
+		host_charge(cost.isr, CAT_ISR);
+		serial_isr();
+		in_isr = ISR_NONE;
+	};
+
+	if (host_sfr_regs[SFR_TI] && host_sfr_regs[SFR_EA] && host_sfr_regs[SFR_EST]){
+		in_isr = ISR_TX;
+		host_charge(cost.isr, CAT_ISR);
+		serial_tx_isr();
+		in_isr = ISR_NONE;
+	};
+};
+
+/* ------------------------------------ the radio ------------------------------------ */
+
+/* Betty receives */
+static unsigned long betty_rx_bytes;
+
+void
+host_radio_out(unsigned char *payload, int len){
+	int i;
+
+	for (i=0; i<len; i++)
+		if (payload[i] == EOT)
+			done = 1;
+	betty_rx_bytes += len;
+};
+
+/* Betty sends. Like with a request, she sends the next packet when mpdtool has seen the EOT of the last one.
+	If it does not arrive in time, the packet was lost.
+*/
+static unsigned long betty_tx_bytes;
+
+static void
+betty_update(){
+	unsigned char pkt[MAX_PKTLEN];
+	int n;
+
+	if ( (0 == betty_next) || (host_now < betty_next) || cc1100_receiving() )
+		return;
+	if (betty_tx_bytes >= total_bytes){
+		done = 1;
+		return;
+	};
+	n = pkt_size;
+	memset(pkt, 'x', n - 1);
+	pkt[n - 1] = EOT;
+	cc1100_air_in(pkt, n);
+	betty_tx_bytes += n;
+	betty_next = host_now + us_to_cycles(BETTY_TIMEOUT_US);
+};
+
+/* ------------------------------------ SFR access ------------------------------------ */
+
+static int sbuf_written;
+
+volatile unsigned char *
+host_sfr(enum HOST_SFR r){
+	enum COST_CAT cat = CAT_OTHER;
+
+	/* The previous access is done now */
+	if (sbuf_written){
+		sbuf_written = 0;
+		up_busy += ser_byte_time;
+		if (tx_busy){
+			tx_next = host_sfr_regs[SFR_SBUF];
+			tx_full = 1;
+		} else {
+			tx_sbuf = host_sfr_regs[SFR_SBUF];
+			tx_busy = 1;
+			tx_done = host_now + ser_byte_time;
+			host_sfr_regs[SFR_TI] = 1;
+		};
+	};
+
+	switch (r){
+		case SFR_KB1: case SFR_OCB: case SFR_OCC: case SFR_RST:
+			cat = CAT_SPI;
+			break;
+		case SFR_TI: case SFR_SBUF:
+			cat = CAT_SERIAL;
+			break;
+		case SFR_WFEED1:
+			if (!in_isr)
+				round_done();
+			break;
+		default:
+			break;
+	};
+	host_charge(cost.sfr, cat);
+
+	cc1100_pins(r);
+	cc1100_update();
+	if ( (r == SFR_SBUF) && (in_isr != ISR_RX) )		// only the receive interrupt reads SBUF
+		sbuf_written = 1;
+	if (! in_isr){
+		serial_update();
+		betty_update();
+		if (done || (host_now >= time_lim))
+			longjmp(finished, 1);
+	};
+	return &host_sfr_regs[r];
+};
+
+/* ------------------------------------ scenarios ------------------------------------ */
+
+static void
+report(char *name, unsigned long bytes){
+	double t = cycles_to_sec(host_now - start);
+	double cps = (double) cost.clock_hz / cost.clocks_per_cycle;
+	cycles_t busy_cycles = host_now - round_cycles[ROUND_IDLE];
+	double serial_lim, radio_lim, adapter_lim, min_lim;
+	int i, pkt;
+	char *limit;
+
+	printf("%s:\n", name);
+	if (! done)
+		printf("  not finished within %d s\n", TIME_LIM_SEC);
+	printf("  time           %.0f ms, %lu bytes, %.0f bytes/s\n", t * 1000, bytes, bytes / t);
+	printf("  serial line    down busy %.0f %%, up busy %.0f %%, mpdtool waited for ACK %.0f %%, %lu overruns\n",
+		100.0 * down_busy / host_now, 100.0 * up_busy / host_now, 100.0 * ack_wait / host_now, overruns);
+	printf("  radio          %lu packets sent, %lu received, %lu missed, air %.0f %%\n",
+		cc1100_stats.tx_packets, cc1100_stats.rx_packets, cc1100_stats.rx_missed,
+		100.0 * cc1100_stats.air_time / host_now);
+	printf("  cycles         spi %.0f %%, serial %.0f %%, interrupt %.0f %%, other %.0f %%\n",
+		100.0 * cat_cycles[CAT_SPI] / host_now, 100.0 * cat_cycles[CAT_SERIAL] / host_now,
+		100.0 * cat_cycles[CAT_ISR] / host_now, 100.0 * cat_cycles[CAT_OTHER] / host_now);
+	for (i=0; i < NUM_ROUND; i++)
+		if (rounds[i])
+			printf("  round          %-18s %8lu times, %5.0f cycles, %6.0f per second\n", round_names[i], rounds[i],
+				(double) round_cycles[i] / rounds[i], cps * rounds[i] / round_cycles[i]);
+
+	/* The limits in payload bytes per second */
+	serial_lim = serial_baud / 10.0;
+	if (0 == strcmp(name, "down"))
+		serial_lim = serial_lim * MPDTOOL_PKTSIZE / (MPDTOOL_PKTSIZE + 1);
+	pkt = (0 == strcmp(name, "down")) ? MAX_TX_PAYLOAD : pkt_size;
+	radio_lim = pkt * radio_bps / 8.0 / (8 + 2 + pkt + 2);
+	adapter_lim = busy_cycles ? bytes * cps / busy_cycles : 0;
+	min_lim = serial_lim;
+	limit = "serial line";
+	if (radio_lim < min_lim){
+		min_lim = radio_lim;
+		limit = "radio";
+	};
+	if (adapter_lim < min_lim){
+		min_lim = adapter_lim;
+		limit = "adapter";
+	};
+	printf("  limits         serial line %.0f, radio %.0f, adapter %.0f bytes/s, lowest: %s, achieved %.0f %%\n",
+		serial_lim, radio_lim, adapter_lim, limit, 100.0 * bytes / t / min_lim);
+};
+
+static void
+run(void (*setup)(void)){
+	ser_byte_time = us_to_cycles(1000000UL) * 10 / serial_baud;
+	time_lim = us_to_cycles(1000000UL) * TIME_LIM_SEC;
+	start = us_to_cycles(10000);
+	cc1100_host_init(radio_bps);
+	setup();
+	if (0 == setjmp(finished))
+		scart_main();
+};
+
+static void
+setup_down(){
+	unsigned long i;
+
+	down_data = malloc(total_bytes);
+	for (i=0; i < total_bytes; i++)
+		down_data[i] = ((i % 40) == 39) ? '\n' : 'a' + (i % 26);
+	down_data[total_bytes - 1] = EOT;
+	down_len = total_bytes;
+	down_start(start);
+};
+
+static void
+setup_up(){
+	betty_next = start;
+};
+
+static void
+scn_down(){
+	run(setup_down);
+	report("down", betty_rx_bytes);
+};
+
+static void
+scn_up(){
+	/* Betty is done when all bytes have been sent and mpdtool has seen them */
+	run(setup_up);
+	report("up", up_serial_bytes);
+};
+
+/* ------------------------------------ main ------------------------------------ */
+
+static void
+usage(char *name){
+	fprintf(stderr, "Usage: %s [options] [down|up]\n", name);
+	fprintf(stderr, "  -s baud   serial line (%lu)\n", serial_baud);
+	fprintf(stderr, "  -r bps    radio (%lu)\n", radio_bps);
+	fprintf(stderr, "  -n bytes  payload of a scenario (%lu)\n", total_bytes);
+	fprintf(stderr, "  -p bytes  payload of Betty's packets incl. EOT (%d)\n", pkt_size);
+	fprintf(stderr, "  -l us     mpdtool needs this time to react to an ACK (%lu)\n", mpdtool_latency_us);
+	fprintf(stderr, "  -c hz     clock of the adapter (%lu)\n", cost.clock_hz);
+	fprintf(stderr, "  -b cyc    cycles of one SPI bit besides the pin accesses (%d)\n", cost.spi_bit);
+	fprintf(stderr, "  -w cyc    the same for the unrolled write of a bit (%d)\n", cost.spi_bit_w);
+	exit(1);
+};
+
+int
+main(int argc, char *argv[]){
+	static void (*scenarios[])(void) = {scn_down, scn_up};
+	static char *names[] = {"down", "up"};
+	int c, i, status;
+
+	while ( (c = getopt(argc, argv, "s:r:n:p:l:c:b:w:")) != -1 )
+		switch (c){
+			case 's': serial_baud = strtoul(optarg, NULL, 0); break;
+			case 'r': radio_bps = strtoul(optarg, NULL, 0); break;
+			case 'n': total_bytes = strtoul(optarg, NULL, 0); break;
+			case 'p': pkt_size = atoi(optarg); break;
+			case 'l': mpdtool_latency_us = strtoul(optarg, NULL, 0); break;
+			case 'c': cost.clock_hz = strtoul(optarg, NULL, 0); break;
+			case 'b': cost.spi_bit = atoi(optarg); break;
+			case 'w': cost.spi_bit_w = atoi(optarg); break;
+			default: usage(argv[0]);
+		};
+	if ( (pkt_size < 2) || (pkt_size > MAX_TX_PAYLOAD) || (total_bytes < 2) )
+		usage(argv[0]);
+
+	printf("scart adapter: %.4f MHz, serial %lu baud, radio %lu bps\n", cost.clock_hz / 1e6, serial_baud, radio_bps);
+	fflush(stdout);
+
+	/* Each scenario starts from reset, so it runs in its own process */
+	for (i=0; i < 2; i++){
+		if ( (optind < argc) && strcmp(argv[optind], names[i]) )
+			continue;
+		if (0 == fork()){
+			scenarios[i]();
+			fflush(stdout);
+			_exit(0);
+		};
+		wait(&status);
+	};
+	return 0;
+};
@@ -24,7 +24,7 @@
 #include "serial.h"
 
 #define VERSION_MAJOR '1'
-#define VERSION_MINOR '0'
+#define VERSION_MINOR '2'
 
 // Some ASCII control codes below 0x20 needed for out of band communication
 
@@ -34,12 +34,21 @@
 // End Of Transmission: Answer from MPD is complete or command from Betty is complete
 #define EOT	0x04
 
-// Enquiry: mpdtools asks for debugging information
+// Enquiry: mpdtools asks for debugging information, Betty asks if we are reachable
 #define ENQ 0x05
 
 // Acknowledge: We are ready to receive more bytes over serial line
 #define ACK	0x06
 
+// Device Control 2: mpdtool proposes a baud rate, the next byte gives it (see check_baud())
+#define DC2	0x12
+
+// Negative Acknowledge: we do not support the proposed baud rate
+#define NAK	0x15
+
+// Synchronous Idle: mpdtool switches to the agreed baud rate now
+#define SYN	0x16
+
 #define CAN 0x18
 
 // Software Reset bit of AUXR1
@@ -162,6 +171,11 @@ volatile unsigned char bufnxt;
 volatile __bit got_etx;
 volatile __bit got_eot;
 volatile __bit got_enq;
+volatile __bit got_dc2;
+volatile __bit got_syn;
+volatile unsigned char baud_req;		// rate code after DC2, 0 if none
+__bit got_radio_enq;
+__bit enq_pkt;
 
 
 void buffer_init(){
@@ -193,6 +207,8 @@ void buffer_init(){
 	EOT is sent if the answer from MPD is complete. This is stored in buffer, because Betty expects this too.
 		The flag got_eot is set as soon as we see an EOT character.
 		All following bytes will be dropped until got_eot is cleared.
+	
+	DC2 <rate> and SYN are sent when mpdtool wants another baud rate, see check_baud().
 		
 	bufcnt and buflim (and got_etx and got_eot and dropped) are changed in this routine.
 */
@@ -216,6 +232,23 @@ void serial_isr (void) __interrupt (4) {
 		return;
 	};
 	
+	/* The byte after DC2 is a rate code */
+	if (got_dc2){
+		got_dc2 = 0;
+		baud_req = x;
+		return;
+	};
+	
+	if (x == DC2){
+		got_dc2 = 1;
+		return;
+	};
+	
+	if (x == SYN){
+		got_syn = 1;
+		return;
+	};
+	
 	// mpdtool should not send us bytes after an EOT, but we just make sure.
 	if (got_eot){
 		return;
@@ -304,84 +337,64 @@ void re_enter_rx(){
 
 /*
 	Send buffer contents over radio.
-	When buffer has enough bytes for one packet (MAX_PACKETLEN -1), it starts filling TX_FIFO.
-	The packet length is then set to MAX_PACKETLEN.
-	IF a complete packet is already in the buffer, the packet length is set to the buffer length +1.
-	At each call of this function one byte is transferred from buffer to TX_FIFO if possible.
-	When all necessary bytes have been transferred, the packet is sent
-	and radio_mode is set to RADIO_TX.
-
-	This is a state machine. Transmission can be in 3 states:
-	(0) TX_IDLE			; not transmitting and nothing to transmit
-	(1) TX_COPY			; copy bytes from buffer to tx_fifo
-	(3) TX_SEND			; send the packet
-
+	When the buffer has enough bytes for one packet (MAX_TX_PAYLOAD), or a complete packet (EOT) is in the buffer,
+	the packet is copied to TX_FIFO and sent. This is done in one call.
+
+	Each SPI transfer costs a CS cycle and the slow spi_rw(). So we copy the bytes with burst writes.
+	The first burst writes the length byte, the address and the first TX_HEAD payload bytes.
+	Then we strobe STX and write the rest while the CC1100 calibrates and sends the preamble.
+	This takes longer than the rest of the copying (see host/scart_host.c), so TX_FIFO never runs dry.
+	After start_tx() radio_mode is RADIO_TX.
 */
 
-#define TX_IDLE		0
-#define TX_COPY		1
-#define TX_SEND		2
+/* Number of payload bytes in TX_FIFO before we start sending */
+#define TX_HEAD		8
+
+/* Copies n bytes from buffer to TX_FIFO, a burst write must be started */
+static void
+copy_to_fifo(unsigned char n){
+	while (n--)
+		cc1100_burst_byte(buffer_out());
+}
 
 static 
 void handle_tx(){
-	/* This byte is the state of the handle_tx routine */
-	static unsigned char tx_state = TX_IDLE;
-	static unsigned char tx_cnt;	// number of payload bytes to be transferred to TXFIFO (not counting address and length byte)
+	unsigned char tx_cnt;	// number of payload bytes to be transferred to TXFIFO (not counting address and length byte)
+	unsigned char head;
+
+	/* Is a new packet ready ? */
+	if (got_eot) {
+		got_eot=0;
+		tx_cnt = bufcnt;
+	} else if ( bufcnt >= MAX_TX_PAYLOAD )
+		tx_cnt = MAX_TX_PAYLOAD;
+	else
+		return;
 
-	switch (tx_state){
-		
-	case TX_IDLE:
-		/* Is a new packet ready ? */
-		if (got_eot) {
-			got_eot=0;
-			tx_cnt = bufcnt;	/* = number of payload bytes to be transferred to TXFIFO (not counting address and length byte) */
-		
-			/* Transfer the length byte to TXFIFO (just add 1 for the address) */
-			cc1100_write_fifo(tx_cnt + 1);
-		
-			/* Transfer the address to TXFIFO */
-			cc1100_write_fifo(DEV_ADDR);	
-			
-			tx_state = TX_COPY;
-			break;
-			
-		} else if ( bufcnt >= MAX_TX_PAYLOAD ) {
-			tx_cnt = MAX_TX_PAYLOAD;	
-			
-			/* Transfer the length byte to TXFIFO (just add 1 for the address) */
-			cc1100_write_fifo(MAX_TX_PAYLOAD + 1);
-			
-			/* Transfer the address to TXFIFO */
-			cc1100_write_fifo(DEV_ADDR);	
-			
-			tx_state = TX_COPY;
-		};
-		break;
-		
-	case TX_COPY:
-		/* Are there still bytes to copy to TXFIFO? */
-		if (tx_cnt > 0){
-			cc1100_write_fifo(buffer_out());	
-			tx_cnt--;
-		} else {
-			/* Finished copying ! */ 
-			tx_state = TX_SEND;
-		};
-		break;
-		
-	case TX_SEND:
-		start_tx();
-		tx_state = TX_IDLE;
-		break;
-	}
+	head = (tx_cnt > TX_HEAD) ? TX_HEAD : tx_cnt;
+
+	cc1100_burst_start(TX_fifo);
+	cc1100_burst_byte(tx_cnt + 1);		// length byte (just add 1 for the address)
+	cc1100_burst_byte(DEV_ADDR);
+	copy_to_fifo(head);
+	cc1100_burst_end();
+
+	start_tx();
+
+	if (tx_cnt > head){
+		cc1100_burst_start(TX_fifo);
+		copy_to_fifo(tx_cnt - head);
+		cc1100_burst_end();
+	};
 }
 
 /* Checks if mpdtool is waiting for ACK. Sends ACK if there is room in buffer */
 void check_etx(){
 	if (got_etx) {				/* Is mpdtool waiting for an ACK ? */		
-		if (has_room()){		/* Still enough space in buffer ? */
+		/* Still enough space in buffer ? After an EOT mpdtool waits until we have taken the answer out of it. */
+		if (has_room() && !got_eot){
 			got_etx = 0;		// Atomic Operation ! (see sdcc manual)
-			send_byte(ACK);
+			send_ctrl(ACK);
 		};
 	};
 }
@@ -396,7 +409,7 @@ void check_etx(){
 */
 static void 
 check_enq(){
-	if (got_enq) {
+	if (got_enq && (tx_room() >= 4)) {
 		got_enq = 0;		// Atomic Operation ! (see sdcc manual)
 		
 		send_byte('V');
@@ -406,8 +419,35 @@ check_enq(){
 	};
 }
 
+/* Betty has sent a packet with a single ENQ to check if we are reachable (see Link health in Betty's mpd.c).
+	We answer "scart: V<version>" over radio ourselves, mpdtool never sees the ENQ.
+	We only answer when the radio output buffer is empty, so we do not disturb an answer from mpdtool.
+	The serial interrupt is disabled while we fill the buffer.
+*/
+static void
+check_radio_enq(){
+	static __code char answer[] = {'s', 'c', 'a', 'r', 't', ':', ' ', 'V', VERSION_MAJOR, '.', VERSION_MINOR, '\n', EOT};
+	unsigned char i;
+	
+	if ( (!got_radio_enq) || (bufcnt != 0) || got_eot )
+		return;
+	got_radio_enq = 0;
+	
+	ESR = 0;
+	for (i=0; i < sizeof(answer); i++){
+		buf[bufnxt++] = answer[i];
+		if (bufnxt > BUFMAX)
+			bufnxt = 0;
+		bufcnt++;
+	};
+	got_eot = 1;
+	ESR = 1;
+}
+
 /* We check if there are some bytes to read from the RX_FIFO
-	and output one of them to the serial line.
+	and output them to the serial line.
+	All bytes that we may read are read in one burst, but not more than the serial output buffer takes.
+	So we never wait for the serial line here and the main loop can still send ACKs to mpdtool.
 	We make sure to empty the RX_FIFO only when a complete packet has been received. (see CC1100 errata)
 	
 	What can possibly go wrong?
@@ -440,6 +480,8 @@ check_enq(){
 
 	None of these errors should lead to an infinite loop!
 	
+	A packet with the single payload byte ENQ (+ EOT) is not sent to mpdtool. We answer it ourselves (see check_radio_enq()).
+	
 */
 static void
 check_radio_input (){
@@ -448,6 +490,7 @@ check_radio_input (){
 	unsigned char status;				// current chip status byte
 	unsigned char x;					// data byte read from cc1100 
 	unsigned char appended;				// second appended status byte 
+	unsigned char m;					// number of bytes to read now
 	
 	status = cc1100_read_rxstatus();
 	n = status & 0x0f;
@@ -477,6 +520,7 @@ check_radio_input (){
 				length = 0;
 				return;
 			};
+			enq_pkt = (length == 3);					// Maybe ENQ + EOT from Betty
 			
 			/* We should decrement length by 1 (address byte) and then increment by 2 (appended status bytes)
 				so we simply increment!
@@ -491,21 +535,40 @@ check_radio_input (){
 	// Already received length (and address), read rest of packet
 	if (length > 3){				// still payload data to read
 		/* are there enough bytes to read to avoid emptying the RX_FIFO */
-		if (n > 1){
-			x = cc1100_read_fifo();
-			send_byte(x);	
-			length--;	n--;
+		if (n < 2)
+			return;
+		m = n - 1;
+		if (m > length - 3)
+			m = length - 3;
+		if (m > tx_room())
+			m = tx_room();
+		if (m == 0)
+			return;
+		length -= m;
+		
+		cc1100_burst_start(RX_fifo | READ);
+		while (m--){
+			x = cc1100_burst_read();
+			if ( !(enq_pkt && (x == ENQ)) ){
+				enq_pkt = 0;
+				send_byte(x);
+			};
 		};
+		cc1100_burst_end();
 	} else {						// only EOT and status bytes remaining
-		if (n >= length){			// packet finished ? 
+		if ( (n >= length) && tx_room() ){			// packet finished ? 
 		/* Finished packet ? */
-			x = cc1100_read_fifo();
-			cc1100_read_fifo();								// 1. appended status byte
-			appended = cc1100_read_fifo();					// 2. appended status byte
+			cc1100_burst_start(RX_fifo | READ);
+			x = cc1100_burst_read();
+			cc1100_burst_read();							// 1. appended status byte
+			appended = cc1100_burst_read();					// 2. appended status byte
+			cc1100_burst_end();
 			
 			if ( (x != EOT) || (0 == (appended & CRC_OK)) ) {		// Betty always sends an EOT as last character!
 				send_byte(CAN);
-			} else 
+			} else if (enq_pkt)
+				got_radio_enq = 1;							// answered by check_radio_enq()
+			else 
 				send_byte(EOT);
 
 			length = 0;
@@ -516,8 +579,7 @@ check_radio_input (){
 	return;
 }
 
-// not used
-#if 0	
+/* Timeouts count overflows of the real time clock (RTCH:RTCL = 0xFFFF, see main()) */
 unsigned char timeout;
 
 void start_timeout(unsigned char time_cnt){
@@ -535,7 +597,86 @@ unsigned char check_timeout(){
 	};
 	return 0;
 }
-#endif
+
+/*
+	mpdtool can switch the serial line to a faster baud rate. We always start with 38400 baud.
+		mpdtool:	DC2 <rate>		proposes a rate: '0' = 38400, '1' = 57600, '2' = 115200, '3' = 230400
+		we:			DC2 <rate>		agree, or NAK if we do not know the rate
+		mpdtool:	SYN				switches after sending SYN, we switch when we get it
+		mpdtool:	ETX				at the new rate, we answer with ACK (see check_etx())
+	If we do not get SYN in time, we keep the old rate.
+	If we do not get an ETX at the new rate in time, we go back to 38400 baud.
+	mpdtool does the same if it does not get our ACK.
+	
+	We send nothing else to mpdtool until the switch, see main().
+*/
+#define BAUD_IDLE		0		// no change of baud rate in progress
+#define BAUD_AGREED		1		// waiting for SYN
+#define BAUD_TRYING		2		// waiting for ETX at the new rate
+
+/* Overflows of the RTC until we give up, see start_timeout() */
+#define BAUD_TIMEOUT	2
+
+#define NUM_BAUDS		4
+
+unsigned char baud_state;
+
+static void
+switch_baud(unsigned short baud){
+	EST = 0;
+	initSerial(baud);
+	EST = 1;
+}
+
+static void
+check_baud(){
+	static __code unsigned short bauds[NUM_BAUDS] = {384, 576, 1152, 2304};
+	static unsigned char baud_new;
+	unsigned char r;
+	
+	switch (baud_state){
+	
+	case BAUD_IDLE:
+		r = baud_req;
+		if ( (r == 0) || (tx_room() < 2) )
+			return;
+		baud_req = 0;
+		r -= '0';
+		if (r >= NUM_BAUDS){
+			send_byte(NAK);
+			return;
+		};
+		baud_new = r;
+		got_syn = 0;
+		send_byte(DC2);
+		send_byte('0' + r);
+		start_timeout(BAUD_TIMEOUT);
+		baud_state = BAUD_AGREED;
+		break;
+		
+	case BAUD_AGREED:
+		/* Our answer is out, mpdtool has seen it */
+		if (got_syn){
+			got_syn = 0;
+			got_etx = 0;
+			switch_baud(bauds[baud_new]);
+			start_timeout(BAUD_TIMEOUT);
+			baud_state = BAUD_TRYING;
+		} else if (check_timeout())
+			baud_state = BAUD_IDLE;
+		break;
+		
+	case BAUD_TRYING:
+		/* check_etx() sends the ACK at the new rate */
+		if (got_etx)
+			baud_state = BAUD_IDLE;
+		else if (check_timeout()){
+			switch_baud(384);
+			baud_state = BAUD_IDLE;
+		};
+		break;
+	};
+}
 
 /* Must be called regularily to keep the watchdog timer running. */
 void
@@ -610,6 +751,7 @@ void main(void) {
 	cc1100_init();
 
 	ESR = 1;
+	EST = 1;
 	EA = 1;
 	
 
@@ -657,16 +799,22 @@ void main(void) {
 			Checks if we got an ETX character from mpdtool. If we have room in our radio-tx-buffer, we send an ACK. 
 			Takes less than 0.3 ms, even if serial TX is busy.
 			
+		Task 1a': check_baud
+			Checks if mpdtool wants another baud rate. Runs the handshake and falls back on timeouts.
+	
 		Task 1b: check_enq
 			Checks if we got an ENQ character from mpdtool. We send the requested information to mpdtool. 
 			Duration depends on amount of information sent to mpdtool.
 			This is used to get the version of the scart firmware and for other debugging info.
 	
+		Task 1c: check_radio_enq
+			Checks if Betty has sent a single ENQ. We put our answer in the radio-tx-buffer.
+	
 		Task 2: handle_radio_tx
 			If there is a packet in our radio-tx-buffer ready to be sent (either because max packet length is 
 				reached or because EOT was received)
-				Move bytes from radio-tx-buffer to CC1100 TXFIFO.
-				If all bytes have been moved to CC1100 FIFO and CC1100 is ready, strobe CC1100 to start sending.
+				Move the first bytes from radio-tx-buffer to CC1100 TXFIFO, strobe CC1100 to start sending
+				and move the rest while CC1100 calibrates.
 	
 		Task 3: receive bytes via radio
 			when a complete packet has been received via radio, send the bytes to serial out. 
@@ -678,6 +826,12 @@ void main(void) {
 	got_etx = 0;
 	got_eot = 0;
 	got_enq = 0;
+	got_dc2 = 0;
+	got_syn = 0;
+	baud_req = 0;
+	baud_state = BAUD_IDLE;
+	got_radio_enq = 0;
+	enq_pkt = 0;
 	
 	buffer_init();
 		
@@ -696,23 +850,30 @@ void main(void) {
 		/* keep watchdog timer quiet */ 
 		feed_wd();
 		
+		/* Check if mpdtool wants another baud rate, must be called before check_etx() */
+		check_baud();
+		
 		/* Check if mpdtool has sent ETX. Sends ACK if there is room in buffer */
 		check_etx();
 		
 		/* Check if mpdtool wants some other info from us (out of band communication) */
 		check_enq();
 		
+		/* Check if Betty wants to know if we are reachable */
+		check_radio_enq();
+		
 		/* Our radio link is only half duplex. We decide here if we receive or transmit 
 			We are normally in state RADIO_RX to not miss a packet from Betty.
 			Only if we have a packet to send, do we switch to mode RADIO_TX.
 			Right after finishing sending the packet, mode RADIO_RX is reentered. 
 		*/
 		
-		if (radio_mode == RADIO_RX)
-			/* Test and handle input over wireless */
-			check_radio_input();
+		if (radio_mode == RADIO_RX){
+			/* Test and handle input over wireless, but do not send to mpdtool while we change the baud rate */
+			if (baud_state == BAUD_IDLE)
+				check_radio_input();
 			
-		else
+		} else
 			/* reenter RADIO_RX mode if possible */
 			re_enter_rx();
 		
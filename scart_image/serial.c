@@ -16,12 +16,26 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include "serial.h"
 #include <P89LPC932.h>
+#include "serial.h"
+
+/* 
+	Serial output is interrupt driven, so the main loop does not wait for the UART.
+	send_byte() starts the UART if it is idle, else it puts the byte into the ring buffer txbuf.
+	serial_tx_isr() sends the next byte when the previous one is out.
+	A control character (ACK) for mpdtool does not wait behind the bytes in txbuf, see send_ctrl().
+*/
+__idata unsigned char txbuf[TXBUFSIZE];
+static volatile unsigned char txout;		// Index of next byte to send
+static volatile unsigned char txcnt;		// Number of bytes in txbuf
+static volatile unsigned char ctrl_byte;
+static volatile __bit ctrl_pending;
+static volatile __bit tx_running;			// A byte is in SBUF, serial_tx_isr() will be called
 
+/* Also called to change the baud rate, bytes that are not sent yet are dropped */
 void initSerial(unsigned short baud) {
 				// TODO disable reception here
-				// TODO disable baud rate generator here
+        BRGCON = 0x00;		// The baud rate generator must be off while we change it
         SCON   = 0x52;		// 0101 0010 = Mode 8N1, enable reception, TxIntFlag=1 ? 
         SSTAT |= 0x80;		// 1000 0000 = Double buffering mode
         switch (baud) {
@@ -46,19 +60,68 @@ void initSerial(unsigned short baud) {
                 BRGR0  = 0x67; 
                 BRGR1  = 0x00;
                 break;
+        case 2304:
+                BRGR0  = 0x2C; 
+                BRGR1  = 0x00;
+                break;
         }
         BRGCON = 0x03;		// Select the baud rate generator as timing source and enable it
         
-        TI = 1;
+        TI = 0;				// Nothing sent yet, the transmit interrupt comes when a byte is out
+        tx_running = 0;
+        txcnt = 0;
+        ctrl_pending = 0;
         
 }
 
+/* Needs CIDIS in SSTAT, else receive and transmit share the interrupt 4 */
+void serial_tx_isr (void) __interrupt (13) {
+	TI = 0;
+	
+	if (ctrl_pending){
+		ctrl_pending = 0;
+		SBUF = ctrl_byte;
+	} else if (txcnt){
+		SBUF = txbuf[txout];
+		txout = (txout + 1) & (TXBUFSIZE - 1);
+		txcnt--;
+	} else
+		tx_running = 0;
+}
+
+/* Returns the number of bytes that send_byte() takes without waiting */
+unsigned char tx_room() {
+	return TXBUFSIZE - txcnt;
+}
 
-/* Potentially infinite waiting time ! */
+/* Potentially infinite waiting time, if the buffer is full and the interrupt is disabled ! */
 void send_byte(unsigned char h) {
-        while (!TI);
-        TI = 0; 
-        SBUF = h;  
+	while (txcnt >= TXBUFSIZE);
+	
+	EST = 0;
+	if (tx_running){
+		txbuf[(txout + txcnt) & (TXBUFSIZE - 1)] = h;
+		txcnt++;
+	} else {
+		tx_running = 1;
+		SBUF = h;
+	};
+	EST = 1;
+}
+
+/* Sends h as the next byte, before the bytes waiting in txbuf */
+void send_ctrl(unsigned char h) {
+	while (ctrl_pending);
+	
+	EST = 0;
+	if (tx_running){
+		ctrl_byte = h;
+		ctrl_pending = 1;
+	} else {
+		tx_running = 1;
+		SBUF = h;
+	};
+	EST = 1;
 }
 
 // unused
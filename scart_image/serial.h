@@ -21,6 +21,9 @@
 
 #define CTS			P0_4
 
+/* Size of the serial output buffer, must be a power of 2 */
+#define TXBUFSIZE	16
+
 //__code unsigned char crlf[] = { 0x0d, 0x0a, 0x00 };
 
 void initSerial(unsigned short baud);
@@ -28,6 +31,11 @@ void send_string(const unsigned char* string);
 void send_hex(unsigned char c);
 void send_bytes(unsigned char* h, unsigned char l);
 void send_byte(unsigned char h);
+void send_ctrl(unsigned char h);
+unsigned char tx_room(void);
+
+/* SDCC needs the prototype of an interrupt routine in the file with main() */
+void serial_tx_isr(void) __interrupt (13);
 
 #endif
 